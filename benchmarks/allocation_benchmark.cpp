@@ -0,0 +1,118 @@
+/**
+ * @brief Heap allocations of BoTSORT::track() in steady state, per call and per profiled stage
+ *  The global operator new is replaced by the counting hooks of allocation_hooks.h. A crowd scene
+ *  (see synthetic_scene.h) is tracked without ReID and GMC, the first frames warm up the tracker
+ *  (frame arena, capacity of the track lists, track pool), then the allocations of each track() call
+ *  are counted.
+ *  The per-stage counts come from the profiler. With a maximum given, the benchmark fails if the
+ *  mean number of allocations per track() call exceeds it, to guard the steady state in CI.
+ *
+ * Usage: botsort_allocation_benchmark <tracker_config> [num_objects] [num_frames] [max_allocations]
+ */
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BoTSORT.h"
+#include "allocation_hooks.h"
+#include "profiler.h"
+#include "synthetic_scene.h"
+
+
+BOTSORT_ALLOCATION_HOOKS();
+
+
+namespace
+{
+constexpr int WARMUP_FRAMES = 50;
+const cv::Size FRAME_SIZE(1920, 1080);
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " <tracker_config> [num_objects] [num_frames] "
+                     "[max_allocations]"
+                  << std::endl;
+        return 1;
+    }
+
+    const std::string tracker_config_path = write_tracker_config(
+            argv[1], {"enable_reid = false", "enable_gmc = false"},
+            "botsort_allocation_benchmark");
+    const int num_objects = argc > 2 ? std::stoi(argv[2]) : 200;
+    const int num_frames = argc > 3 ? std::stoi(argv[3]) : 200;
+    const double max_allocations = argc > 4 ? std::stod(argv[4]) : -1.0;
+
+    bot_profiler::set_enabled(true);
+
+    SyntheticScene scene(SceneParams::crowd(num_objects, FRAME_SIZE));
+    BoTSORT tracker(tracker_config_path);
+
+    // The frame is only read for its size when ReID and GMC are disabled
+    const cv::Mat frame(FRAME_SIZE, CV_8UC3, cv::Scalar::all(0));
+    std::vector<Detection> detections;
+    std::vector<std::shared_ptr<Track>> tracks;
+    uint64_t total_allocations = 0, max_frame_allocations = 0;
+    uint64_t num_detections = 0;
+
+    for (int i = 0; i < WARMUP_FRAMES + num_frames; ++i)
+    {
+        scene.next(detections);
+        if (i == WARMUP_FRAMES)
+            bot_profiler::snapshot(true);
+
+        const uint64_t start = bot_profiler::thread_allocations();
+        tracker.track(detections, frame, tracks);
+        const uint64_t allocations =
+                bot_profiler::thread_allocations() - start;
+
+        if (i < WARMUP_FRAMES)
+            continue;
+        total_allocations += allocations;
+        max_frame_allocations = std::max(max_frame_allocations, allocations);
+        num_detections += detections.size();
+    }
+
+    const double allocations_per_frame =
+            static_cast<double>(total_allocations) / num_frames;
+    std::cout << std::fixed << std::setprecision(2) << num_objects
+              << " objects, " << static_cast<double>(num_detections) / num_frames
+              << " detections/frame, " << num_frames << " frames after "
+              << WARMUP_FRAMES << " warm-up frames" << std::endl
+              << "allocations per track(): mean " << allocations_per_frame
+              << ", max " << max_frame_allocations << ", per detection "
+              << (num_detections ? static_cast<double>(total_allocations) /
+                                           static_cast<double>(num_detections)
+                                 : 0.0)
+              << std::endl
+              << std::endl;
+
+    std::cout << std::left << std::setw(48) << "stage" << std::right
+              << std::setw(12) << "calls" << std::setw(14) << "allocs/call"
+              << std::endl;
+    for (const bot_profiler::ScopeStats &scope_stats:
+         bot_profiler::snapshot(true).scopes)
+    {
+        if (scope_stats.name.rfind("BoTSORT::track", 0) != 0)
+            continue;
+        std::cout << std::left << std::setw(48) << scope_stats.name
+                  << std::right << std::setw(12) << scope_stats.count
+                  << std::setw(14) << scope_stats.allocations_per_call()
+                  << std::endl;
+    }
+
+    if (max_allocations >= 0.0 && allocations_per_frame > max_allocations)
+    {
+        std::cout << "FAILED: " << allocations_per_frame
+                  << " allocations per track() call, the maximum is "
+                  << max_allocations << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+"""
+Compare a botsort_bench run against a stored baseline and fail on performance regressions.
+
+Both files are Google Benchmark JSON outputs (--benchmark_out_format=json). With repetitions
+(--benchmark_repetitions=N), the median of each benchmark is compared and its coefficient of
+variation widens the threshold, so that noisy benchmarks do not fail the check. Besides the time
+of each benchmark, the "stage:<name>_ms" counters (per-stage means of the MOT replay) are compared,
+so that a regression is reported at the stage that caused it.
+
+A benchmark regresses when current > baseline * (1 + threshold), with
+threshold = max(threshold of the benchmark, noise_sigmas * coefficient of variation).
+The threshold of a benchmark is the first pattern of the thresholds file matching its name:
+
+    {"default": 0.10, "thresholds": [{"pattern": "^BM_GMCApply", "threshold": 0.25}]}
+
+A benchmark that reported an error in the current run fails the check, and so does a benchmark of the
+baseline missing from the current run (e.g. it crashed the suite), unless --allow-missing is given
+(runs of a subset of the benchmarks).
+
+Exit status: 0 if nothing regressed, 1 on a regression, an errored or a missing benchmark,
+2 if a file can't be read, 3 if the baseline does not exist (not recorded yet).
+
+Usage: python3 benchmarks/bench_compare.py <baseline.json> <current.json> [--thresholds thresholds.json]
+                                           [--allow-missing]
+"""
+import argparse
+import json
+import os
+import re
+import statistics
+import sys
+
+TIME_UNIT_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+STAGE_COUNTER = re.compile(r"^stage:(.+)_ms$")
+
+
+class Measure:
+    """Median value of a benchmark or counter, and its coefficient of variation (0 if unknown)"""
+
+    def __init__(self, value, cv=0.0):
+        self.value = value
+        self.cv = cv
+
+
+def _median_and_cv(values):
+    median = statistics.median(values)
+    if len(values) < 2 or median == 0.0:
+        return Measure(median)
+    return Measure(median, statistics.stdev(values) / median)
+
+
+def load_results(path):
+    """
+    Measures of a benchmark output: {name: Measure} for the times (ns) and the stage counters (ms),
+    a counter is named "<benchmark> [stage <name>]", and the errors: {benchmark: error message}
+    """
+    try:
+        with open(path) as json_file:
+            results = json.load(json_file)
+    except (OSError, ValueError) as error:
+        print(f"Can't read benchmark results {path}: {error}")
+        sys.exit(2)
+
+    samples, aggregates, errors = {}, {}, {}
+    for entry in results.get("benchmarks", []):
+        name = entry.get("run_name", entry["name"])
+        if entry.get("error_occurred"):
+            errors[name] = entry.get("error_message", "error")
+            continue
+        # The coefficient of variation aggregate is a ratio, not a time
+        scale = 1.0 if entry.get("aggregate_name") == "cv" else \
+            TIME_UNIT_NS[entry.get("time_unit", "ns")]
+        values = {"time": entry["real_time"] * scale}
+        for key, value in entry.items():
+            stage = STAGE_COUNTER.match(key)
+            if stage:
+                values[f"stage {stage.group(1)}"] = value
+
+        if entry.get("run_type") == "aggregate":
+            aggregates.setdefault(name, {})[entry["aggregate_name"]] = values
+        else:
+            samples.setdefault(name, []).append(values)
+
+    measures = {}
+    for name in sorted(set(samples) | set(aggregates)):
+        runs, aggregate = samples.get(name, []), aggregates.get(name, {})
+        center = aggregate.get("median", aggregate.get("mean", {}))
+        keys = runs[0].keys() if runs else center.keys()
+        for key in keys:
+            label = name if key == "time" else f"{name} [{key}]"
+            if len(runs) > 1:
+                measures[label] = _median_and_cv([run[key] for run in runs])
+            elif center:
+                cv = aggregate.get("cv", {}).get(key)
+                if cv is None and "stddev" in aggregate and center[key]:
+                    cv = aggregate["stddev"][key] / center[key]
+                measures[label] = Measure(center[key], cv or 0.0)
+            elif runs:
+                measures[label] = Measure(runs[0][key])
+    return results.get("context", {}), measures, errors
+
+
+def load_thresholds(path, default):
+    if not path:
+        return default, []
+    try:
+        with open(path) as json_file:
+            config = json.load(json_file)
+    except (OSError, ValueError) as error:
+        print(f"Can't read thresholds {path}: {error}")
+        sys.exit(2)
+    patterns = [(re.compile(item["pattern"]), float(item["threshold"]))
+                for item in config.get("thresholds", [])]
+    return float(config.get("default", default)), patterns
+
+
+def threshold_of(name, default, patterns):
+    for pattern, threshold in patterns:
+        if pattern.search(name):
+            return threshold
+    return default
+
+
+def format_value(label, value):
+    if "[stage " in label:
+        return f"{value:.3f} ms"
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if value >= scale:
+            return f"{value / scale:.3f} {unit}"
+    return f"{value:.1f} ns"
+
+
+def check_context(baseline, current):
+    for key in ("host_name", "num_cpus", "mhz_per_cpu", "library_build_type"):
+        if key in baseline and key in current and baseline[key] != current[key]:
+            print(f"Warning: {key} differs from the baseline ({baseline[key]} vs {current[key]}), "
+                  "the times may not be comparable")
+    if current.get("library_build_type") == "debug":
+        print("Warning: Google Benchmark is a debug build")
+
+
+def benchmark_of(label):
+    return label.split(" [", 1)[0]
+
+
+def compare(baseline, current, errors, default_threshold, patterns, noise_sigmas, allow_missing):
+    """
+    Rows of the report, regressions (label, change, threshold) and failures (label, reason):
+    the errored benchmarks of the current run, and its missing ones unless allow_missing
+    """
+    rows, regressions, failures = [], [], []
+    for name, message in sorted(errors.items()):
+        before = format_value(name, baseline[name].value) if name in baseline else "-"
+        rows.append((name, before, "-", "", "", "ERROR"))
+        failures.append((name, f"error: {message}"))
+
+    for label in sorted(set(baseline) | set(current)):
+        if benchmark_of(label) in errors:
+            continue
+        if label not in current:
+            rows.append((label, format_value(label, baseline[label].value), "-", "", "", "missing"))
+            # A missing benchmark is reported once, not once per stage counter
+            name = benchmark_of(label)
+            if not allow_missing and (label == name or name in current):
+                failures.append((label, "missing from the current run"))
+            continue
+        if label not in baseline:
+            rows.append((label, "-", format_value(label, current[label].value), "", "", "new"))
+            continue
+
+        before, after = baseline[label], current[label]
+        threshold = max(threshold_of(label, default_threshold, patterns),
+                        noise_sigmas * max(before.cv, after.cv))
+        change = after.value / before.value - 1.0 if before.value > 0.0 else 0.0
+        if change > threshold:
+            status = "REGRESSED"
+            regressions.append((label, change, threshold))
+        elif change < -threshold:
+            status = "improved"
+        else:
+            status = "ok"
+        rows.append((label, format_value(label, before.value), format_value(label, after.value),
+                     f"{100.0 * change:+.1f}%", f"{100.0 * threshold:.1f}%", status))
+    return rows, regressions, failures
+
+
+def print_report(rows, regressions, failures):
+    headers = ("benchmark", "baseline", "current", "change", "threshold", "status")
+    widths = [max(len(str(row[i])) for row in rows + [headers]) for i in range(len(headers))]
+    line = "  ".join(f"{{:<{widths[0]}}}" if i == 0 else f"{{:>{width}}}"
+                     for i, width in enumerate(widths))
+    print(line.format(*headers))
+    for row in rows:
+        print(line.format(*row))
+
+    print()
+    if not regressions and not failures:
+        print(f"No regression ({len(rows)} measures compared)")
+        return
+    if failures:
+        print(f"{len(failures)} failed benchmark(s):")
+        for label, reason in failures:
+            print(f"  {label}: {reason}")
+    if regressions:
+        print(f"{len(regressions)} regression(s):")
+    for label, change, threshold in sorted(regressions, key=lambda item: -item[1]):
+        print(f"  {label}: {100.0 * change:+.1f}% (threshold {100.0 * threshold:.1f}%)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("baseline", help="baseline results (Google Benchmark JSON)")
+    parser.add_argument("current", help="results to check (Google Benchmark JSON)")
+    parser.add_argument("--thresholds", help="thresholds file (JSON), see above")
+    parser.add_argument("--default-threshold", type=float, default=0.10,
+                        help="relative slowdown allowed when the thresholds file has no default")
+    parser.add_argument("--noise-sigmas", type=float, default=3.0,
+                        help="coefficients of variation a change must exceed to be a regression")
+    parser.add_argument("--allow-missing", action="store_true",
+                        help="do not fail on baseline benchmarks missing from the current run")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.baseline):
+        print(f"No baseline at {args.baseline}, record one first (bench_baseline target)")
+        sys.exit(3)
+    baseline_context, baseline, baseline_errors = load_results(args.baseline)
+    current_context, current, errors = load_results(args.current)
+    default_threshold, patterns = load_thresholds(args.thresholds, args.default_threshold)
+
+    check_context(baseline_context, current_context)
+    for name in sorted(baseline_errors):
+        print(f"Warning: {name} reported an error in the baseline, it is not compared")
+    rows, regressions, failures = compare(baseline, current, errors, default_threshold, patterns,
+                                          args.noise_sigmas, args.allow_missing)
+    print_report(rows, regressions, failures)
+    sys.exit(1 if regressions or failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,411 @@
+/**
+ * @brief Microbenchmarks of the hot kernels of the tracker (Google Benchmark)
+ *  - matching: iou_distance, embedding_distance (fp32/fp16/int8), fuse_motion, fuse_iou_with_emb, lapjv
+ *  - Kalman filter: predict, update, gating_distance; Track::apply_camera_motion
+ *  - GMC: apply of each method at 720p and 1080p
+ *  - BoTSORT::track on synthetic crowded scenes (without Re-ID and GMC, see botsort_reid_pipeline_benchmark)
+ *  - MOT replay: BoTSORT::track over the detections of the MOT20-01 example sequence, with the mean
+ *    of each profiled stage as "stage:<name>_ms" counters
+ *  The inputs are generated with fixed seeds, so that the results are comparable between releases
+ *  (see bench_compare.py for the regression check against a baseline).
+ *
+ * Usage: botsort_bench [--benchmark_filter=<regex>] [--benchmark_out=<results.json> --benchmark_out_format=json]
+ *  The configs are read from BOTSORT_CONFIG_DIR (the config directory of the source tree by default),
+ *  the MOT detections from BOTSORT_MOT_DETECTIONS (the det.txt of the examples by default).
+ */
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "BoTSORT.h"
+#include "GlobalMotionCompensation.h"
+#include "matching.h"
+#include "mot_io.h"
+#include "profiler.h"
+#include "synthetic_scene.h"
+#include "track.h"
+#include "utils.h"
+
+
+namespace
+{
+constexpr int SCENE_FRAMES = 500;
+const cv::Size MOT20_FRAME_SIZE(1920, 1080);
+
+const std::vector<std::string> FEATURE_FORMATS = {"fp32", "fp16", "int8"};
+const std::vector<std::string> GMC_METHODS = {
+        "orb", "ecc", "sparseOptFlow", "optFlowModified", "OpenCV_VideoStab"};
+
+
+std::string config_path(const std::string &filename)
+{
+    const char *config_dir = std::getenv("BOTSORT_CONFIG_DIR");
+    return std::string(config_dir ? config_dir : BOTSORT_CONFIG_DIR) + "/" +
+           filename;
+}
+
+
+FeatureVector random_feature(std::mt19937 &rng)
+{
+    std::normal_distribution<float> distribution(0.0F, 1.0F);
+    FeatureVector feature;
+    for (Eigen::Index i = 0; i < feature.size(); ++i)
+        feature(i) = distribution(rng);
+    return feature.normalized();
+}
+
+
+/**
+ * @brief Tracks at the detections of a synthetic scene, optionally activated (Kalman state) and with a feature
+ */
+std::vector<std::shared_ptr<Track>>
+make_tracks(int num_tracks, bool with_features, KalmanFilter *kalman_filter,
+            uint32_t seed,
+            FeatureFormat appearance_format = FeatureFormat::Float32)
+{
+    SyntheticScene scene(num_tracks, cv::Size(1920, 1080));
+    std::vector<Detection> detections;
+    scene.next(detections);
+
+    std::mt19937 rng(seed);
+    std::vector<std::shared_ptr<Track>> tracks;
+    for (const Detection &detection: detections)
+    {
+        std::optional<FeatureVector> feature;
+        if (with_features)
+            feature = random_feature(rng);
+        tracks.push_back(std::make_shared<Track>(
+                std::vector<float>{detection.bbox_tlwh.x, detection.bbox_tlwh.y,
+                                   detection.bbox_tlwh.width,
+                                   detection.bbox_tlwh.height},
+                detection.confidence, detection.class_id, feature, 0,
+                FeatureFormat::Float32, appearance_format));
+        if (kalman_filter)
+            tracks.back()->activate(*kalman_filter, 1);
+    }
+    return tracks;
+}
+
+
+CostMatrix random_cost_matrix(int rows, int cols, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> distribution(0.0F, 1.0F);
+    CostMatrix cost(rows, cols);
+    for (Eigen::Index i = 0; i < cost.size(); ++i)
+        cost(i) = distribution(rng);
+    return cost;
+}
+
+
+////////////////// Matching //////////////////
+void BM_IouDistance(benchmark::State &state)
+{
+    const int num_objects = static_cast<int>(state.range(0));
+    auto tracks = make_tracks(num_objects, false, nullptr, 1);
+    auto detections = make_tracks(num_objects, false, nullptr, 2);
+
+    for (auto _: state)
+        benchmark::DoNotOptimize(iou_distance(tracks, detections, 0.5F));
+    state.SetItemsProcessed(state.iterations() * num_objects * num_objects);
+}
+BENCHMARK(BM_IouDistance)->RangeMultiplier(4)->Range(8, 512);
+
+
+void BM_EmbeddingDistance(benchmark::State &state)
+{
+    const int num_objects = static_cast<int>(state.range(0));
+    const std::string &format_name = FEATURE_FORMATS[state.range(1)];
+    const FeatureFormat format = feature_format_from_string(format_name);
+    auto tracks = make_tracks(num_objects, true, nullptr, 1, format);
+    auto detections = make_tracks(num_objects, true, nullptr, 2, format);
+
+    state.SetLabel(format_name);
+    for (auto _: state)
+        benchmark::DoNotOptimize(embedding_distance(tracks, detections, 0.25F,
+                                                    "cosine", format));
+    state.SetItemsProcessed(state.iterations() * num_objects * num_objects);
+}
+BENCHMARK(BM_EmbeddingDistance)
+        ->ArgsProduct({{8, 32, 128, 512}, {0, 1, 2}});
+
+
+void BM_FuseMotion(benchmark::State &state)
+{
+    const int num_objects = static_cast<int>(state.range(0));
+    KalmanFilter kalman_filter(1.0 / 30);
+    auto tracks = make_tracks(num_objects, false, &kalman_filter, 1);
+    auto detections = make_tracks(num_objects, false, nullptr, 2);
+    const CostMatrix cost = random_cost_matrix(num_objects, num_objects, 3);
+    FrameArena arena;
+
+    for (auto _: state)
+    {
+        arena.reset();
+        CostMatrix fused = cost;
+        fuse_motion(kalman_filter, fused, tracks, detections, arena, 0.985F);
+        benchmark::DoNotOptimize(fused.data());
+    }
+    state.SetItemsProcessed(state.iterations() * num_objects * num_objects);
+}
+BENCHMARK(BM_FuseMotion)->RangeMultiplier(4)->Range(8, 512);
+
+
+void BM_FuseIouWithEmb(benchmark::State &state)
+{
+    const int num_objects = static_cast<int>(state.range(0));
+    const CostMatrix iou_dist =
+            random_cost_matrix(num_objects, num_objects, 1);
+    const CostMatrix emb_dist =
+            random_cost_matrix(num_objects, num_objects, 2);
+    const CostMatrix iou_mask =
+            (random_cost_matrix(num_objects, num_objects, 3).array() > 0.5F)
+                    .cast<float>();
+    const CostMatrix emb_mask =
+            (random_cost_matrix(num_objects, num_objects, 4).array() > 0.5F)
+                    .cast<float>();
+
+    for (auto _: state)
+    {
+        CostMatrix iou = iou_dist, emb = emb_dist;
+        benchmark::DoNotOptimize(
+                fuse_iou_with_emb(iou, emb, iou_mask, emb_mask));
+    }
+    state.SetItemsProcessed(state.iterations() * num_objects * num_objects);
+}
+BENCHMARK(BM_FuseIouWithEmb)->RangeMultiplier(4)->Range(8, 512);
+
+
+void BM_Lapjv(benchmark::State &state)
+{
+    const int num_tracks = static_cast<int>(state.range(0));
+    const int num_detections = static_cast<int>(state.range(1));
+    const CostMatrix cost_matrix =
+            random_cost_matrix(num_tracks, num_detections, 1);
+
+    std::vector<int> rowsol, colsol;
+    for (auto _: state)
+    {
+        CostMatrix cost = cost_matrix;
+        benchmark::DoNotOptimize(lapjv(cost, rowsol, colsol, true, 0.7F));
+    }
+}
+BENCHMARK(BM_Lapjv)
+        ->Args({10, 10})
+        ->Args({50, 50})
+        ->Args({100, 100})
+        ->Args({200, 200})
+        ->Args({500, 500})
+        ->Args({100, 150})
+        ->Args({150, 100});
+
+
+////////////////// Kalman filter and track //////////////////
+void BM_KalmanPredict(benchmark::State &state)
+{
+    KalmanFilter kalman_filter(1.0 / 30);
+    const KFDataStateSpace initial_state =
+            kalman_filter.init(DetVec(960.0F, 540.0F, 80.0F, 200.0F));
+
+    // Restart from the initial state, the covariance would otherwise grow without bound
+    for (auto _: state)
+    {
+        KFDataStateSpace state_space = initial_state;
+        kalman_filter.predict(state_space.first, state_space.second);
+        benchmark::DoNotOptimize(state_space.first.data());
+    }
+}
+BENCHMARK(BM_KalmanPredict);
+
+
+void BM_KalmanUpdate(benchmark::State &state)
+{
+    KalmanFilter kalman_filter(1.0 / 30);
+    const KFDataStateSpace initial_state =
+            kalman_filter.init(DetVec(960.0F, 540.0F, 80.0F, 200.0F));
+    const DetVec measurement(962.0F, 541.0F, 81.0F, 199.0F);
+
+    for (auto _: state)
+        benchmark::DoNotOptimize(kalman_filter.update(
+                initial_state.first, initial_state.second, measurement));
+}
+BENCHMARK(BM_KalmanUpdate);
+
+
+void BM_KalmanGatingDistance(benchmark::State &state)
+{
+    const int num_measurements = static_cast<int>(state.range(0));
+    KalmanFilter kalman_filter(1.0 / 30);
+    const KFDataStateSpace state_space =
+            kalman_filter.init(DetVec(960.0F, 540.0F, 80.0F, 200.0F));
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> offset(-20.0F, 20.0F);
+    std::vector<DetVec> measurements;
+    for (int i = 0; i < num_measurements; ++i)
+        measurements.emplace_back(960.0F + offset(rng), 540.0F + offset(rng),
+                                  80.0F + offset(rng), 200.0F + offset(rng));
+
+    for (auto _: state)
+        benchmark::DoNotOptimize(kalman_filter.gating_distance(
+                state_space.first, state_space.second, measurements));
+    state.SetItemsProcessed(state.iterations() * num_measurements);
+}
+BENCHMARK(BM_KalmanGatingDistance)->RangeMultiplier(4)->Range(1, 256);
+
+
+void BM_TrackApplyCameraMotion(benchmark::State &state)
+{
+    KalmanFilter kalman_filter(1.0 / 30);
+    auto tracks = make_tracks(1, false, &kalman_filter, 1);
+    HomographyMatrix H = HomographyMatrix::Identity();
+    H(0, 2) = 0.5F;
+    H(1, 2) = -0.25F;
+
+    for (auto _: state)
+    {
+        tracks[0]->apply_camera_motion(H);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_TrackApplyCameraMotion);
+
+
+////////////////// GMC //////////////////
+void BM_GMCApply(benchmark::State &state)
+{
+    const std::string &method = GMC_METHODS[state.range(0)];
+    const int height = static_cast<int>(state.range(1));
+    const cv::Size frame_size(height * 16 / 9, height);
+
+    // Frames are generated ahead, the GMC sees a continuous (panning) sequence
+    constexpr int NUM_FRAMES = 32;
+    SyntheticScene scene(20, frame_size);
+    std::vector<cv::Mat> frames(NUM_FRAMES);
+    std::vector<std::vector<Detection>> detections(NUM_FRAMES);
+    for (int i = 0; i < NUM_FRAMES; ++i)
+        scene.next(frames[i], detections[i]);
+
+    GlobalMotionCompensation gmc(GlobalMotionCompensation::GMC_method_map[method],
+                                 config_path("gmc.ini"));
+    state.SetLabel(method + " " + std::to_string(height) + "p");
+    size_t frame_index = 0;
+    for (auto _: state)
+    {
+        benchmark::DoNotOptimize(gmc.apply(frames[frame_index],
+                                           detections[frame_index]));
+        frame_index = (frame_index + 1) % NUM_FRAMES;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GMCApply)
+        ->ArgsProduct({benchmark::CreateDenseRange(
+                               0, static_cast<int>(GMC_METHODS.size()) - 1, 1),
+                       {720, 1080}})
+        ->Unit(benchmark::kMillisecond);
+
+
+////////////////// Tracker //////////////////
+void BM_BoTSORTTrack(benchmark::State &state)
+{
+    const int num_objects = static_cast<int>(state.range(0));
+    const std::string tracker_config = write_tracker_config(
+            config_path("tracker.ini"),
+            {"enable_reid = false", "enable_gmc = false"},
+            "botsort_bench_tracker");
+
+    // Detections are generated ahead, the tracker is restarted at the end of the sequence
+    SyntheticScene scene(num_objects, cv::Size(1920, 1080));
+    std::vector<std::vector<Detection>> sequence(SCENE_FRAMES);
+    for (std::vector<Detection> &detections: sequence)
+        scene.next(detections);
+    const cv::Mat frame(1080, 1920, CV_8UC3, cv::Scalar::all(0));
+
+    auto tracker = std::make_unique<BoTSORT>(tracker_config);
+    size_t frame_index = 0;
+    for (auto _: state)
+    {
+        benchmark::DoNotOptimize(tracker->track(sequence[frame_index], frame));
+        if (++frame_index == sequence.size())
+        {
+            state.PauseTiming();
+            tracker = std::make_unique<BoTSORT>(tracker_config);
+            frame_index = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["objects"] = num_objects;
+}
+BENCHMARK(BM_BoTSORTTrack)
+        ->Arg(10)
+        ->Arg(50)
+        ->Arg(100)
+        ->Arg(200)
+        ->Arg(400)
+        ->Unit(benchmark::kMicrosecond);
+
+
+/**
+ * @brief End-to-end replay of a MOT sequence (one iteration = the whole sequence with a new tracker)
+ *  The profiler is enabled for the stage counters; its overhead is included in the time.
+ */
+void BM_MOTReplay(benchmark::State &state)
+{
+    const char *detections_path = std::getenv("BOTSORT_MOT_DETECTIONS");
+    // Not const: track() clamps the detection boxes in place
+    std::vector<std::vector<Detection>> sequence = read_mot_detections(
+            detections_path ? detections_path : BOTSORT_MOT_DETECTIONS);
+    if (sequence.empty())
+    {
+        state.SkipWithError("No MOT detections, set BOTSORT_MOT_DETECTIONS");
+        return;
+    }
+
+    const std::string tracker_config = write_tracker_config(
+            config_path("tracker.ini"),
+            {"enable_reid = false", "enable_gmc = false"},
+            "botsort_bench_mot_replay");
+    const cv::Mat frame(MOT20_FRAME_SIZE, CV_8UC3, cv::Scalar::all(0));
+
+    bot_profiler::set_enabled(true);
+    bot_profiler::snapshot(true);
+    size_t num_detections = 0;
+    for (auto _: state)
+    {
+        state.PauseTiming();
+        BoTSORT tracker(tracker_config);
+        state.ResumeTiming();
+
+        for (const std::vector<Detection> &detections: sequence)
+        {
+            benchmark::DoNotOptimize(tracker.track(detections, frame));
+            num_detections += detections.size();
+        }
+    }
+
+    for (const bot_profiler::ScopeStats &scope_stats:
+         bot_profiler::snapshot(true).scopes)
+    {
+        const std::string prefix = "BoTSORT::track/";
+        if (scope_stats.name.rfind(prefix, 0) == 0)
+            state.counters["stage:" + scope_stats.name.substr(prefix.size()) +
+                           "_ms"] = scope_stats.mean_ms();
+    }
+    bot_profiler::set_enabled(false);
+
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(sequence.size()));
+    state.counters["detections"] = benchmark::Counter(
+            static_cast<double>(num_detections),
+            benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_MOTReplay)->Unit(benchmark::kMillisecond);
+}// namespace
+
+
+BENCHMARK_MAIN();
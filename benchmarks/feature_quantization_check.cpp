@@ -0,0 +1,192 @@
+/**
+ * @brief Accuracy regression check and timing of the quantized (FP16/INT8) appearance distances
+ *  Embeddings of the detections of consecutive frames are extracted with the given Re-ID model (e.g. the bundled OSNet),
+ *  the embedding distance between frame t-1 and frame t is computed in FP32, FP16 and INT8 and compared:
+ *  maximum / mean absolute error, decisions flipped at appearance_thresh and nearest neighbours changed.
+ *  Exits with 1 if the error of a format exceeds its tolerance.
+ *
+ * Usage: botsort_feature_quantization_check <reid_config> <onnx_model> <video> <mot_det_file> [num_frames] [appearance_thresh]
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/videoio.hpp>
+
+#include "FeatureQuantization.h"
+#include "ReID.h"
+#include "matching.h"
+#include "mot_io.h"
+
+
+namespace
+{
+struct FormatResult
+{
+    FeatureFormat format;
+    std::string name;
+    float tolerance;
+
+    double seconds = 0.0;
+    float max_error = 0.0F;
+    double sum_error = 0.0;
+    size_t num_distances = 0, threshold_flips = 0, neighbour_changes = 0;
+};
+
+
+/**
+ * @brief Index of the smallest distance of each row
+ */
+std::vector<Eigen::Index> row_argmin(const CostMatrix &distances)
+{
+    std::vector<Eigen::Index> argmin(distances.rows(), -1);
+    for (Eigen::Index i = 0; i < distances.rows(); i++)
+        if (distances.cols() > 0)
+            distances.row(i).minCoeff(&argmin[i]);
+    return argmin;
+}
+
+
+/**
+ * @brief Tracks of the detections with their features, kept encoded in the given appearance format
+ */
+std::vector<std::shared_ptr<Track>>
+make_tracks(const std::vector<cv::Rect> &rois, const FeatureMatrix &features,
+            FeatureFormat format)
+{
+    std::vector<std::shared_ptr<Track>> tracks;
+    for (size_t i = 0; i < rois.size(); ++i)
+    {
+        tracks.push_back(std::make_shared<Track>(
+                std::vector<float>{static_cast<float>(rois[i].x),
+                                   static_cast<float>(rois[i].y),
+                                   static_cast<float>(rois[i].width),
+                                   static_cast<float>(rois[i].height)},
+                1.0F, 0, FeatureVector(features.row(i)), 0,
+                FeatureFormat::Float32, format));
+    }
+    return tracks;
+}
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " <reid_config> <onnx_model> <video> <mot_det_file> "
+                     "[num_frames] [appearance_thresh]"
+                  << std::endl;
+        return 1;
+    }
+
+    const int num_frames = argc > 5 ? std::stoi(argv[5]) : 100;
+    const float appearance_thresh = argc > 6 ? std::stof(argv[6]) : 0.25F;
+
+    ReIDModel reid_model(argv[1], argv[2]);
+    cv::VideoCapture video(argv[3]);
+    if (!video.isOpened())
+    {
+        std::cout << "Can't open " << argv[3] << std::endl;
+        return 1;
+    }
+    const std::vector<std::vector<Detection>> sequence =
+            read_mot_detections(argv[4]);
+
+    std::vector<FormatResult> results = {
+            {FeatureFormat::Float32, "fp32", 0.0F},
+            {FeatureFormat::Float16, "fp16", 1e-3F},
+            {FeatureFormat::Int8, "int8", 1e-2F},
+    };
+
+    // Tracks of the previous frame per format
+    std::vector<std::vector<std::shared_ptr<Track>>> previous_tracks(
+            results.size());
+    cv::Mat frame;
+    for (int frame_id = 1; frame_id <= num_frames && video.read(frame);
+         ++frame_id)
+    {
+        std::vector<cv::Rect> rois;
+        if (static_cast<size_t>(frame_id) <= sequence.size())
+            for (const Detection &detection: sequence[frame_id - 1])
+                rois.emplace_back(detection.bbox_tlwh);
+        FeatureMatrix features =
+                reid_model.extract_features(frame, rois).features;
+
+        CostMatrix reference;
+        std::vector<Eigen::Index> reference_argmin;
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            FormatResult &result = results[k];
+            std::vector<std::shared_ptr<Track>> tracks =
+                    make_tracks(rois, features, result.format);
+            if (previous_tracks[k].empty() || tracks.empty())
+            {
+                previous_tracks[k] = std::move(tracks);
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            CostMatrix distances = std::get<0>(embedding_distance(
+                    previous_tracks[k], tracks, appearance_thresh,
+                    reid_model.get_distance_metric(), result.format));
+            result.seconds +=
+                    std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+            previous_tracks[k] = std::move(tracks);
+
+            if (result.format == FeatureFormat::Float32)
+            {
+                reference = distances;
+                reference_argmin = row_argmin(reference);
+                continue;
+            }
+
+            const CostMatrix error = (distances - reference).cwiseAbs();
+            result.max_error = std::max(result.max_error, error.maxCoeff());
+            result.sum_error += error.sum();
+            result.num_distances += error.size();
+
+            for (Eigen::Index i = 0; i < distances.rows(); i++)
+                for (Eigen::Index j = 0; j < distances.cols(); j++)
+                    result.threshold_flips +=
+                            (distances(i, j) > appearance_thresh) !=
+                            (reference(i, j) > appearance_thresh);
+
+            const std::vector<Eigen::Index> argmin = row_argmin(distances);
+            for (size_t i = 0; i < argmin.size(); ++i)
+                result.neighbour_changes += argmin[i] != reference_argmin[i];
+        }
+    }
+
+    std::cout << "Kernels: " << feature_kernels_description()
+              << ", metric: " << reid_model.get_distance_metric() << std::endl;
+    std::cout << std::setw(8) << "format" << std::setw(14) << "time (ms)"
+              << std::setw(12) << "max error" << std::setw(12) << "mean error"
+              << std::setw(10) << "flips" << std::setw(12) << "neighbours"
+              << std::setw(8) << "status" << std::endl;
+
+    bool passed = true;
+    for (const FormatResult &result: results)
+    {
+        const bool ok = result.max_error <= result.tolerance;
+        passed &= ok;
+        std::cout << std::setw(8) << result.name << std::fixed
+                  << std::setprecision(3) << std::setw(14)
+                  << result.seconds * 1e3 << std::scientific
+                  << std::setprecision(2) << std::setw(12) << result.max_error
+                  << std::setw(12)
+                  << (result.num_distances
+                              ? result.sum_error / result.num_distances
+                              : 0.0)
+                  << std::setw(10) << result.threshold_flips << std::setw(12)
+                  << result.neighbour_changes << std::setw(8)
+                  << (ok ? "ok" : "FAILED") << std::endl;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "DataType.h"
+
+
+/**
+ * @brief Detections of a MOTChallenge file (frame,id,left,top,width,height,score,...) per frame
+ *  A missing score or a score of 0 (ground truth files) is read as 1, as in the tracking example
+ */
+inline std::vector<std::vector<Detection>>
+read_mot_detections(const std::string &filepath)
+{
+    std::vector<std::vector<Detection>> sequence;
+    std::ifstream file(filepath);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream iss(line);
+        std::vector<float> values;
+        std::string value;
+        while (std::getline(iss, value, ','))
+            values.push_back(std::stof(value));
+        if (values.size() < 6 || values[0] < 1)
+            continue;
+
+        Detection detection;
+        detection.class_id = 0;
+        detection.bbox_tlwh =
+                cv::Rect_(values[2], values[3], values[4], values[5]);
+        detection.confidence =
+                values.size() < 7 || values[6] == 0 ? 1.0F : values[6];
+
+        const size_t frame_id = static_cast<size_t>(values[0]);
+        if (sequence.size() < frame_id)
+            sequence.resize(frame_id);
+        sequence[frame_id - 1].push_back(detection);
+    }
+    return sequence;
+}
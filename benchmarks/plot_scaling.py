@@ -0,0 +1,71 @@
+"""
+Plot the BoTSORT::track() latency against the number of objects, from the CSV written by
+botsort_scaling_benchmark: total latency (mean and p95) and mean of each profiled stage on log-log
+axes, with reference slopes of O(N), O(N^2) and O(N^3) anchored at the smallest object count.
+
+Usage: python3 benchmarks/plot_scaling.py <botsort_scaling.csv> [output.png]
+"""
+import argparse
+import csv
+
+import matplotlib
+
+matplotlib.use("Agg")
+import matplotlib.pyplot as plt
+
+
+def read_results(path):
+    with open(path, newline="") as csv_file:
+        rows = list(csv.DictReader(csv_file))
+    if not rows:
+        raise SystemExit(f"No results in {path}")
+    return {key: [float(row[key]) for row in rows] for key in rows[0]}
+
+
+def plot(results, output_path):
+    objects = results["objects"]
+    figure, axes = plt.subplots(figsize=(10, 7))
+
+    axes.plot(objects, results["mean_ms"], "o-", color="black", linewidth=2,
+              label="track (mean)")
+    axes.plot(objects, results["p95_ms"], "o--", color="black",
+              label="track (p95)")
+    stages = [key for key in results
+              if key.endswith("_ms") and key not in
+              ("mean_ms", "p50_ms", "p95_ms", "max_ms")]
+    for stage in stages:
+        if max(results[stage]) > 0.0:
+            axes.plot(objects, results[stage], ".-", label=stage[:-3])
+
+    reference_ms = results["mean_ms"][0]
+    for power, label in ((1, "O(N)"), (2, "O(N^2)"), (3, "O(N^3)")):
+        axes.plot(objects,
+                  [reference_ms * (n / objects[0]) ** power for n in objects],
+                  ":", color="gray", linewidth=1)
+        axes.annotate(label, (objects[-1],
+                              reference_ms * (objects[-1] / objects[0]) ** power),
+                      color="gray", fontsize=8)
+
+    axes.set_xscale("log")
+    axes.set_yscale("log")
+    axes.set_xlabel("objects")
+    axes.set_ylabel("latency per frame (ms)")
+    axes.set_title("BoTSORT::track latency vs object count")
+    axes.grid(True, which="both", alpha=0.3)
+    axes.legend(fontsize=8)
+    figure.tight_layout()
+    figure.savefig(output_path, dpi=120)
+    print(f"Plot written to {output_path}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("csv", help="results of botsort_scaling_benchmark")
+    parser.add_argument("output", nargs="?", default="botsort_scaling.png",
+                        help="output image")
+    args = parser.parse_args()
+    plot(read_results(args.csv), args.output)
+
+
+if __name__ == "__main__":
+    main()
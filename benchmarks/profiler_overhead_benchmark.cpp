@@ -0,0 +1,83 @@
+/**
+ * @brief Overhead of an instrumented scope (PROFILE_SCOPE) with the tracing disabled and enabled
+ *  The events are collected between the batches so that no event is dropped.
+ *
+ * Usage: botsort_profiler_overhead_benchmark [num_batches]
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "profiler.h"
+
+
+namespace
+{
+constexpr int SCOPES_PER_BATCH = 4000;
+
+// Keeps the timestamps from being optimized out
+volatile uint64_t timestamp_sink = 0;
+
+
+/**
+ * @brief Mean time of an empty instrumented scope (ns)
+ */
+double scope_overhead_ns(int num_batches)
+{
+    double total_ns = 0.0;
+    for (int batch = 0; batch < num_batches; ++batch)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < SCOPES_PER_BATCH; ++i)
+        {
+            PROFILE_SCOPE("profiler_overhead_benchmark/empty_scope");
+        }
+        total_ns += std::chrono::duration<double, std::nano>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+        bot_profiler::collect();
+    }
+    return total_ns / (static_cast<double>(num_batches) * SCOPES_PER_BATCH);
+}
+
+
+/**
+ * @brief Mean time of a pair of timestamps (ns), the lower bound of the enabled overhead
+ */
+double timestamp_pair_ns()
+{
+    constexpr int NUM_PAIRS = 1000000;
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUM_PAIRS; ++i)
+        checksum += bot_profiler::now() ^ bot_profiler::now();
+    const double total_ns = std::chrono::duration<double, std::nano>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count();
+
+    timestamp_sink = checksum;
+    return total_ns / NUM_PAIRS;
+}
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    const int num_batches = argc > 1 ? std::stoi(argv[1]) : 500;
+
+    bot_profiler::set_enabled(false);
+    const double disabled_ns = scope_overhead_ns(num_batches);
+
+    bot_profiler::set_enabled(true);
+    const double enabled_ns = scope_overhead_ns(num_batches);
+    bot_profiler::set_enabled(false);
+
+    std::cout << "Scope overhead, tracing disabled: " << disabled_ns << " ns"
+              << std::endl;
+    std::cout << "Scope overhead, tracing enabled: " << enabled_ns << " ns"
+              << " (of which 2 timestamps: " << timestamp_pair_ns() << " ns)"
+              << std::endl;
+    std::cout << "Dropped events: " << bot_profiler::dropped_events()
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @brief End-to-end BoTSORT::track() latency and throughput with synchronous and asynchronous ReID
+ *  A synthetic scene (textured background with camera motion, moving objects) is tracked with
+ *  - sync: features extracted on the tracking thread
+ *  - async: features extracted on the ReID worker thread, joined before the first association
+ *  - async_late: as async, features that are not ready are applied one frame late
+ *  - cache: as sync, the last feature of a track is reused while its box and crop do not change
+ *  The ReID backend is the one of the ReID config (e.g. inference_backend = opencv_dnn for the CPU)
+ *
+ * Usage: botsort_reid_pipeline_benchmark <tracker_config> <gmc_config> <reid_config> <onnx_model> [num_frames] [num_objects]
+ */
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "BoTSORT.h"
+#include "synthetic_scene.h"
+
+
+namespace
+{
+constexpr int WARMUP_FRAMES = 10;
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " <tracker_config> <gmc_config> <reid_config> "
+                     "<onnx_model> [num_frames] [num_objects]"
+                  << std::endl;
+        return 1;
+    }
+
+    const std::string tracker_config_path = argv[1];
+    const std::string gmc_config_path = argv[2];
+    const std::string reid_config_path = argv[3];
+    const std::string onnx_model_path = argv[4];
+    const int num_frames = argc > 5 ? std::stoi(argv[5]) : 300;
+    const int num_objects = argc > 6 ? std::stoi(argv[6]) : 20;
+
+    const std::vector<std::pair<std::string, std::vector<std::string>>>
+            modes = {
+                    {"sync", {"reid_async = false"}},
+                    {"async",
+                     {"reid_async = true", "reid_late_features = false"}},
+                    {"async_late",
+                     {"reid_async = true", "reid_late_features = true"}},
+                    {"cache", {"reid_async = false", "reid_cache = true"}},
+            };
+
+    std::cout << std::setw(12) << "mode" << std::setw(12) << "mean ms"
+              << std::setw(12) << "p50 ms" << std::setw(12) << "p95 ms"
+              << std::setw(12) << "max ms" << std::setw(12) << "fps"
+              << std::setw(14) << "embeddings" << std::setw(12) << "deferred"
+              << std::setw(12) << "cache hits" << std::endl;
+
+    for (const auto &[mode, overrides]: modes)
+    {
+        std::vector<std::string> config = overrides;
+        config.emplace_back("enable_reid = true");
+        BoTSORT tracker(write_tracker_config(tracker_config_path, config,
+                                             "botsort_benchmark_" + mode),
+                        gmc_config_path, reid_config_path, onnx_model_path);
+
+        SyntheticScene scene(num_objects, cv::Size(1920, 1080));
+        cv::Mat frame;
+        std::vector<Detection> detections;
+        std::vector<double> latencies_ms;
+        uint64_t embeddings = 0, deferred = 0, cache_hits = 0;
+
+        for (int i = 0; i < WARMUP_FRAMES + num_frames; ++i)
+        {
+            scene.next(frame, detections);
+
+            auto start = std::chrono::steady_clock::now();
+            tracker.track(detections, frame);
+            auto end = std::chrono::steady_clock::now();
+
+            if (i < WARMUP_FRAMES)
+                continue;
+            latencies_ms.push_back(
+                    std::chrono::duration<double, std::milli>(end - start)
+                            .count());
+            embeddings += tracker.get_reid_stats().extracted;
+            deferred += tracker.get_reid_stats().deferred;
+            cache_hits += tracker.get_reid_stats().cache_hits;
+        }
+
+        const double total_ms = std::accumulate(latencies_ms.begin(),
+                                                latencies_ms.end(), 0.0);
+        std::sort(latencies_ms.begin(), latencies_ms.end());
+        auto percentile = [&latencies_ms](double p) {
+            return latencies_ms[static_cast<size_t>(
+                    p * static_cast<double>(latencies_ms.size() - 1))];
+        };
+
+        std::cout << std::setw(12) << mode << std::fixed
+                  << std::setprecision(2) << std::setw(12)
+                  << total_ms / num_frames << std::setw(12) << percentile(0.5)
+                  << std::setw(12) << percentile(0.95) << std::setw(12)
+                  << latencies_ms.back() << std::setw(12)
+                  << std::setprecision(1) << 1e3 * num_frames / total_ms
+                  << std::setw(14) << embeddings << std::setw(12) << deferred
+                  << std::setw(12) << cache_hits << std::endl;
+    }
+
+    return 0;
+}
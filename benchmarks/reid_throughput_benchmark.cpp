@@ -0,0 +1,130 @@
+/**
+ * @brief ReID throughput benchmark (patches/second)
+ *  - Inference engine: one forward pass per batch, for every batch size up to max_batch_size
+ *  - ReIDModel: crop, resize, pack and infer num_patches random regions of a 1080p frame
+ *
+ * Usage: botsort_reid_benchmark <reid_config> <onnx_model> [backend] [num_threads] [max_batch_size] [num_patches]
+ */
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "InferenceEngine.h"
+#include "ReID.h"
+
+
+namespace
+{
+constexpr int WARMUP_ITERATIONS = 3;
+constexpr double MIN_BENCHMARK_SECONDS = 2.0;
+
+/**
+ * @brief Run the function until MIN_BENCHMARK_SECONDS elapsed, return the mean time per call (seconds)
+ */
+template<typename Function>
+double time_per_call(Function &&function)
+{
+    for (int i = 0; i < WARMUP_ITERATIONS; ++i)
+        function();
+
+    int iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    while (elapsed < MIN_BENCHMARK_SECONDS)
+    {
+        function();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    }
+    return elapsed / iterations;
+}
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " <reid_config> <onnx_model> [backend] [num_threads] "
+                     "[max_batch_size] [num_patches]"
+                  << std::endl;
+        return 1;
+    }
+
+    const std::string reid_config_path = argv[1];
+    const std::string onnx_model_path = argv[2];
+
+    inference_backend::InferenceEngineParams params;
+    params.backend = argc > 3 ? argv[3] : "opencv_dnn";
+    params.num_threads = argc > 4 ? std::stoi(argv[4]) : 0;
+    const int max_batch_size = argc > 5 ? std::stoi(argv[5]) : 32;
+    const int num_patches = argc > 6 ? std::stoi(argv[6]) : 100;
+    params.input_layer_name = "images";
+    params.input_dims = {1, 3, 256, 128};
+    params.output_layer_names = {"output"};
+
+
+    // Inference engine throughput per batch size
+    std::cout << "Backend: " << params.backend
+              << ", threads: " << params.num_threads << std::endl;
+    std::cout << std::setw(12) << "batch_size" << std::setw(16) << "ms/batch"
+              << std::setw(16) << "patches/s" << std::endl;
+    for (int batch_size = 1; batch_size <= max_batch_size; batch_size *= 2)
+    {
+        params.batch_size = batch_size;
+        auto engine = inference_backend::create_inference_engine(params);
+        if (!engine || !engine->load_model(onnx_model_path))
+            return 1;
+        if (engine->max_batch_size() < batch_size)
+        {
+            std::cout << "The model does not support batch size "
+                      << batch_size << std::endl;
+            break;
+        }
+
+        const int dims[] = {batch_size, params.input_dims[1],
+                            params.input_dims[2], params.input_dims[3]};
+        cv::Mat blob(4, dims, CV_32F);
+        cv::randu(blob, 0.0F, 255.0F);
+
+        const double seconds =
+                time_per_call([&]() { engine->forward_batch(blob); });
+        std::cout << std::setw(12) << batch_size << std::setw(16)
+                  << std::fixed << std::setprecision(2) << seconds * 1e3
+                  << std::setw(16) << std::setprecision(1)
+                  << batch_size / seconds << std::endl;
+    }
+
+
+    // End-to-end ReIDModel throughput (configured backend and batch size)
+    ReIDModel reid_model(reid_config_path, onnx_model_path);
+
+    cv::Mat frame(1080, 1920, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::RNG rng(42);
+    std::vector<cv::Rect> rois(num_patches);
+    for (cv::Rect &roi: rois)
+    {
+        roi.width = rng.uniform(30, 200);
+        roi.height = rng.uniform(roi.width, 3 * roi.width);
+        roi.x = rng.uniform(0, frame.cols - roi.width);
+        roi.y = rng.uniform(0, std::max(1, frame.rows - roi.height));
+    }
+
+    const double seconds = time_per_call(
+            [&]() { reid_model.extract_features(frame, rois); });
+    std::cout << "ReIDModel::extract_features (" << num_patches
+              << " patches): " << std::setprecision(2) << seconds * 1e3
+              << " ms/frame, " << std::setprecision(1) << num_patches / seconds
+              << " patches/s" << std::endl;
+
+    return 0;
+}
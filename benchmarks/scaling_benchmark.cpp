@@ -0,0 +1,290 @@
+/**
+ * @brief BoTSORT::track() latency as a function of the number of objects, on crowded synthetic scenes
+ *  Each object count is tracked on a seeded crowd scene (SceneParams::crowd: occlusions, crossing
+ *  objects, camera motion, missed and false detections) of a 4K frame, with ReID and GMC disabled so
+ *  that the association dominates. For each count the benchmark reports the latency of track(), the
+ *  mean of each profiled stage and the tracking quality against the ground truth (fraction of the
+ *  visible objects matched by a track, identity switches), and writes them as CSV for plot_scaling.py.
+ *  Counts whose assignment problem would not fit in memory (lapjv extends the cost matrix to
+ *  (tracks + detections)^2) are skipped.
+ *
+ * Usage: botsort_scaling_benchmark <tracker_config> [output.csv] [num_frames] [num_objects...]
+ */
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BoTSORT.h"
+#include "profiler.h"
+#include "synthetic_scene.h"
+
+
+namespace
+{
+constexpr int WARMUP_FRAMES = 10;
+constexpr float MATCH_IOU = 0.5F;
+constexpr double LAPJV_MEMORY_LIMIT_GB = 8.0;
+const cv::Size FRAME_SIZE(3840, 2160);
+const std::vector<int> DEFAULT_OBJECT_COUNTS = {100,  200,  500,  1000,
+                                                2000, 5000, 10000};
+
+
+/**
+ * @brief Peak memory of lapjv on a square problem of num_objects tracks and detections:
+ *  extended cost matrix, in double precision in the frame arena
+ */
+double lapjv_memory_gb(int num_objects)
+{
+    const double n = 2.0 * num_objects;
+    return n * n * sizeof(double) * 1e-9;
+}
+
+
+/**
+ * @brief Tracking quality against the ground truth
+ */
+struct QualityStats
+{
+    uint64_t visible_objects = 0;///< Ground truth boxes with a detection expected
+    uint64_t matched_objects = 0;///< Visible objects matched by an output track
+    uint64_t id_switches = 0;    ///< Objects matched by another track than in their last match
+};
+
+
+/**
+ * @brief Greedily match the visible ground truth boxes to the output tracks (IoU >= MATCH_IOU)
+ *  and count the identity switches. The track boxes are bucketed in a grid so that the matching
+ *  stays linear in the number of objects.
+ */
+class QualityEvaluator
+{
+public:
+    QualityEvaluator(cv::Size frame_size, float cell_size, float min_visibility)
+        : _grid(cv::Size(frame_size.width + 2 * PAD,
+                         frame_size.height + 2 * PAD),
+                cell_size),
+          _min_visibility(min_visibility)
+    {
+    }
+
+    void update(const std::vector<GroundTruthBox> &ground_truth,
+                const std::vector<std::shared_ptr<Track>> &tracks,
+                QualityStats &stats)
+    {
+        _track_boxes.clear();
+        for (const std::shared_ptr<Track> &track: tracks)
+        {
+            const std::vector<float> &tlwh = track->get_tlwh();
+            _track_boxes.emplace_back(tlwh[0] + PAD, tlwh[1] + PAD, tlwh[2],
+                                      tlwh[3]);
+        }
+        _grid.build(_track_boxes);
+        _track_taken.assign(tracks.size(), false);
+
+        for (const GroundTruthBox &object: ground_truth)
+        {
+            if (object.visibility < _min_visibility)
+                continue;
+            ++stats.visible_objects;
+
+            cv::Rect2f box = object.box;
+            box.x += PAD, box.y += PAD;
+            int best_track = -1;
+            float best_iou = MATCH_IOU;
+            _grid.for_each_candidate(box, [&](int index) {
+                const cv::Rect2f &track_box = _track_boxes[index];
+                const float intersection = (box & track_box).area();
+                const float iou = intersection / (box.area() +
+                                                  track_box.area() -
+                                                  intersection);
+                if (!_track_taken[index] && iou >= best_iou)
+                {
+                    best_iou = iou;
+                    best_track = index;
+                }
+            });
+            if (best_track < 0)
+                continue;
+
+            _track_taken[best_track] = true;
+            ++stats.matched_objects;
+            const int track_id = tracks[best_track]->track_id;
+            auto last_match = _last_track_ids.find(object.id);
+            if (last_match == _last_track_ids.end())
+                _last_track_ids.emplace(object.id, track_id);
+            else if (last_match->second != track_id)
+            {
+                ++stats.id_switches;
+                last_match->second = track_id;
+            }
+        }
+    }
+
+
+private:
+    // The boxes may leave the frame with the camera motion
+    static constexpr int PAD = 256;
+
+    BoxGrid _grid;
+    float _min_visibility;
+    std::vector<cv::Rect2f> _track_boxes;
+    std::vector<bool> _track_taken;
+    std::unordered_map<int, int> _last_track_ids;
+};
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " <tracker_config> [output.csv] [num_frames] "
+                     "[num_objects...]"
+                  << std::endl;
+        return 1;
+    }
+
+    const std::string tracker_config_path = write_tracker_config(
+            argv[1], {"enable_reid = false", "enable_gmc = false"},
+            "botsort_scaling_benchmark");
+    const std::string output_path =
+            argc > 2 ? argv[2] : "botsort_scaling.csv";
+    const int num_frames = argc > 3 ? std::stoi(argv[3]) : 100;
+    std::vector<int> object_counts;
+    for (int i = 4; i < argc; ++i)
+        object_counts.push_back(std::stoi(argv[i]));
+    if (object_counts.empty())
+        object_counts = DEFAULT_OBJECT_COUNTS;
+
+    // Per-stage means from the profiler
+    bot_profiler::set_enabled(true);
+
+    std::vector<std::string> stage_names;
+    std::vector<std::map<std::string, double>> stage_means_ms;
+    std::vector<std::vector<double>> rows;
+
+    std::cout << std::setw(10) << "objects" << std::setw(12) << "mean ms"
+              << std::setw(12) << "p50 ms" << std::setw(12) << "p95 ms"
+              << std::setw(12) << "max ms" << std::setw(12) << "fps"
+              << std::setw(12) << "recall" << std::setw(12) << "id sw"
+              << std::endl;
+
+    for (int num_objects: object_counts)
+    {
+        if (lapjv_memory_gb(num_objects) > LAPJV_MEMORY_LIMIT_GB)
+        {
+            std::cout << std::setw(10) << num_objects
+                      << "  skipped: the assignment needs about "
+                      << lapjv_memory_gb(num_objects) << " GB" << std::endl;
+            continue;
+        }
+
+        const SceneParams params = SceneParams::crowd(num_objects, FRAME_SIZE);
+        SyntheticScene scene(params);
+        BoTSORT tracker(tracker_config_path);
+        QualityEvaluator evaluator(FRAME_SIZE, 3.0F * params.max_width,
+                                   params.min_visibility);
+        QualityStats quality;
+
+        // The frame is only read for its size when ReID and GMC are disabled
+        const cv::Mat frame(FRAME_SIZE, CV_8UC3, cv::Scalar::all(0));
+        std::vector<Detection> detections;
+        std::vector<double> latencies_ms;
+        uint64_t num_detections = 0;
+
+        for (int i = 0; i < WARMUP_FRAMES + num_frames; ++i)
+        {
+            scene.next(detections);
+            if (i == WARMUP_FRAMES)
+                bot_profiler::snapshot(true);
+
+            auto start = std::chrono::steady_clock::now();
+            const std::vector<std::shared_ptr<Track>> tracks =
+                    tracker.track(detections, frame);
+            auto end = std::chrono::steady_clock::now();
+
+            if (i < WARMUP_FRAMES)
+                continue;
+            latencies_ms.push_back(
+                    std::chrono::duration<double, std::milli>(end - start)
+                            .count());
+            num_detections += detections.size();
+            evaluator.update(scene.ground_truth(), tracks, quality);
+        }
+
+        std::map<std::string, double> stages;
+        for (const bot_profiler::ScopeStats &scope_stats:
+             bot_profiler::snapshot(true).scopes)
+        {
+            if (scope_stats.name.rfind("BoTSORT::track/", 0) != 0)
+                continue;
+            const std::string stage = scope_stats.name.substr(15);
+            if (std::find(stage_names.begin(), stage_names.end(), stage) ==
+                stage_names.end())
+                stage_names.push_back(stage);
+            stages[stage] = scope_stats.mean_ms();
+        }
+        stage_means_ms.push_back(stages);
+
+        const double total_ms = std::accumulate(latencies_ms.begin(),
+                                                latencies_ms.end(), 0.0);
+        std::sort(latencies_ms.begin(), latencies_ms.end());
+        auto percentile = [&latencies_ms](double p) {
+            return latencies_ms[static_cast<size_t>(
+                    p * static_cast<double>(latencies_ms.size() - 1))];
+        };
+        const double recall =
+                quality.visible_objects
+                        ? static_cast<double>(quality.matched_objects) /
+                                  static_cast<double>(quality.visible_objects)
+                        : 0.0;
+
+        rows.push_back({static_cast<double>(num_objects),
+                        static_cast<double>(num_detections) / num_frames,
+                        total_ms / num_frames, percentile(0.5),
+                        percentile(0.95), latencies_ms.back(), recall,
+                        static_cast<double>(quality.id_switches)});
+
+        std::cout << std::setw(10) << num_objects << std::fixed
+                  << std::setprecision(2) << std::setw(12)
+                  << total_ms / num_frames << std::setw(12) << percentile(0.5)
+                  << std::setw(12) << percentile(0.95) << std::setw(12)
+                  << latencies_ms.back() << std::setw(12)
+                  << std::setprecision(1) << 1e3 * num_frames / total_ms
+                  << std::setw(12) << std::setprecision(3) << recall
+                  << std::setw(12) << quality.id_switches << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    std::ofstream csv(output_path);
+    csv << "objects,detections_per_frame,mean_ms,p50_ms,p95_ms,max_ms,recall,"
+           "id_switches";
+    for (const std::string &stage: stage_names)
+        csv << "," << stage << "_ms";
+    csv << "\n";
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        for (size_t j = 0; j < rows[i].size(); ++j)
+            csv << (j ? "," : "") << rows[i][j];
+        for (const std::string &stage: stage_names)
+        {
+            auto mean_ms = stage_means_ms[i].find(stage);
+            csv << ","
+                << (mean_ms != stage_means_ms[i].end() ? mean_ms->second
+                                                       : 0.0);
+        }
+        csv << "\n";
+    }
+    std::cout << "Results written to " << output_path
+              << " (plot with plot_scaling.py)" << std::endl;
+
+    return 0;
+}
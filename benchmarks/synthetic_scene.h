@@ -0,0 +1,474 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+
+#include "DataType.h"
+
+
+/**
+ * @brief Parameters of a synthetic scene
+ *  The defaults give a sparse scene of large objects with a slight detection jitter,
+ *  crowd() a dense scene with occlusions, crossing objects, camera motion and detector errors.
+ */
+struct SceneParams
+{
+    int num_objects = 20;
+    cv::Size frame_size = cv::Size(1920, 1080);
+    uint64_t seed = 42;
+
+    // Objects: width in [min_width, max_width], height of 2-3 widths, speed up to max_speed px/frame
+    float min_width = 40.0F, max_width = 120.0F;
+    float max_speed = 4.0F;
+    float crossing_fraction = 0.0F;///< Fraction of the objects spawned in pairs on head-on crossing courses (ID swap candidates)
+
+    // Camera: horizontal pan of camera_pan * sin(camera_pan_frequency * frame) pixels
+    float camera_pan = 32.0F;
+    float camera_pan_frequency = 0.01F;
+
+    // Detector
+    float position_noise = 1.0F;         ///< Standard deviation of the box position (pixels)
+    float size_noise = 0.0F;             ///< Standard deviation of the box size (fraction of the size)
+    float miss_rate = 0.0F;              ///< Probability to miss a visible object
+    float min_visibility = 0.0F;         ///< Objects less visible than this (occluded) are not detected
+    float false_positives_per_frame = 0.0F;///< Mean number of false positives (low score boxes) per frame
+
+    /**
+     * @brief Dense crowd: the object size shrinks with the number of objects to keep about 1.5 objects
+     *  per object area (heavy occlusions), with crossing pairs, camera motion, misses and false positives
+     */
+    static SceneParams crowd(int num_objects, cv::Size frame_size)
+    {
+        SceneParams params;
+        params.num_objects = num_objects;
+        params.frame_size = frame_size;
+
+        const float area_per_object = static_cast<float>(frame_size.area()) /
+                                      static_cast<float>(num_objects);
+        params.max_width = std::clamp(
+                std::sqrt(area_per_object * 1.5F / 2.5F), 8.0F, 120.0F);
+        params.min_width = params.max_width / 3.0F;
+        params.max_speed = std::max(1.0F, params.max_width / 16.0F);
+        params.crossing_fraction = 0.2F;
+        params.camera_pan = 64.0F;
+        params.camera_pan_frequency = 0.05F;
+        params.position_noise = params.max_width / 40.0F;
+        params.size_noise = 0.03F;
+        params.miss_rate = 0.02F;
+        params.min_visibility = 0.3F;
+        params.false_positives_per_frame = 0.01F * num_objects;
+        return params;
+    }
+};
+
+
+/**
+ * @brief Object of a synthetic scene, moving at a constant velocity and bouncing off the frame borders
+ */
+struct SceneObject
+{
+    int id;
+    cv::Rect2f box;///< In scene coordinates (without the camera pan)
+    cv::Point2f velocity;
+    cv::Scalar color;
+};
+
+
+/**
+ * @brief Ground truth box of an object in the last frame (image coordinates)
+ */
+struct GroundTruthBox
+{
+    int id;
+    cv::Rect2f box;
+    float visibility;///< Fraction of the box not covered by nearer objects (approximated, 0 to 1)
+};
+
+
+/**
+ * @brief Uniform grid of boxes, for the neighbour queries of crowded scenes
+ */
+class BoxGrid
+{
+public:
+    BoxGrid(cv::Size area, float cell_size)
+        : _cell_size(std::max(1.0F, cell_size)),
+          _cols(std::max(1, static_cast<int>(area.width / _cell_size) + 1)),
+          _rows(std::max(1, static_cast<int>(area.height / _cell_size) + 1)),
+          _cells(static_cast<size_t>(_cols) * _rows)
+    {
+    }
+
+    void build(const std::vector<cv::Rect2f> &boxes)
+    {
+        for (std::vector<int> &cell: _cells)
+            cell.clear();
+        for (size_t i = 0; i < boxes.size(); ++i)
+            _for_each_cell(boxes[i], [&](std::vector<int> &cell) {
+                cell.push_back(static_cast<int>(i));
+            });
+    }
+
+    /**
+     * @brief Indices of the boxes sharing a cell with the given box (may contain duplicates)
+     */
+    template<typename Callback>
+    void for_each_candidate(const cv::Rect2f &box, Callback callback)
+    {
+        _for_each_cell(box, [&](std::vector<int> &cell) {
+            for (int index: cell)
+                callback(index);
+        });
+    }
+
+
+private:
+    template<typename Callback>
+    void _for_each_cell(const cv::Rect2f &box, Callback callback)
+    {
+        const int col_begin = _col(box.x), col_end = _col(box.x + box.width);
+        const int row_begin = _row(box.y), row_end = _row(box.y + box.height);
+        for (int row = row_begin; row <= row_end; ++row)
+            for (int col = col_begin; col <= col_end; ++col)
+                callback(_cells[static_cast<size_t>(row) * _cols + col]);
+    }
+
+    int _col(float x) const
+    {
+        return std::clamp(static_cast<int>(x / _cell_size), 0, _cols - 1);
+    }
+
+    int _row(float y) const
+    {
+        return std::clamp(static_cast<int>(y / _cell_size), 0, _rows - 1);
+    }
+
+
+private:
+    float _cell_size;
+    int _cols, _rows;
+    std::vector<std::vector<int>> _cells;
+};
+
+
+/**
+ * @brief Deterministic (seeded) synthetic scene: objects bouncing off the frame borders on a textured
+ *  background seen by a panning camera, and the noisy detections of a simulated detector.
+ *  Nearer objects (lower bottom edge) occlude farther ones; the ground truth of each frame gives the
+ *  identity, box and visibility of every object, the frame is only rendered on request.
+ */
+class SyntheticScene
+{
+public:
+    explicit SyntheticScene(const SceneParams &params)
+        : _params(params), _rng(params.seed)
+    {
+        const cv::Size &frame_size = params.frame_size;
+        const int num_crossing =
+                static_cast<int>(params.num_objects *
+                                 params.crossing_fraction) &
+                ~1;
+        for (int i = 0; i < params.num_objects; ++i)
+        {
+            SceneObject object;
+            object.id = i + 1;
+            object.box.width =
+                    _rng.uniform(params.min_width, params.max_width);
+            object.box.height = object.box.width * _rng.uniform(2.0F, 3.0F);
+            object.box.x = _rng.uniform(
+                    0.0F, frame_size.width - params.max_width);
+            object.box.y = _rng.uniform(
+                    0.0F, frame_size.height - 3.0F * params.max_width);
+            object.velocity = {_rng.uniform(-params.max_speed,
+                                            params.max_speed),
+                               _rng.uniform(-params.max_speed / 2.0F,
+                                            params.max_speed / 2.0F)};
+            object.color = cv::Scalar(_rng.uniform(0, 255),
+                                      _rng.uniform(0, 255),
+                                      _rng.uniform(0, 255));
+
+            // Second object of a crossing pair: same look, facing its partner
+            if (i < num_crossing && i % 2 == 1)
+            {
+                const SceneObject &partner = _objects.back();
+                const float distance = 20.0F * params.max_speed;
+                object.box = partner.box;
+                object.box.x = std::min(partner.box.x + distance,
+                                        frame_size.width - object.box.width);
+                object.box.y += _rng.uniform(-0.2F, 0.2F) * object.box.height;
+                object.velocity = -partner.velocity;
+                object.velocity.x = -std::abs(partner.velocity.x);
+                _objects.back().velocity.x = std::abs(partner.velocity.x);
+                object.color = partner.color;
+            }
+            _objects.push_back(object);
+        }
+        _grid_cell_size = 3.0F * params.max_width;
+    }
+
+    SyntheticScene(int num_objects, cv::Size frame_size)
+        : SyntheticScene(_default_params(num_objects, frame_size))
+    {
+    }
+
+    /**
+     * @brief Move the objects and return their noisy detections, without rendering the frame
+     */
+    void next(std::vector<Detection> &detections)
+    {
+        ++_frame_index;
+        const cv::Size &frame_size = _params.frame_size;
+        for (SceneObject &object: _objects)
+        {
+            object.box.x += object.velocity.x;
+            object.box.y += object.velocity.y;
+            if (object.box.x < 0 ||
+                object.box.x + object.box.width >= frame_size.width)
+                object.velocity.x = -object.velocity.x;
+            if (object.box.y < 0 ||
+                object.box.y + object.box.height >= frame_size.height)
+                object.velocity.y = -object.velocity.y;
+        }
+        _update_ground_truth();
+
+        detections.clear();
+        for (const GroundTruthBox &object: _ground_truth)
+        {
+            if (object.visibility < _params.min_visibility ||
+                (_params.miss_rate > 0.0F &&
+                 _rng.uniform(0.0F, 1.0F) < _params.miss_rate))
+                continue;
+
+            Detection detection;
+            detection.bbox_tlwh = object.box;
+            detection.bbox_tlwh.x += _rng.gaussian(_params.position_noise);
+            detection.bbox_tlwh.y += _rng.gaussian(_params.position_noise);
+            if (_params.size_noise > 0.0F)
+            {
+                detection.bbox_tlwh.width *=
+                        1.0F + _rng.gaussian(_params.size_noise);
+                detection.bbox_tlwh.height *=
+                        1.0F + _rng.gaussian(_params.size_noise);
+            }
+            detection.class_id = 0;
+            detection.confidence = _rng.uniform(0.5F, 0.95F);
+            if (_params.min_visibility > 0.0F)
+                detection.confidence *= 0.5F + 0.5F * object.visibility;
+            detections.push_back(detection);
+        }
+
+        _add_false_positives(detections);
+    }
+
+    /**
+     * @brief Move the objects, render the frame and return the noisy detections
+     */
+    void next(cv::Mat &frame, std::vector<Detection> &detections)
+    {
+        next(detections);
+        render(frame);
+    }
+
+    /**
+     * @brief Render the current frame: background seen by the camera, objects drawn from far to near
+     */
+    void render(cv::Mat &frame)
+    {
+        const int margin = static_cast<int>(std::ceil(_params.camera_pan));
+        if (_background.empty())
+        {
+            cv::RNG background_rng(_params.seed);
+            _background.create(_params.frame_size.height + 2 * margin,
+                               _params.frame_size.width + 2 * margin, CV_8UC3);
+            background_rng.fill(_background, cv::RNG::UNIFORM,
+                                cv::Scalar::all(0), cv::Scalar::all(255));
+            cv::GaussianBlur(_background, _background, cv::Size(7, 7), 0);
+        }
+
+        const int pan_x =
+                margin + static_cast<int>(std::lround(_camera_shift()));
+        _background(cv::Rect(pan_x, margin, _params.frame_size.width,
+                             _params.frame_size.height))
+                .copyTo(frame);
+        for (int index: _depth_order)
+            cv::rectangle(frame, _ground_truth[index].box,
+                          _objects[index].color, cv::FILLED);
+    }
+
+    /**
+     * @brief Ground truth of the last frame, one box per object (including the occluded ones)
+     */
+    const std::vector<GroundTruthBox> &ground_truth() const
+    {
+        return _ground_truth;
+    }
+
+
+private:
+    static SceneParams _default_params(int num_objects, cv::Size frame_size)
+    {
+        SceneParams params;
+        params.num_objects = num_objects;
+        params.frame_size = frame_size;
+        return params;
+    }
+
+    /**
+     * @brief Horizontal offset of the image in the scene
+     */
+    float _camera_shift() const
+    {
+        return _params.camera_pan *
+               std::sin(_params.camera_pan_frequency *
+                        static_cast<float>(_frame_index));
+    }
+
+    /**
+     * @brief Image boxes and visibility of the objects
+     *  The visibility is 1 minus the area covered by the nearer objects (overlaps between occluders
+     *  are counted twice, so it is a lower bound), found with a grid of the boxes.
+     */
+    void _update_ground_truth()
+    {
+        const float shift = _camera_shift();
+        _ground_truth.resize(_objects.size());
+        _boxes.resize(_objects.size());
+        for (size_t i = 0; i < _objects.size(); ++i)
+        {
+            _boxes[i] = _objects[i].box;
+            _boxes[i].x -= shift;
+            _ground_truth[i] = {_objects[i].id, _boxes[i], 1.0F};
+        }
+
+        // Far to near: the bottom edge of nearer objects is lower in the image
+        _depth_order.resize(_objects.size());
+        std::iota(_depth_order.begin(), _depth_order.end(), 0);
+        std::sort(_depth_order.begin(), _depth_order.end(),
+                  [this](int a, int b) {
+                      return _boxes[a].br().y < _boxes[b].br().y;
+                  });
+        if (_params.min_visibility <= 0.0F)
+            return;
+
+        std::vector<int> depth_rank(_objects.size());
+        for (size_t rank = 0; rank < _depth_order.size(); ++rank)
+            depth_rank[_depth_order[rank]] = static_cast<int>(rank);
+
+        cv::Size grid_area(_params.frame_size.width +
+                                   2 * static_cast<int>(_params.camera_pan),
+                           _params.frame_size.height);
+        if (!_grid || _grid_area != grid_area)
+        {
+            _grid = std::make_unique<BoxGrid>(grid_area, _grid_cell_size);
+            _grid_area = grid_area;
+        }
+        std::vector<cv::Rect2f> grid_boxes = _boxes;
+        for (cv::Rect2f &box: grid_boxes)
+            box.x += _params.camera_pan;
+        _grid->build(grid_boxes);
+
+        std::vector<int> visited(_objects.size(), -1);
+        for (size_t i = 0; i < _objects.size(); ++i)
+        {
+            float covered_area = 0.0F;
+            _grid->for_each_candidate(grid_boxes[i], [&](int j) {
+                if (visited[j] == static_cast<int>(i) ||
+                    depth_rank[j] <= depth_rank[i])
+                    return;
+                visited[j] = static_cast<int>(i);
+                covered_area += (_boxes[i] & _boxes[j]).area();
+            });
+            _ground_truth[i].visibility = std::max(
+                    0.0F, 1.0F - covered_area / _boxes[i].area());
+        }
+    }
+
+    void _add_false_positives(std::vector<Detection> &detections)
+    {
+        if (_params.false_positives_per_frame <= 0.0F)
+            return;
+
+        // Poisson number of false positives
+        const float limit = std::exp(-_params.false_positives_per_frame);
+        float product = _rng.uniform(0.0F, 1.0F);
+        while (product > limit)
+        {
+            Detection detection;
+            detection.bbox_tlwh.width =
+                    _rng.uniform(_params.min_width, _params.max_width);
+            detection.bbox_tlwh.height =
+                    detection.bbox_tlwh.width * _rng.uniform(1.0F, 3.0F);
+            detection.bbox_tlwh.x = _rng.uniform(
+                    0.0F, _params.frame_size.width - _params.max_width);
+            detection.bbox_tlwh.y = _rng.uniform(
+                    0.0F, _params.frame_size.height - 3.0F * _params.max_width);
+            detection.class_id = 0;
+            detection.confidence = _rng.uniform(0.1F, 0.65F);
+            detections.push_back(detection);
+            product *= _rng.uniform(0.0F, 1.0F);
+        }
+    }
+
+
+private:
+    SceneParams _params;
+    std::vector<SceneObject> _objects;
+    cv::RNG _rng;
+    int _frame_index = 0;
+
+    std::vector<GroundTruthBox> _ground_truth;
+    std::vector<cv::Rect2f> _boxes;
+    std::vector<int> _depth_order;
+
+    float _grid_cell_size = 0.0F;
+    cv::Size _grid_area;
+    std::unique_ptr<BoxGrid> _grid;
+
+    cv::Mat _background;
+};
+
+
+/**
+ * @brief Copy the tracker config with the given [BoTSORT] keys overridden
+ *
+ * @param tracker_config_path Tracker config to copy
+ * @param overrides Lines "key = value" replacing the keys of the config
+ * @param name Name of the copy, in the temporary directory
+ * @return std::string Path of the copy
+ */
+inline std::string
+write_tracker_config(const std::string &tracker_config_path,
+                     const std::vector<std::string> &overrides,
+                     const std::string &name)
+{
+    std::ifstream input(tracker_config_path);
+    std::stringstream config;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        const std::string key = line.substr(0, line.find_first_of(" =\t"));
+        bool overridden = false;
+        for (const std::string &override: overrides)
+            overridden |= override.substr(0, override.find(' ')) == key;
+
+        if (!overridden)
+            config << line << "\n";
+    }
+    for (const std::string &override: overrides)
+        config << override << "\n";
+
+    const std::string path =
+            (std::filesystem::temp_directory_path() / (name + ".ini"))
+                    .string();
+    std::ofstream(path) << config.str();
+    return path;
+}
@@ -1,12 +1,46 @@
 #pragma once
 
+#include <chrono>
 #include <string>
+#include <unordered_map>
 
+#include "FrameArena.h"
 #include "GlobalMotionCompensation.h"
 #include "ReID.h"
+#include "ReIDWorker.h"
+#include "TrackPool.h"
+#include "replay.h"
 #include "track.h"
 
 
+/**
+ * @brief Per-frame counters of the re-ID feature extraction
+ */
+struct ReIDStats
+{
+    uint32_t candidates = 0;///< Detections above track_low_thresh
+    uint32_t extracted = 0; ///< Detections for which an embedding was computed
+    uint32_t skipped = 0;   ///< Detections skipped by selective re-ID or served from the feature cache
+    uint32_t deferred = 0;///< Extracted features applied one frame late (reid_late_features)
+
+    // Feature cache (reid_cache only)
+    uint32_t cache_lookups = 0;///< Detections looked up in the feature cache
+    uint32_t cache_hits = 0;   ///< Detections that reused a cached feature (inference saved)
+
+    float cache_hit_rate() const
+    {
+        return cache_lookups ? static_cast<float>(cache_hits) /
+                                       static_cast<float>(cache_lookups)
+                             : 0.0F;
+    }
+
+    // Reasons for the extraction (selective re-ID only)
+    uint32_t ambiguous = 0;///< Detection in a cluster of several nearby tracks/detections
+    uint32_t new_track = 0;///< Detection without nearby track, candidate for a new track
+    uint32_t stale = 0;    ///< Single nearby track with a missing or stale feature
+};
+
+
 class BOTSORT_EXPORT BoTSORT
 {
 public:
@@ -27,40 +61,234 @@ public:
     std::vector<std::shared_ptr<Track>>
     track(const std::vector<Detection> &detections, const cv::Mat &frame);
 
+    /**
+     * @brief Track the objects in the frame, into a vector owned by the caller
+     *  The capacity of output_tracks is reused: once warmed up, the tracker state, its per-frame
+     *  scratch memory (frame arena) and the Track objects of the detections (track pool) are reused,
+     *  so that track() does not allocate (without Re-ID and GMC)
+     * 
+     * @param detections Detections in the frame
+     * @param frame Frame
+     * @param output_tracks Output tracks, overwritten
+     */
+    void track(const std::vector<Detection> &detections, const cv::Mat &frame,
+               std::vector<std::shared_ptr<Track>> &output_tracks);
+
+    /**
+     * @brief Track a recorded frame (see replay.h): track() on the recorded detections and frame size,
+     *  with the recorded homography and ReID features instead of GMC and inference, so that only the
+     *  association and the Kalman filter run. Replaying a session with the tracker config of the
+     *  recording reproduces its tracks (the IDs are offset if other tracks were created before).
+     * 
+     * @param frame Recorded frame
+     * @param session Settings of the recorded tracker
+     * @return std::vector<std::shared_ptr<Track>> 
+     */
+    std::vector<std::shared_ptr<Track>>
+    replay(const bot_replay::FrameRecord &frame,
+           const bot_replay::SessionInfo &session);
+
+    /**
+     * @brief Record the following track() calls to a session file, for BoTSORT::replay()
+     *  Start before the first frame for a replay to reproduce the session. The features applied
+     *  one frame late (reid_late_features) are recorded with the frame they are applied in.
+     * 
+     * @param filepath Session file, overwritten
+     * @return true if the file was created
+     */
+    bool start_recording(const std::string &filepath);
+
+    void stop_recording();
+
+    /**
+     * @brief Get the re-ID counters of the last tracked frame
+     * 
+     * @return const ReIDStats& Re-ID counters
+     */
+    const ReIDStats &get_reid_stats() const
+    {
+        return _reid_stats;
+    }
+
+    /**
+     * @brief Memory used by the tracker state: the tracker, its tracked and lost tracks and the free tracks of its track pool (bytes)
+     *  The Re-ID model, GMC and Kalman filter are not included
+     * 
+     * @return size_t Memory footprint (bytes)
+     */
+    size_t memory_footprint() const;
+
 
 private:
     /**
-     * @brief Extract visual features from the given frame and bounding box
+     * @brief Body of track() and replay()
+     * 
+     * @param detections Detections in the frame
+     * @param frame Frame, empty when replaying
+     * @param frame_size Size of the frame
+     * @param replay_frame Recorded frame when replaying, nullptr otherwise
+     * @param replay_session Settings of the recorded tracker when replaying, nullptr otherwise
+     * @param output_tracks Output tracks, overwritten
+     */
+    void _track(const std::vector<Detection> &detections, const cv::Mat &frame,
+                cv::Size frame_size,
+                const bot_replay::FrameRecord *replay_frame,
+                const bot_replay::SessionInfo *replay_session,
+                std::vector<std::shared_ptr<Track>> &output_tracks);
+
+    /**
+     * @brief Set the recorded features of a replayed frame on its detections
+     * 
+     * @param detection_tracks Track created for each detection (nullptr below track_low_thresh)
+     * @param replay_frame Recorded frame
+     * @return size_t Number of detections with a feature
+     */
+    static size_t _set_replay_features(
+            const std::vector<std::shared_ptr<Track>> &detection_tracks,
+            const bot_replay::FrameRecord &replay_frame);
+
+    /**
+     * @brief Write the frame being recorded, with its features and output tracks
+     */
+    void _write_record(
+            const std::vector<std::shared_ptr<Track>> &detection_tracks,
+            const std::vector<std::shared_ptr<Track>> &output_tracks);
+
+    /**
+     * @brief Extract visual features from the given frame for all the detections (batched inference)
      * 
      * @param frame Input frame
-     * @param bbox_tlwh Bounding box (top, left, width, height)
-     * @return FeatureVector Extracted visual features
+     * @param detections Detections to embed
+     * @return ReIDFeatures Extracted visual features, one row per detection
+     */
+    ReIDFeatures
+    _extract_features(const cv::Mat &frame,
+                      const std::vector<std::shared_ptr<Track>> &detections);
+
+    /**
+     * @brief Get the detections to embed: all detections, or the selection of _select_reid_detections()
+     *  Detections served from the feature cache (reid_cache) are not returned
      */
-    FeatureVector _extract_features(const cv::Mat &frame,
-                                    const cv::Rect_<float> &bbox_tlwh);
+    std::vector<std::shared_ptr<Track>> _get_reid_detections(
+            const cv::Mat &frame,
+            const std::vector<std::shared_ptr<Track>> &detections_high_conf,
+            const std::vector<std::shared_ptr<Track>> &detections_low_conf,
+            const std::vector<std::shared_ptr<Track>> &tracks_pool,
+            const std::vector<std::shared_ptr<Track>> &unconfirmed_tracks);
 
     /**
-     * @brief Merge the given track lists
+     * @brief Get the bounding boxes of the given detections as integer regions
+     */
+    static std::vector<cv::Rect>
+    _get_rois(const std::vector<std::shared_ptr<Track>> &detections);
+
+    /**
+     * @brief Set the features of the given detections, one row per detection
+     *  The detections of invalid rows are left without features
+     */
+    void _set_features(const std::vector<std::shared_ptr<Track>> &detections,
+                       const ReIDFeatures &features);
+
+    /**
+     * @brief Set the feature of a detection of the current frame, keeping a copy if the session is recorded
+     */
+    void _set_detection_feature(const std::shared_ptr<Track> &detection,
+                                const FeatureVector &feature);
+
+    /**
+     * @brief Reuse the cached feature of a track for the detections whose crop did not change (feature cache)
+     *  A cached feature is reused if its box overlaps the detection with IoU >= reid_cache_min_iou,
+     *  it is at most reid_cache_max_age frames old, no other detection claims it
+     *  and the mean absolute difference of the crop thumbnails is <= reid_cache_max_appearance_change.
+     * 
+     * @param frame Input frame
+     * @param detections Detections to embed
+     * @param tracks Tracks the detections can be associated with
+     * @return std::vector<std::shared_ptr<Track>> Detections that still need an embedding
+     */
+    std::vector<std::shared_ptr<Track>> _reuse_cached_features(
+            const cv::Mat &frame,
+            const std::vector<std::shared_ptr<Track>> &detections,
+            const std::vector<std::shared_ptr<Track>> &tracks);
+
+    /**
+     * @brief Store the features extracted in this frame in the cache of the associated tracks, evict removed tracks
+     */
+    void _update_feature_cache();
+
+    /**
+     * @brief Downscaled crop of the bounding box, used to detect appearance changes cheaply
+     */
+    static cv::Mat _crop_thumbnail(const cv::Mat &frame,
+                                   const std::vector<float> &tlwh);
+
+    /**
+     * @brief Mean absolute difference of two thumbnails in [0, 1] (1 if they can't be compared)
+     */
+    static float _appearance_change(const cv::Mat &thumbnail_a,
+                                    const cv::Mat &thumbnail_b);
+
+    /**
+     * @brief Remember the track a detection was associated with (late features and feature cache)
+     * 
+     * @param detection Detection
+     * @param track Track updated (or created) with the detection
+     */
+    void _record_association(const std::shared_ptr<Track> &detection,
+                             const std::shared_ptr<Track> &track);
+
+    /**
+     * @brief Wait for the features deferred on the previous frame and update the associated tracks
+     * 
+     * @param replay_frame Recorded frame when replaying (the features are read from it), nullptr otherwise
+     */
+    void _apply_late_features(const bot_replay::FrameRecord *replay_frame);
+
+    /**
+     * @brief Update the per-frame metrics of the stream (see metrics.h): frame rate, detections, track counts
+     */
+    void _update_frame_metrics(size_t num_detections, size_t num_output_tracks);
+
+    /**
+     * @brief Select the high confidence detections that need an embedding (selective re-ID)
+     *  IoU gating with proximity_thresh is computed first, an embedding is only extracted for detections
+     *  - in an ambiguous cluster (several candidate tracks, or a candidate track shared with other detections)
+     *  - without candidate track, which may start a new track
+     *  - whose single candidate track has a missing or stale feature
+     *  Low confidence detections are only used in the IoU-only second association and are never embedded.
+     * 
+     * @param detections_high_conf High confidence detections
+     * @param tracks_pool Tracked and lost tracks (after KF predict and GMC)
+     * @param unconfirmed_tracks Unconfirmed tracks (after GMC)
+     * @return std::vector<std::shared_ptr<Track>> Detections to be embedded
+     */
+    std::vector<std::shared_ptr<Track>> _select_reid_detections(
+            const std::vector<std::shared_ptr<Track>> &detections_high_conf,
+            const std::vector<std::shared_ptr<Track>> &tracks_pool,
+            const std::vector<std::shared_ptr<Track>> &unconfirmed_tracks);
+
+    /**
+     * @brief Merge the given track lists, the tracks of list b whose ID is already merged are skipped
      * 
      * @param tracks_list_a Track list a
      * @param tracks_list_b Track list b
-     * @return std::vector<std::shared_ptr<Track>> Merged track list
+     * @param merged_tracks_list Merged track list, overwritten (must not be one of the input lists)
      */
-    static std::vector<std::shared_ptr<Track>>
-    _merge_track_lists(std::vector<std::shared_ptr<Track>> &tracks_list_a,
-                       std::vector<std::shared_ptr<Track>> &tracks_list_b);
+    void _merge_track_lists(
+            const std::vector<std::shared_ptr<Track>> &tracks_list_a,
+            const std::vector<std::shared_ptr<Track>> &tracks_list_b,
+            std::vector<std::shared_ptr<Track>> &merged_tracks_list);
 
 
     /**
-     * @brief Remove tracks from the given track list
+     * @brief Remove tracks from the given track list, in place
      * 
      * @param tracks_list List from which tracks are to be removed
      * @param tracks_to_remove Subset of tracks to be removed
-     * @return std::vector<std::shared_ptr<Track>> Track list after removing tracks
      */
-    static std::vector<std::shared_ptr<Track>>
-    _remove_from_list(std::vector<std::shared_ptr<Track>> &tracks_list,
-                      std::vector<std::shared_ptr<Track>> &tracks_to_remove);
+    void _remove_from_list(
+            std::vector<std::shared_ptr<Track>> &tracks_list,
+            const std::vector<std::shared_ptr<Track>> &tracks_to_remove);
 
 
     /**
@@ -73,11 +301,11 @@ private:
      * @param tracks_list_a Input track list a
      * @param tracks_list_b Input track list b
      */
-    static void _remove_duplicate_tracks(
+    void _remove_duplicate_tracks(
             std::vector<std::shared_ptr<Track>> &result_tracks_a,
             std::vector<std::shared_ptr<Track>> &result_tracks_b,
-            std::vector<std::shared_ptr<Track>> &tracks_list_a,
-            std::vector<std::shared_ptr<Track>> &tracks_list_b);
+            const std::vector<std::shared_ptr<Track>> &tracks_list_a,
+            const std::vector<std::shared_ptr<Track>> &tracks_list_b);
 
 
     /**
@@ -90,16 +318,73 @@ private:
 
 private:
     std::string _gmc_method_name;
-    bool _reid_enabled, _gmc_enabled;
+    bool _reid_enabled, _gmc_enabled, _selective_reid, _reid_async,
+            _reid_late_features, _reid_cache_enabled;
     uint8_t _track_buffer, _frame_rate, _buffer_size, _max_time_lost;
     float _track_high_thresh, _track_low_thresh, _new_track_thresh,
-            _match_thresh, _proximity_thresh, _appearance_thresh, _lambda;
-    unsigned int _frame_id;
+            _match_thresh, _proximity_thresh, _appearance_thresh, _lambda,
+            _reid_cache_min_iou, _reid_cache_max_appearance_change;
+    unsigned int _frame_id, _reid_max_feature_age, _reid_cache_max_age;
+    int _feat_history_size;
+    FeatureFormat _feat_history_format, _appearance_format;
+    ReIDStats _reid_stats;
+
+    // Metrics stream (profiler stream of the calling thread) and input frame rate
+    uint16_t _metrics_stream_id = 0;
+    std::chrono::steady_clock::time_point _last_frame_time;
+    double _frames_per_second = 0.0;
 
     std::vector<std::shared_ptr<Track>> _tracked_tracks;
     std::vector<std::shared_ptr<Track>> _lost_tracks;
 
+    // Per-frame scratch memory: cost matrices and LAPJV workspace in the arena (reset at the start
+    // of each frame), track lists cleared at the end of each frame but kept to reuse their capacity
+    FrameArena _frame_arena;
+    struct FrameScratch
+    {
+        std::vector<std::shared_ptr<Track>> detection_tracks,
+                detections_high_conf, detections_low_conf, unconfirmed_tracks,
+                tracked_tracks, tracks_pool, activated_tracks, refind_tracks,
+                lost_tracks, removed_tracks, unmatched_tracks,
+                unmatched_detections, unmatched_high_conf_detections,
+                updated_tracked_tracks, merged_tracks, tracked_tracks_cleaned,
+                lost_tracks_cleaned;
+        AssociationData first_associations, second_associations,
+                unconfirmed_associations;
+        std::vector<int> track_ids;///< Sorted track IDs (merge and remove)
+
+        void clear();
+    };
+    FrameScratch _scratch;
+    std::vector<Detection> _replay_detections;
+
     std::unique_ptr<KalmanFilter> _kalman_filter;
+    std::unique_ptr<TrackPool> _track_pool;///< Tracks of the detections
     std::unique_ptr<GlobalMotionCompensation> _gmc_algo;
     std::unique_ptr<ReIDModel> _reid_model;
+    std::unique_ptr<ReIDWorker> _reid_worker;///< Declared after the model it uses
+
+    // Features of the previous frame that arrive one frame late
+    ReIDWorker::Ticket _late_ticket = 0;
+    unsigned int _late_frame_id = 0;
+    std::vector<std::shared_ptr<Track>> _late_detections;
+
+    // Track updated (or created) with each detection of the current frame
+    std::unordered_map<const Track *, std::shared_ptr<Track>> _associations;
+
+    // Last extracted feature of each track, with the box and thumbnail of its crop
+    struct ReIDCacheEntry
+    {
+        std::vector<float> tlwh;
+        cv::Mat thumbnail;
+        FeatureVector feat;
+        unsigned int frame_id = 0;
+    };
+    std::unordered_map<int, ReIDCacheEntry> _reid_cache;
+    std::unordered_map<const Track *, ReIDCacheEntry> _reid_cache_pending;
+
+    // Session recording: the frame being recorded and the features given to its detections
+    std::unique_ptr<bot_replay::ReplayWriter> _recorder;
+    bot_replay::FrameRecord _record;
+    std::unordered_map<const Track *, FeatureVector> _recorded_features;
 };
\ No newline at end of file
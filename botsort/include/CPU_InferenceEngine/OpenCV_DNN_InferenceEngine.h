@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/dnn.hpp>
+
+#include "InferenceEngine.h"
+
+namespace inference_backend
+{
+/**
+ * @brief CPU inference engine based on the OpenCV DNN module (loads the ONNX model directly)
+ */
+class OpenCVDNNInferenceEngine : public InferenceEngine
+{
+public:
+    explicit OpenCVDNNInferenceEngine(const InferenceEngineParams &params);
+    ~OpenCVDNNInferenceEngine() override = default;
+
+    bool load_model(const std::string &onnx_model_path) override;
+    ModelPredictions forward_batch(const cv::Mat &input_blob) override;
+
+    int max_batch_size() const override
+    {
+        return _max_batch_size;
+    }
+
+
+private:
+    /**
+     * @brief Check if the model accepts batches larger than one (the batch dimension of some exported
+     *  models is static), otherwise limit the batch size to 1
+     */
+    void _probe_batch_support();
+
+
+private:
+    InferenceEngineParams _params;
+    cv::dnn::Net _net;
+    int _max_batch_size = 1;
+
+    std::vector<cv::Mat> _outputs;
+};
+}// namespace inference_backend
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "DataType.h"
+#include "FeatureQuantization.h"
+
+
+/**
+ * @brief Fixed capacity ring buffer of Re-ID feature vectors
+ *  The entries are stored back to back in one buffer, encoded in the configured format.
+ *  The buffer grows with the number of entries up to the capacity, then the oldest entry is overwritten.
+ *  A history with capacity 0 stores nothing.
+ */
+class FeatureHistory
+{
+public:
+    explicit FeatureHistory(size_t capacity = 0,
+                            FeatureFormat format = FeatureFormat::Float32);
+
+    /**
+     * @brief Append a feature vector, overwriting the oldest one if the history is full
+     */
+    void push(const FeatureVector &feat);
+
+    /**
+     * @brief Decode the i-th feature vector (0 is the oldest)
+     */
+    FeatureVector at(size_t index) const;
+
+    /**
+     * @brief Remove all the entries, the buffer keeps its capacity (see TrackPool)
+     */
+    void clear();
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    FeatureFormat format() const
+    {
+        return _format;
+    }
+
+    /**
+     * @brief Heap memory used by the history (bytes)
+     */
+    size_t memory_footprint() const
+    {
+        return _data.capacity();
+    }
+
+
+private:
+    size_t _capacity, _entry_bytes;
+    FeatureFormat _format;
+
+    size_t _size = 0, _oldest = 0;
+    std::vector<uint8_t> _data;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "DataType.h"
+
+
+/**
+ * @brief Storage format of a Re-ID feature vector
+ *  - Float32: FEATURE_DIM floats
+ *  - Float16: FEATURE_DIM IEEE half floats
+ *  - Int8: one float scale followed by FEATURE_DIM signed bytes, x ~= scale * q (symmetric, per-vector scale)
+ */
+enum class FeatureFormat
+{
+    Float32 = 0,
+    Float16,
+    Int8
+};
+
+
+/**
+ * @brief Parse the feature format name (fp32, fp16 or int8)
+ */
+FeatureFormat feature_format_from_string(const std::string &name);
+
+/**
+ * @brief Number of bytes of a feature vector encoded in the given format
+ */
+size_t feature_storage_bytes(FeatureFormat format);
+
+/**
+ * @brief Encode a feature vector in the given format
+ *
+ * @param feat Feature vector
+ * @param format Storage format
+ * @param dst Output buffer of feature_storage_bytes(format) bytes
+ */
+void encode_feature(const FeatureVector &feat, FeatureFormat format,
+                    uint8_t *dst);
+
+/**
+ * @brief Decode a feature vector encoded with encode_feature()
+ *
+ * @param src Encoded feature vector
+ * @param format Storage format
+ * @param feat Decoded feature vector
+ */
+void decode_feature(const uint8_t *src, FeatureFormat format,
+                    FeatureVector &feat);
+
+/**
+ * @brief Dot product of two feature vectors encoded in the same format
+ *  The FP16 and INT8 kernels use the SIMD instructions enabled at compile time:
+ *  F16C + FMA / AVX2, AVX-VNNI or AVX512-VNNI on x86, NEON (with the dot product extension) on AArch64
+ *
+ * @param a Encoded feature vector a
+ * @param b Encoded feature vector b
+ * @param format Storage format of both vectors
+ * @return float Dot product
+ */
+float encoded_dot(const uint8_t *a, const uint8_t *b, FeatureFormat format);
+
+/**
+ * @brief Names of the SIMD kernels used by encoded_dot() (e.g. "fp16: F16C, int8: AVX-VNNI")
+ */
+std::string feature_kernels_description();
+
+/**
+ * @brief Convert a float to an IEEE half float (round to nearest even)
+ */
+uint16_t float_to_half(float value);
+
+/**
+ * @brief Convert an IEEE half float to a float
+ */
+float half_to_float(uint16_t value);
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "DataType.h"
+#include "botsort_export.h"
+
+
+/**
+ * @brief Bump allocator of the per-frame scratch memory of a tracker (cost matrices, assignment workspace)
+ *  The memory is handed out linearly and released all at once by reset(), at the start of each frame.
+ *  A frame that needs more than the current block gets additional blocks; reset() then replaces them
+ *  with a single block of the peak size, so that once warmed up (or with a large enough initial
+ *  capacity) a frame does not allocate at all. Nothing is constructed or destroyed in the arena,
+ *  it only holds trivially destructible types.
+ */
+class BOTSORT_EXPORT FrameArena
+{
+public:
+    /**
+     * @param initial_capacity Size of the first block (bytes), allocated as is: an arena sized for a
+     *  known workload (see array_bytes()) takes no more. The blocks added on overflow are larger.
+     */
+    explicit FrameArena(size_t initial_capacity = 0);
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    /**
+     * @brief Allocate uninitialized memory (aligned to alignof(std::max_align_t)), valid until reset()
+     */
+    void *allocate(size_t bytes);
+
+    template<typename T>
+    T *allocate_array(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T> &&
+                              alignof(T) <= ALIGNMENT,
+                      "FrameArena only holds trivially destructible types");
+        return static_cast<T *>(allocate(count * sizeof(T)));
+    }
+
+    /**
+     * @brief Arena memory taken by allocate_array<T>(count) (bytes)
+     */
+    template<typename T>
+    static constexpr size_t array_bytes(size_t count)
+    {
+        return (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /**
+     * @brief Allocate an uninitialized cost matrix
+     */
+    Eigen::Map<CostMatrix> matrix(Eigen::Index rows, Eigen::Index cols)
+    {
+        return {allocate_array<float>(static_cast<size_t>(rows * cols)), rows,
+                cols};
+    }
+
+    /**
+     * @brief Release all the allocations, the blocks added since the last reset are merged into one
+     */
+    void reset();
+
+    /**
+     * @brief Size of the blocks (bytes)
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief Largest memory used between two resets (bytes)
+     */
+    size_t high_water_mark() const
+    {
+        return _high_water_mark;
+    }
+
+    /**
+     * @brief Number of blocks allocated since the construction, stops growing once warmed up
+     */
+    size_t block_allocations() const
+    {
+        return _block_allocations;
+    }
+
+
+private:
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+    static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    void _add_block(size_t size);
+
+
+private:
+    std::vector<Block> _blocks;
+    size_t _offset = 0;///< Used bytes of the last block
+    size_t _used = 0;  ///< Allocated bytes since the last reset
+    size_t _high_water_mark = 0;
+    size_t _block_allocations = 0;
+};
@@ -7,6 +7,7 @@
 // .clang-format off
 #include "DataType.h"
 // .clang-format on
+#include "RansacMotionEstimator.h"
 
 #include <opencv2/core/eigen.hpp>
 #include <opencv2/core/mat.hpp>
@@ -27,6 +28,38 @@ enum GMC_Method
 };
 
 
+/**
+ * @brief Keypoint detection mask which ignores the frame border and the foreground (detections)
+ *  The mask buffer is reused across frames, only the rectangles masked out in the previous frame
+ *  are restored before the current detections are masked out
+ */
+class GMC_DetectionMask
+{
+public:
+    /**
+     * @brief Update the mask for the given (downscaled) frame size and detections
+     * 
+     * @param frame_size Size of the frame on which keypoints are detected
+     * @param detections Detections in the full resolution frame
+     * @param downscale Downscale factor applied to the frame
+     * @return const cv::Mat& Keypoint detection mask (CV_8UC1, 255 = keypoints allowed)
+     */
+    const cv::Mat &update(const cv::Size &frame_size,
+                          const std::vector<Detection> &detections,
+                          float downscale);
+
+
+private:
+    void _reset(const cv::Size &frame_size);
+
+
+private:
+    cv::Mat _mask;
+    cv::Rect _valid_roi;
+    std::vector<cv::Rect> _masked_rects;
+};
+
+
 class GMC_Algorithm
 {
 public:
@@ -51,6 +84,7 @@ private:
 private:
     std::string _algo_name = "orb";
     float _downscale;
+    GMC_DetectionMask _mask;
     cv::Ptr<cv::FeatureDetector> _detector;
     cv::Ptr<cv::DescriptorExtractor> _extractor;
     cv::Ptr<cv::DescriptorMatcher> _matcher;
@@ -59,8 +93,8 @@ private:
     cv::Mat _prev_frame;
     std::vector<cv::KeyPoint> _prev_keypoints;
     cv::Mat _prev_descriptors;
-    float _inlier_ratio, _ransac_conf;
-    int _ransac_max_iters;
+    float _inlier_ratio;
+    RansacMotionEstimator _ransac;
 };
 
 
@@ -78,11 +112,14 @@ private:
 
 private:
     std::string _algo_name = "ecc";
-    float _downscale;
-    int _max_iterations, _termination_eps;
+    float _downscale, _termination_eps, _early_exit_correlation;
+    int _max_iterations, _pyramid_levels;
+    bool _use_prev_warp;
 
     bool _first_frame_initialized = false;
-    cv::Mat _prev_frame;
+    cv::Mat _frame_gray, _frame_small;
+    std::vector<cv::Mat> _prev_pyramid, _curr_pyramid;
+    cv::Mat _warp, _level_warp;///< 2x3 euclidean warp at the (downscaled) frame scale
     cv::Size _gaussian_blur_kernel_size = cv::Size(3, 3);
     cv::TermCriteria _termination_criteria;
 };
@@ -99,20 +136,39 @@ public:
 private:
     void _load_params_from_config(const std::string &config_dir);
 
+    /**
+     * @brief Detect keypoints to track, either over the whole frame or bucketed in a grid
+     *  with a per-cell budget (which spreads the keypoints over the background)
+     * 
+     * @param frame Grayscale (downscaled) frame
+     * @param mask Keypoint detection mask, empty if no masking is required
+     * @param keypoints Output keypoints
+     */
+    void _detect_keypoints(const cv::Mat &frame, const cv::Mat &mask,
+                           std::vector<cv::Point2f> &keypoints);
+
 
 private:
     std::string _algo_name = "sparseOptFlow";
     float _downscale;
+    bool _detections_masking;
+    GMC_DetectionMask _mask;
 
     bool _first_frame_initialized = false;
     cv::Mat _prev_frame;
     std::vector<cv::Point2f> _prev_keypoints;
 
     // Parameters
-    int _maxCorners, _blockSize, _ransac_max_iters;
+    int _maxCorners, _blockSize;
     double _qualityLevel, _k, _minDistance;
     bool _useHarrisDetector;
-    float _inlier_ratio, _ransac_conf;
+    float _inlier_ratio;
+    RansacMotionEstimator _ransac;
+
+    // Grid-bucketed keypoint detection
+    int _grid_rows, _grid_cols, _corners_per_cell, _fast_threshold;
+    bool _use_fast_detector, _parallel_detection;
+    std::vector<std::vector<cv::Point2f>> _cell_keypoints;
 };
 
 
@@ -131,6 +187,18 @@ private:
 private:
     std::string _algo_name = "OptFlowModified";
     float _downscale;
+    int _grid_rows, _grid_cols, _win_size;
+    double _min_response;
+    bool _detections_masking;
+    GMC_DetectionMask _mask;
+    RansacMotionEstimator _ransac;
+
+    bool _first_frame_initialized = false;
+    cv::Mat _frame_small, _prev_gray, _curr_gray, _prev_float, _curr_float;
+    cv::Mat _window;
+    std::vector<cv::Point2f> _grid_points, _prev_points, _curr_points;
+    std::vector<uchar> _status;
+    std::vector<float> _err;
 };
 
 
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace inference_backend
+{
+/**
+ * @brief Non-owning view of the output of an inference engine
+ *  The data belongs to the engine and stays valid until its next forward_batch() call
+ */
+class TensorView
+{
+public:
+    TensorView() = default;
+    TensorView(const float *data, size_t size) : _data(data), _size(size)
+    {
+    }
+
+    const float *data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    const float *begin() const
+    {
+        return _data;
+    }
+
+    const float *end() const
+    {
+        return _data + _size;
+    }
+
+    float operator[](size_t i) const
+    {
+        return _data[i];
+    }
+
+
+private:
+    const float *_data = nullptr;
+    size_t _size = 0;
+};
+
+using ModelPredictions = std::vector<TensorView>;
+
+
+/**
+ * @brief Backend independent parameters of an inference engine
+ */
+struct InferenceEngineParams
+{
+    std::string backend = "tensorrt";///< tensorrt or opencv_dnn
+
+    int batch_size = 1;
+    std::string input_layer_name;
+    std::vector<int> input_dims;///< NCHW, the batch dimension is ignored
+    std::vector<std::string> output_layer_names;
+
+    // TensorRT
+    bool fp16 = true;
+    bool tf32 = false;
+    uint8_t trt_logging_level = 2;
+
+    // CPU
+    int num_threads = 0;///< Intra-op threads, 0 keeps the OpenCV default
+};
+
+
+/**
+ * @brief Interface of the inference backends (TensorRT, OpenCV DNN)
+ *  A test double implementing it can be given to ReIDModel to run the Re-ID logic without a backend
+ */
+class InferenceEngine
+{
+public:
+    virtual ~InferenceEngine() = default;
+
+    virtual bool load_model(const std::string &onnx_model_path) = 0;
+
+    /**
+     * @brief Run inference on a batch of images
+     *
+     * @param input_blob NCHW (CV_32F) blob with up to max_batch_size() images
+     * @return ModelPredictions One flattened (N x output size) prediction per output layer,
+     *  owned by the engine and valid until the next call
+     */
+    virtual ModelPredictions forward_batch(const cv::Mat &input_blob) = 0;
+
+    /**
+     * @brief Maximum batch size of the loaded model, 1 if the model has a static batch dimension
+     */
+    virtual int max_batch_size() const = 0;
+};
+
+
+/**
+ * @brief Create the inference engine of the requested backend
+ *  Falls back to the OpenCV DNN (CPU) backend if the library was built without TensorRT
+ *
+ * @param params Inference engine parameters
+ * @return std::unique_ptr<InferenceEngine> Inference engine, nullptr for an unknown backend
+ */
+std::unique_ptr<InferenceEngine>
+create_inference_engine(const InferenceEngineParams &params);
+}// namespace inference_backend
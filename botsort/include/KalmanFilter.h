@@ -68,6 +68,16 @@ public:
                     const std::vector<DetVec> &measurements,
                     bool only_position = false) const;
 
+    /**
+     * @brief gating_distance() of num_measurements measurements into a preallocated vector, its first
+     *  num_measurements elements are written.
+     */
+    void gating_distance(
+            const KFStateSpaceVec &mean, const KFStateSpaceMatrix &covariance,
+            const DetVec *measurements, size_t num_measurements,
+            Eigen::Ref<Eigen::Matrix<float, 1, Eigen::Dynamic>> distances,
+            bool only_position = false) const;
+
 private:
     /**
      * @brief Initialize Kalman Filter matrices (state transition, measurement, process noise covariance).
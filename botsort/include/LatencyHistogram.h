@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "botsort_export.h"
+
+
+namespace bot_profiler
+{
+/**
+ * @brief Log-bucketed (HDR style) histogram of latencies
+ *  Values below 2^(SUB_BUCKET_BITS + 1) are counted exactly, larger values in buckets of
+ *  2^SUB_BUCKET_BITS sub-buckets per power of two, i.e. with a relative error below 1 / 2^SUB_BUCKET_BITS (1.6%).
+ *  Values above MAX_TRACKABLE_VALUE are counted in the last bucket (the max is exact).
+ *  The buckets are allocated on the first recorded value.
+ */
+class BOTSORT_EXPORT LatencyHistogram
+{
+public:
+    static constexpr int SUB_BUCKET_BITS = 6;
+    static constexpr int MAX_VALUE_BITS = 44;
+    static constexpr uint64_t MAX_TRACKABLE_VALUE =
+            (uint64_t{1} << MAX_VALUE_BITS) - 1;
+
+    void record(uint64_t value);
+
+    /**
+     * @brief Add the values of another histogram
+     */
+    void merge(const LatencyHistogram &other);
+
+    void clear();
+
+    /**
+     * @brief Smallest value such that the given percentage of the recorded values are lower or equal
+     *  (upper bound of the bucket, clamped to the max)
+     *
+     * @param percentile Percentile in [0, 100]
+     * @return uint64_t Value at the percentile, 0 if the histogram is empty
+     */
+    uint64_t value_at_percentile(double percentile) const;
+
+    uint64_t count() const
+    {
+        return _count;
+    }
+
+    uint64_t total() const
+    {
+        return _total;
+    }
+
+    uint64_t min() const
+    {
+        return _count ? _min : 0;
+    }
+
+    uint64_t max() const
+    {
+        return _max;
+    }
+
+    double mean() const
+    {
+        return _count ? static_cast<double>(_total) /
+                                static_cast<double>(_count)
+                      : 0.0;
+    }
+
+
+private:
+    static size_t _bucket_index(uint64_t value);
+    static uint64_t _bucket_upper_bound(size_t index);
+    static size_t _num_buckets();
+
+
+private:
+    std::vector<uint64_t> _counts;
+    uint64_t _count = 0, _total = 0;
+    uint64_t _min = std::numeric_limits<uint64_t>::max(), _max = 0;
+};
+}// namespace bot_profiler
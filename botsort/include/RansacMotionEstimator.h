@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "DataType.h"
+
+
+enum class MotionModel
+{
+    Similarity = 0,
+    Affine,
+    Homography
+};
+
+
+/**
+ * @brief Parameters of the RANSAC camera motion estimator
+ */
+struct RansacParams
+{
+    MotionModel model = MotionModel::Similarity;
+    float reproj_thresh = 3.0F;///< Inlier threshold on the reprojection error (pixels)
+    int max_iters = 500;       ///< Maximum number of hypotheses
+    float confidence = 0.99F;  ///< Confidence used for the adaptive early termination
+    int lo_iters = 3;///< Least squares refits on the inliers whenever a better model is found (LO-RANSAC)
+    int parallel_min_points = 500;///< Hypotheses are evaluated in parallel for point sets at least this large
+};
+
+
+/**
+ * @brief Result of the RANSAC camera motion estimation
+ */
+struct RansacResult
+{
+    bool success = false;
+    HomographyMatrix H = HomographyMatrix::Identity();
+    std::vector<uint8_t> inliers;///< Inlier mask, one entry per point
+    int num_inliers = 0;
+    int iterations = 0;///< Number of hypotheses evaluated
+
+    double inlier_ratio() const
+    {
+        return inliers.empty() ? 0.0
+                               : static_cast<double>(num_inliers) /
+                                         static_cast<double>(inliers.size());
+    }
+};
+
+
+/**
+ * @brief RANSAC estimator for the camera motion between two frames
+ *  The tracker only consumes the affine part of the camera motion, so the similarity (2 point sample)
+ *  and affine (3 point sample) models need far fewer hypotheses than a homography (4 point sample).
+ *  - PROSAC style sampling: if match costs are given, hypotheses are first drawn from the best matches
+ *  - LO-RANSAC: every new best model is refit with least squares on its inliers
+ *  - Adaptive early termination on the inlier ratio of the best model
+ *  - Hypotheses are evaluated in fixed size batches, in parallel for large point sets.
+ *    Each hypothesis has its own seeded RNG, so the result does not depend on parallel execution.
+ */
+class RansacMotionEstimator
+{
+public:
+    explicit RansacMotionEstimator(const RansacParams &params = RansacParams());
+
+    /**
+     * @brief Estimate the motion model mapping the source points to the destination points
+     *
+     * @param src_points Points in the previous frame
+     * @param dst_points Corresponding points in the current frame
+     * @param match_costs (Optional) Cost of each correspondence (lower is better), used for PROSAC sampling
+     * @return RansacResult Estimated model, inliers and number of hypotheses evaluated
+     */
+    RansacResult estimate(const std::vector<cv::Point2f> &src_points,
+                          const std::vector<cv::Point2f> &dst_points,
+                          const std::vector<float> &match_costs = {});
+
+    /**
+     * @brief Parse the motion model name (similarity, affine or homography)
+     */
+    static MotionModel motion_model_from_string(const std::string &name);
+
+    int min_sample_size() const;
+
+    const RansacParams &params() const
+    {
+        return _params;
+    }
+
+
+private:
+    using Model = Eigen::Matrix3d;
+
+    int _subset_size(int hypothesis) const;
+    void _draw_sample(int hypothesis, int *sample) const;
+    bool _fit(const int *indices, int count, Model &model) const;
+    int _score(const Model &model, uint8_t *inliers) const;
+    void _local_optimization(Model &model, int &num_inliers, int iterations);
+    int _required_iterations(int num_inliers) const;
+
+
+private:
+    RansacParams _params;
+
+    const cv::Point2f *_src = nullptr;
+    const cv::Point2f *_dst = nullptr;
+    int _num_points = 0;
+    bool _prosac = false;
+
+    std::vector<int> _order;
+    std::vector<int> _inlier_indices;
+    std::vector<uint8_t> _inlier_mask;
+};
@@ -1,19 +1,86 @@
 #pragma once
 
+#include <memory>
+
 #include <opencv2/core.hpp>
 
 #include "DataType.h"
-#include "TRT_InferenceEngine/TensorRT_InferenceEngine.h"
+#include "InferenceEngine.h"
+#include "ReIDPreprocessing.h"
+
+/**
+ * @brief Re-ID features of a set of patches
+ *  The rows whose pre-processing or inference failed are zero and flagged invalid, they must not be applied
+ */
+struct ReIDFeatures
+{
+    FeatureMatrix features; ///< One row of features per patch
+    std::vector<bool> valid;///< Whether each row holds a feature
+};
 
 class ReIDModel
 {
 public:
     ReIDModel(const std::string &config_path,
               const std::string &onnx_model_path);
+
+    /**
+     * @brief Create the Re-ID model on the given inference engine instead of the backend of the config
+     *  (e.g. a test double of InferenceEngine)
+     * 
+     * @param config_path Path to the ReID config
+     * @param onnx_model_path Path to the ONNX model, passed to the engine's load_model()
+     * @param inference_engine Inference engine, the backend of the config is used if nullptr
+     */
+    ReIDModel(const std::string &config_path,
+              const std::string &onnx_model_path,
+              std::unique_ptr<inference_backend::InferenceEngine>
+                      inference_engine);
     ~ReIDModel() = default;
 
-    void pre_process(cv::Mat &image);
-    FeatureVector extract_features(cv::Mat &image);
+    FeatureVector extract_features(const cv::Mat &image_patch);
+
+    /**
+     * @brief Extract the features of the given regions of the frame
+     *  The patches are pre-processed (fused crop, resize, normalization) into NCHW batches
+     *  of up to batch_size images, one inference per batch
+     * 
+     * @param frame Input frame
+     * @param rois Regions of the frame (clipped to the frame)
+     * @return ReIDFeatures One row of features per region, the rows of failed batches are flagged invalid
+     */
+    ReIDFeatures extract_features(const cv::Mat &frame,
+                                  const std::vector<cv::Rect> &rois);
+
+    /**
+     * @brief Pre-process (fused crop, resize, normalization) the given regions of the frame into an NCHW blob
+     *  First half of extract_features(), does not touch the inference engine
+     * 
+     * @param frame Input frame (8-bit BGR)
+     * @param rois Regions of the frame (clipped to the frame)
+     * @param blob Output buffer of rois.size() * patch_size() floats
+     * @return true if the frame could be pre-processed
+     */
+    bool preprocess(const cv::Mat &frame, const std::vector<cv::Rect> &rois,
+                    float *blob) const;
+
+    /**
+     * @brief Run inference on pre-processed patches, in batches of up to batch_size images
+     *  Second half of extract_features()
+     * 
+     * @param blob NCHW blob filled by preprocess()
+     * @param num_patches Number of patches in the blob
+     * @return ReIDFeatures One row of features per patch, the rows of failed or short batches are flagged invalid
+     */
+    ReIDFeatures infer(const float *blob, size_t num_patches);
+
+    /**
+     * @brief Number of floats of one pre-processed patch (3 x height x width)
+     */
+    size_t patch_size() const
+    {
+        return static_cast<size_t>(3 * _input_size.area());
+    }
 
     const std::string &get_distance_metric() const
     {
@@ -25,11 +92,15 @@ private:
 
 
 private:
-    inference_backend::TRTOptimizerParams _model_optimization_params;
-    std::unique_ptr<inference_backend::TensorRTInferenceEngine>
-            _trt_inference_engine;
-    uint8_t _trt_logging_level;
+    inference_backend::InferenceEngineParams _inference_params;
+    std::unique_ptr<inference_backend::InferenceEngine> _inference_engine;
+    PatchNormalization _normalization;
     cv::Size _input_size;
 
+    // Batched inference buffers
+    int _max_batch_size = 1;
+    std::vector<cv::Rect> _batch_rois;
+    cv::Mat _batch_blob;
+
     std::string _onnx_model_path, _distance_metric;
 };
\ No newline at end of file
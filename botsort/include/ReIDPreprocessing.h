@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+
+/**
+ * @brief Normalization applied to the ReID input patches: output = (pixel - mean) / std
+ *  mean and std are given per output channel (i.e. after the optional BGR to RGB swap), in pixel units
+ */
+struct PatchNormalization
+{
+    std::array<float, 3> mean = {0.0F, 0.0F, 0.0F};
+    std::array<float, 3> std = {1.0F, 1.0F, 1.0F};
+    bool swap_rb = false;
+};
+
+
+/**
+ * @brief Fused ReID pre-processing of one patch: reads the region directly from the (BGR, 8UC3) frame,
+ *  bilinearly resizes it (same sampling as cv::resize with INTER_LINEAR), optionally swaps the R and B
+ *  channels, normalizes it and writes it as planar (CHW) floats
+ * 
+ * @param frame_data Frame data (interleaved BGR, 8 bits per channel)
+ * @param frame_step Frame row stride in bytes
+ * @param frame_size Frame size
+ * @param roi Region of the frame to process, clipped to the frame
+ * @param output_size Output patch size
+ * @param normalization Channel swap and normalization
+ * @param output Output buffer of 3 x output_size.height x output_size.width floats
+ */
+void preprocess_patch(const uint8_t *frame_data, size_t frame_step,
+                      const cv::Size &frame_size, const cv::Rect &roi,
+                      const cv::Size &output_size,
+                      const PatchNormalization &normalization, float *output);
+
+
+/**
+ * @brief Pre-process a batch of patches of the frame into a NCHW buffer, in parallel across the patches
+ * 
+ * @param frame Input frame (8UC3, BGR)
+ * @param rois Regions of the frame to process
+ * @param output_size Output patch size
+ * @param normalization Channel swap and normalization
+ * @param output Output buffer of rois.size() x 3 x output_size.height x output_size.width floats
+ */
+void preprocess_patches(const cv::Mat &frame, const std::vector<cv::Rect> &rois,
+                        const cv::Size &output_size,
+                        const PatchNormalization &normalization,
+                        float *output);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "DataType.h"
+#include "ReID.h"
+
+
+/**
+ * @brief Asynchronous ReID feature extraction
+ *  The patches of a frame are pre-processed on the calling thread into one of the worker's input buffers,
+ *  inference runs on a dedicated worker thread while the caller continues (KF predict, GMC).
+ *  With two buffers the next frame can be pre-processed while the previous one is inferred (double buffering).
+ *  submit() blocks while all buffers are in use, which bounds the queue: every ticket must be collected with wait().
+ */
+class ReIDWorker
+{
+public:
+    using Ticket = uint64_t;
+
+    /**
+     * @brief Start the inference worker thread
+     *
+     * @param reid_model ReID model, its inference engine is only used by the worker thread
+     * @param num_buffers Number of input/output buffers, i.e. maximum number of frames in flight (default: 2)
+     */
+    explicit ReIDWorker(ReIDModel &reid_model, size_t num_buffers = 2);
+    ~ReIDWorker();
+
+    ReIDWorker(const ReIDWorker &) = delete;
+    ReIDWorker &operator=(const ReIDWorker &) = delete;
+
+    /**
+     * @brief Pre-process the regions of the frame and queue them for inference
+     *  The frame is not referenced after the call returns
+     *
+     * @param frame Input frame
+     * @param rois Regions of the frame (clipped to the frame)
+     * @return Ticket Ticket to collect the features with wait()
+     */
+    Ticket submit(const cv::Mat &frame, const std::vector<cv::Rect> &rois);
+
+    /**
+     * @brief Check whether the features of the given ticket are available
+     */
+    bool ready(Ticket ticket) const;
+
+    /**
+     * @brief Wait for the features of the given ticket and release its buffer
+     *
+     * @param ticket Ticket returned by submit()
+     * @return ReIDFeatures One row of features per region (flagged invalid if its inference failed),
+     *  empty for an unknown ticket or a failed one (the frame could not be pre-processed)
+     */
+    ReIDFeatures wait(Ticket ticket);
+
+
+private:
+    enum class BufferState
+    {
+        Free = 0,
+        Filling,
+        Queued,
+        Done
+    };
+
+    struct Buffer
+    {
+        BufferState state = BufferState::Free;
+        Ticket ticket = 0;
+        size_t num_patches = 0;
+        uint16_t stream_id = 0;///< Profiler stream of the submitting thread
+        uint32_t frame_id = 0; ///< Profiler frame of the submitting thread
+        std::vector<float> input;
+        ReIDFeatures output;
+    };
+
+    void _run();
+    Buffer *_find_buffer(Ticket ticket);
+
+
+private:
+    ReIDModel &_reid_model;
+
+    std::vector<Buffer> _buffers;
+    std::deque<Buffer *> _queue;
+    Ticket _next_ticket = 1;
+    bool _stop = false;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _queue_cv, _buffer_cv;
+    std::thread _thread;
+};
@@ -18,12 +18,11 @@
 //#include <boost/filesystem.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "InferenceEngine.h"
 #include "TRT_Logger.h"
 
 namespace inference_backend
 {
-using ModelPredictions = std::vector<std::vector<float>>;
-
 static auto StreamDeleter = [](cudaStream_t *ptr) {
     if (ptr)
     {
@@ -93,50 +92,96 @@ struct TRTOptimizerParams
 };
 
 
-class TensorRTInferenceEngine
+class TensorRTInferenceEngine : public InferenceEngine
 {
 private:
     nvinfer1::ILogger::Severity _logSeverity =
             nvinfer1::ILogger::Severity::kWARNING;
     TRTOptimizerParams _optimization_params;
+    TRTUniquePtr<nvinfer1::IRuntime> _runtime{nullptr};
     TRTUniquePtr<nvinfer1::ICudaEngine> _engine{nullptr};
     TRTUniquePtr<nvinfer1::IExecutionContext> _context{nullptr};
     std::unique_ptr<TRTLogger> _logger{nullptr};
 
-    cudaStream_t _cuda_stream;
+    cudaStream_t _cuda_stream = nullptr;
+    cudaEvent_t _inference_done = nullptr;
 
-    std::vector<void *> _buffers;
+    std::vector<void *> _buffers;///< Device buffers of the input/output tensors
+    float *_host_input = nullptr;///< Pinned staging buffer of the input tensor
+    std::vector<float *> _host_outputs;///< Pinned buffers of the output layers
     std::vector<nvinfer1::Dims> _input_dims;
     std::vector<nvinfer1::Dims> _output_dims;
     std::vector<std::string> _output_layer_names;
 
     int _input_idx = 0;
     std::vector<int> _output_idx;
+    int _max_batch_size = 1;
 
 public:
     TensorRTInferenceEngine(TRTOptimizerParams &optimization_params,
                             uint8_t logging_level);
-    ~TensorRTInferenceEngine();
-
-    bool load_model(const std::string &onnx_model_path);
+    ~TensorRTInferenceEngine() override;
+
+    /**
+     * @brief Load the engine of the ONNX model from the engine cache, building and caching it if needed
+     * 
+     * @param onnx_model_path Path to the ONNX model
+     * @return true If the engine is ready for inference
+     */
+    bool load_model(const std::string &onnx_model_path) override;
     ModelPredictions forward(const cv::Mat &input_image);
 
+    /**
+     * @brief Run inference on a batch of images
+     *  The blob is staged in pinned memory, the copies and inference are enqueued on the engine's CUDA stream
+     * 
+     * @param input_blob NCHW (CV_32F) blob with up to max_batch_size() images
+     * @return ModelPredictions One flattened (N x output size) prediction per output layer,
+     *  views of the pinned output buffers valid until the next call
+     */
+    ModelPredictions forward_batch(const cv::Mat &input_blob) override;
+
+    /**
+     * @brief Maximum batch size of the loaded engine, 1 if the model has a static batch dimension
+     */
+    int max_batch_size() const override
+    {
+        return _max_batch_size;
+    }
+
+
+    /**
+     * @brief Path of the cached engine of the ONNX model, next to the model
+     *  The name contains the TensorRT version, the GPU compute capability and the engine cache key
+     */
+    std::string get_engine_path(const std::string &onnx_model_path) const;
+
 
 private:
     // Const methods
-    std::string get_engine_path(const std::string &onnx_model_path) const;
+    /**
+     * @brief Hash of the ONNX model content, input dimensions, builder flags and TensorRT/CUDA versions
+     */
+    uint64_t _engine_cache_key(const std::string &onnx_model_path) const;
     bool file_exists(const std::string &name) const;
     size_t get_size_by_dims(const nvinfer1::Dims &dims,
                             int element_size = 1) const;
 
+    /**
+     * @brief Whether the CUDA call succeeded, a failure is logged with the name of the call
+     */
+    bool _cuda_succeeded(cudaError_t status, const char *call) const;
+
 
     // Non-const methods
     void _set_optimization_params(const TRTOptimizerParams &params);
     void _init_TRT_logger(uint8_t logging_level);
 
-    void _build_engine(const std::string &onnx_model_path);
+    bool _build_engine(const std::string &onnx_model_path,
+                       const std::string &engine_path);
     bool _deserialize_engine(const std::string &engine_path);
 
-    void _allocate_buffers();
+    bool _allocate_buffers();
+    void _free_buffers();
 };
 }// namespace inference_backend
\ No newline at end of file
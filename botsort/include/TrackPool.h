@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "DataType.h"
+#include "botsort_export.h"
+#include "track.h"
+
+
+/**
+ * @brief Recycling pool of the Track objects created for the detections of each frame
+ *  Most detections only live for one frame: they update an existing track and are dropped after the
+ *  association. The pool keeps every Track it created, and a Track only referenced by the pool (its
+ *  detection and, if it started a track, the track itself are gone from the tracker and the caller)
+ *  is reinitialized in place for a new detection (Track::reset(), which clears all of its state),
+ *  its vectors keeping their capacity. New Track objects are only allocated when the pool runs out,
+ *  i.e. when the live tracks and the detections of a frame exceed the previous peak.
+ *  The free tracks above FREE_TRACKS_PER_LIVE times the live tracks (and MIN_FREE_TRACKS) are
+ *  released, so that the pool shrinks back after a crowded scene.
+ *
+ *  Ownership contract: the pool's shared_ptr is the owning reference, a track is free for reuse only
+ *  once every other reference is gone (the tracker clears its per-frame lists of detections before
+ *  the next recycle()). A reference kept anywhere else, however stale, keeps the track live: it is
+ *  never reinitialized under its holder, it is just not reused. acquire() asserts (debug builds)
+ *  that the track it reinitializes is held by the pool alone.
+ */
+class BOTSORT_EXPORT TrackPool
+{
+public:
+    /**
+     * @param feat_history_size Size of the feature history of the tracks (see Track)
+     * @param feat_history_format Storage format of the feature history
+     * @param appearance_format Format of the features in the appearance distance
+     */
+    explicit TrackPool(
+            int feat_history_size = 0,
+            FeatureFormat feat_history_format = FeatureFormat::Float32,
+            FeatureFormat appearance_format = FeatureFormat::Float32);
+
+    /**
+     * @brief Collect the tracks that are no longer referenced outside the pool and release the excess
+     *  ones, call once per frame before acquire()
+     *  Tracks still referenced elsewhere are live and left untouched, see the ownership contract above
+     */
+    void recycle();
+
+    /**
+     * @brief Get a new (not activated) track for the detection, recycled if possible
+     */
+    std::shared_ptr<Track> acquire(const Detection &detection);
+
+    /**
+     * @brief Number of tracks owned by the pool, in use or not
+     */
+    size_t size() const
+    {
+        return _tracks.size();
+    }
+
+    /**
+     * @brief Memory used by the tracks free for reuse (bytes)
+     */
+    size_t memory_footprint() const;
+
+
+private:
+    static constexpr size_t MIN_FREE_TRACKS = 64;
+    static constexpr size_t FREE_TRACKS_PER_LIVE = 2;
+
+    int _feat_history_size;
+    FeatureFormat _feat_history_format, _appearance_format;
+
+    std::vector<std::shared_ptr<Track>> _tracks;
+    std::vector<size_t> _free;///< Indices of the tracks free for reuse
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "profiler.h"
+
+
+/**
+ * Heap allocation counting, for tests and benchmarks
+ *  BOTSORT_ALLOCATION_HOOKS() replaces the global operator new and delete with counting versions
+ *  (on top of malloc and free) and enables the allocation counting of the profiler. Expand it once,
+ *  at global scope, in one translation unit of an executable; the library itself never installs it.
+ *  Every allocation increments bot_profiler::thread_allocations(), and with the profiler enabled each
+ *  scope reports its allocations per call (print_report(), ScopeStats::allocations, trace argument).
+ *  On ELF and Mach-O platforms the replacement covers the whole process, the botsort library included;
+ *  with MSVC it only covers the code of the executable. Direct malloc calls (e.g. the OpenCV
+ *  allocator) are not counted.
+ */
+namespace bot_profiler::detail
+{
+inline void *counted_allocate(std::size_t size)
+{
+    ++thread_allocations();
+    return std::malloc(size ? size : 1);
+}
+
+inline void *counted_allocate(std::size_t size, std::align_val_t alignment)
+{
+    ++thread_allocations();
+    const auto align = static_cast<std::size_t>(alignment);
+    size = size ? (size + align - 1) / align * align : align;
+#ifdef _MSC_VER
+    return _aligned_malloc(size, align);
+#else
+    return std::aligned_alloc(align, size);
+#endif
+}
+
+inline void counted_free(void *ptr)
+{
+    std::free(ptr);
+}
+
+inline void counted_aligned_free(void *ptr)
+{
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+template<typename... Alignment>
+void *counted_allocate_or_throw(std::size_t size, Alignment... alignment)
+{
+    if (void *ptr = counted_allocate(size, alignment...))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+struct AllocationCountingEnabler
+{
+    AllocationCountingEnabler()
+    {
+        set_allocation_counting(true);
+    }
+};
+}// namespace bot_profiler::detail
+
+
+#define BOTSORT_ALLOCATION_HOOKS()                                             \
+    void *operator new(std::size_t size)                                       \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate_or_throw(size);        \
+    }                                                                          \
+    void *operator new[](std::size_t size)                                     \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate_or_throw(size);        \
+    }                                                                          \
+    void *operator new(std::size_t size, std::align_val_t alignment)           \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate_or_throw(size,         \
+                                                                 alignment);   \
+    }                                                                          \
+    void *operator new[](std::size_t size, std::align_val_t alignment)         \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate_or_throw(size,         \
+                                                                 alignment);   \
+    }                                                                          \
+    void *operator new(std::size_t size, const std::nothrow_t &) noexcept      \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate(size);                 \
+    }                                                                          \
+    void *operator new[](std::size_t size, const std::nothrow_t &) noexcept    \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate(size);                 \
+    }                                                                          \
+    void *operator new(std::size_t size, std::align_val_t alignment,           \
+                       const std::nothrow_t &) noexcept                        \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate(size, alignment);      \
+    }                                                                          \
+    void *operator new[](std::size_t size, std::align_val_t alignment,         \
+                         const std::nothrow_t &) noexcept                      \
+    {                                                                          \
+        return ::bot_profiler::detail::counted_allocate(size, alignment);      \
+    }                                                                          \
+    void operator delete(void *ptr) noexcept                                   \
+    {                                                                          \
+        ::bot_profiler::detail::counted_free(ptr);                             \
+    }                                                                          \
+    void operator delete[](void *ptr) noexcept                                 \
+    {                                                                          \
+        ::bot_profiler::detail::counted_free(ptr);                             \
+    }                                                                          \
+    void operator delete(void *ptr, std::size_t) noexcept                      \
+    {                                                                          \
+        ::bot_profiler::detail::counted_free(ptr);                             \
+    }                                                                          \
+    void operator delete[](void *ptr, std::size_t) noexcept                    \
+    {                                                                          \
+        ::bot_profiler::detail::counted_free(ptr);                             \
+    }                                                                          \
+    void operator delete(void *ptr, const std::nothrow_t &) noexcept           \
+    {                                                                          \
+        ::bot_profiler::detail::counted_free(ptr);                             \
+    }                                                                          \
+    void operator delete[](void *ptr, const std::nothrow_t &) noexcept         \
+    {                                                                          \
+        ::bot_profiler::detail::counted_free(ptr);                             \
+    }                                                                          \
+    void operator delete(void *ptr, std::align_val_t) noexcept                 \
+    {                                                                          \
+        ::bot_profiler::detail::counted_aligned_free(ptr);                     \
+    }                                                                          \
+    void operator delete[](void *ptr, std::align_val_t) noexcept               \
+    {                                                                          \
+        ::bot_profiler::detail::counted_aligned_free(ptr);                     \
+    }                                                                          \
+    void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept    \
+    {                                                                          \
+        ::bot_profiler::detail::counted_aligned_free(ptr);                     \
+    }                                                                          \
+    void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept  \
+    {                                                                          \
+        ::bot_profiler::detail::counted_aligned_free(ptr);                     \
+    }                                                                          \
+    void operator delete(void *ptr, std::align_val_t,                          \
+                         const std::nothrow_t &) noexcept                      \
+    {                                                                          \
+        ::bot_profiler::detail::counted_aligned_free(ptr);                     \
+    }                                                                          \
+    void operator delete[](void *ptr, std::align_val_t,                        \
+                           const std::nothrow_t &) noexcept                    \
+    {                                                                          \
+        ::bot_profiler::detail::counted_aligned_free(ptr);                     \
+    }                                                                          \
+    static const ::bot_profiler::detail::AllocationCountingEnabler             \
+            botsort_allocation_counting_enabler
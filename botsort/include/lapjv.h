@@ -74,6 +74,23 @@ typedef enum fp_t
     FP_DYNAMIC = 3
 } fp_t;
 
+/** Scratch arrays of lapjv_internal_workspace(), n elements each.
+ */
+typedef struct lapjv_workspace
+{
+    int_t *free_rows;
+    int_t *pred;
+    int_t *cols;
+    cost_t *v;
+    cost_t *d;
+    boolean *unique;
+} lapjv_workspace;
+
 extern int_t lapjv_internal(const uint_t n, cost_t *cost[], int_t *x, int_t *y);
 
+/** lapjv_internal() on the caller's scratch arrays, does not allocate.
+ */
+extern int_t lapjv_internal_workspace(const uint_t n, cost_t *cost[], int_t *x,
+                                      int_t *y, lapjv_workspace *workspace);
+
 #endif// LAPJV_H
\ No newline at end of file
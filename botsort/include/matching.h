@@ -4,6 +4,7 @@
 #include <tuple>
 
 #include "DataType.h"
+#include "FrameArena.h"
 #include "track.h"
 
 /**
@@ -20,6 +21,14 @@ iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
              const std::vector<std::shared_ptr<Track>> &detections,
              float max_iou_distance);
 
+/**
+ * @brief iou_distance() into preallocated matrices (tracks x detections), e.g. from a FrameArena
+ */
+void iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
+                  const std::vector<std::shared_ptr<Track>> &detections,
+                  float max_iou_distance, Eigen::Ref<CostMatrix> cost_matrix,
+                  Eigen::Ref<CostMatrix> iou_dists_mask);
+
 /**
  * @brief Calculate the IoU distance between tracks and detections
  * 
@@ -30,22 +39,43 @@ iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
 CostMatrix iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
                         const std::vector<std::shared_ptr<Track>> &detections);
 
+/**
+ * @brief iou_distance() into a preallocated matrix (tracks x detections), e.g. from a FrameArena
+ */
+void iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
+                  const std::vector<std::shared_ptr<Track>> &detections,
+                  Eigen::Ref<CostMatrix> cost_matrix);
+
 
 /**
  * @brief Calculate the embedding distance between tracks and detections and create a mask for the cost matrix
- *  when the embedding distance is greater than the threshold
+ *  when the embedding distance is greater than the threshold.
+ *  Pairs where the track or the detection has no feature vector are masked off.
  * 
  * @param tracks Tracks used to create the cost matrix
  * @param detections Tracks created from detections used to create the cost matrix
  * @param max_embedding_distance Threshold for embedding distance
  * @param distance_metric Distance metric to use for calculating the embedding distance
+ * @param feature_format Format of the features in the dot products, FP16 and INT8 use quantized SIMD kernels (default: Float32)
  * @return std::tuple<CostMatrix, CostMatrix> Tuple of embedding distance cost matrix and embedding distance mask
  */
 std::tuple<CostMatrix, CostMatrix>
 embedding_distance(const std::vector<std::shared_ptr<Track>> &tracks,
                    const std::vector<std::shared_ptr<Track>> &detections,
                    float max_embedding_distance,
-                   const std::string &distance_metric);
+                   const std::string &distance_metric,
+                   FeatureFormat feature_format = FeatureFormat::Float32);
+
+/**
+ * @brief embedding_distance() into preallocated matrices (tracks x detections), e.g. from a FrameArena
+ */
+void embedding_distance(const std::vector<std::shared_ptr<Track>> &tracks,
+                        const std::vector<std::shared_ptr<Track>> &detections,
+                        float max_embedding_distance,
+                        const std::string &distance_metric,
+                        FeatureFormat feature_format,
+                        Eigen::Ref<CostMatrix> cost_matrix,
+                        Eigen::Ref<CostMatrix> embedding_dists_mask);
 
 /**
  * @brief Fuses the detection score into the cost matrix in-place
@@ -55,7 +85,7 @@ embedding_distance(const std::vector<std::shared_ptr<Track>> &tracks,
  * @param cost_matrix Cost matrix in which to fuse the detection score
  * @param detections Tracks created from detections used to create the cost matrix
  */
-void fuse_score(CostMatrix &cost_matrix,
+void fuse_score(Eigen::Ref<CostMatrix> cost_matrix,
                 const std::vector<std::shared_ptr<Track>> &detections);
 
 /**
@@ -68,11 +98,20 @@ void fuse_score(CostMatrix &cost_matrix,
  * @param lambda Weighting factor for motion (default: 0.98)
  * @param only_position Set to true only position should be used for gating distance
  */
-void fuse_motion(const KalmanFilter &KF, CostMatrix &cost_matrix,
+void fuse_motion(const KalmanFilter &KF, Eigen::Ref<CostMatrix> cost_matrix,
                  const std::vector<std::shared_ptr<Track>> &tracks,
                  const std::vector<std::shared_ptr<Track>> &detections,
                  float lambda = 0.98F, bool only_position = false);
 
+/**
+ * @brief fuse_motion() with its scratch (measurements, gating distances) taken from a frame arena
+ */
+void fuse_motion(const KalmanFilter &KF, Eigen::Ref<CostMatrix> cost_matrix,
+                 const std::vector<std::shared_ptr<Track>> &tracks,
+                 const std::vector<std::shared_ptr<Track>> &detections,
+                 FrameArena &arena, float lambda = 0.98F,
+                 bool only_position = false);
+
 /**
  * @brief Fuse IoU distance with embedding distance keeping the mask in mind
  * 
@@ -86,6 +125,14 @@ CostMatrix fuse_iou_with_emb(CostMatrix &iou_dist, CostMatrix &emb_dist,
                              const CostMatrix &iou_dists_mask,
                              const CostMatrix &emb_dists_mask);
 
+/**
+ * @brief fuse_iou_with_emb() in place, the fused and masked cost matrix is written to iou_dist
+ */
+void fuse_iou_with_emb_inplace(
+        Eigen::Ref<CostMatrix> iou_dist, Eigen::Ref<CostMatrix> emb_dist,
+        const Eigen::Ref<const CostMatrix> &iou_dists_mask,
+        const Eigen::Ref<const CostMatrix> &emb_dists_mask);
+
 /**
  * @brief Performs linear assignment using the LAPJV algorithm
  * 
@@ -93,4 +140,16 @@ CostMatrix fuse_iou_with_emb(CostMatrix &iou_dist, CostMatrix &emb_dist,
  * @param thresh Threshold for cost matrix
  * @return AssociationData Association data
  */
-AssociationData linear_assignment(CostMatrix &cost_matrix, float thresh);
\ No newline at end of file
+AssociationData linear_assignment(CostMatrix &cost_matrix, float thresh);
+
+/**
+ * @brief linear_assignment() with the LAPJV workspace taken from a frame arena
+ * 
+ * @param cost_matrix Cost matrix for solving the linear assignment problem
+ * @param thresh Threshold for cost matrix
+ * @param arena Frame arena of the solver workspace
+ * @param associations Association data, overwritten (the capacity of its vectors is reused)
+ */
+void linear_assignment(const Eigen::Ref<const CostMatrix> &cost_matrix,
+                       float thresh, FrameArena &arena,
+                       AssociationData &associations);
\ No newline at end of file
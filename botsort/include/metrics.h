@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "botsort_export.h"
+#include "profiler.h"
+
+
+/**
+ * Live metrics of a tracker process, in the Prometheus text exposition format
+ *  A metric is a family with one value per stream (label "stream", see bot_profiler::set_stream_id())
+ *  and optionally per value of one extra label (e.g. the association stage). The values are relaxed
+ *  atomics in fixed arrays indexed by stream, so an update is lock-free and never allocates;
+ *  the streams past MAX_STREAMS share the last slot.
+ *  The families are static objects of the instrumented modules (BoTSORT, GMC, ReID), registered on
+ *  construction. expose() renders them, with the stage latencies of the profiler if it is enabled,
+ *  and MetricsServer serves them over HTTP.
+ */
+namespace bot_metrics
+{
+using StreamId = bot_profiler::StreamId;
+
+constexpr size_t MAX_STREAMS = 64;
+
+
+/**
+ * @brief Metric family: name, help, type and the values of each stream and label value
+ */
+class BOTSORT_EXPORT Family
+{
+public:
+    /**
+     * @param name Metric name (static string)
+     * @param help Description (static string)
+     * @param type "counter" or "gauge"
+     * @param label_name Name of the extra label, nullptr if none
+     * @param label_values Values of the extra label, the label index of an update is an index in this list
+     */
+    Family(const char *name, const char *help, const char *type,
+           const char *label_name, std::vector<const char *> label_values);
+    virtual ~Family();
+
+    Family(const Family &) = delete;
+    Family &operator=(const Family &) = delete;
+
+    /**
+     * @brief Append the HELP, TYPE and the updated samples of the family (nothing if no sample was updated)
+     */
+    void write(std::ostream &os) const;
+
+
+protected:
+    size_t _index(StreamId stream_id, size_t label) const
+    {
+        const size_t stream = stream_id < MAX_STREAMS ? stream_id
+                                                      : MAX_STREAMS - 1;
+        return stream * _num_labels + label;
+    }
+
+    void _mark_updated(size_t index)
+    {
+        if (!_updated[index].load(std::memory_order_relaxed))
+            _updated[index].store(true, std::memory_order_relaxed);
+    }
+
+    virtual void _write_value(std::ostream &os, size_t index) const = 0;
+
+
+protected:
+    const size_t _num_labels;
+
+
+private:
+    const char *_name, *_help, *_type, *_label_name;
+    std::vector<const char *> _label_values;
+    std::unique_ptr<std::atomic<bool>[]> _updated;
+};
+
+
+/**
+ * @brief Monotonic count (e.g. frames, detections), per stream and label value
+ */
+class BOTSORT_EXPORT Counter : public Family
+{
+public:
+    Counter(const char *name, const char *help,
+            const char *label_name = nullptr,
+            std::vector<const char *> label_values = {});
+
+    void inc(StreamId stream_id, uint64_t value = 1, size_t label = 0)
+    {
+        const size_t index = _index(stream_id, label);
+        _values[index].fetch_add(value, std::memory_order_relaxed);
+        _mark_updated(index);
+    }
+
+    uint64_t value(StreamId stream_id, size_t label = 0) const
+    {
+        return _values[_index(stream_id, label)].load(
+                std::memory_order_relaxed);
+    }
+
+
+private:
+    void _write_value(std::ostream &os, size_t index) const override;
+
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> _values;
+};
+
+
+/**
+ * @brief Current value (e.g. number of active tracks, inlier ratio), per stream and label value
+ */
+class BOTSORT_EXPORT Gauge : public Family
+{
+public:
+    Gauge(const char *name, const char *help, const char *label_name = nullptr,
+          std::vector<const char *> label_values = {});
+
+    void set(StreamId stream_id, double value, size_t label = 0)
+    {
+        const size_t index = _index(stream_id, label);
+        _values[index].store(value, std::memory_order_relaxed);
+        _mark_updated(index);
+    }
+
+    double value(StreamId stream_id, size_t label = 0) const
+    {
+        return _values[_index(stream_id, label)].load(
+                std::memory_order_relaxed);
+    }
+
+
+private:
+    void _write_value(std::ostream &os, size_t index) const override;
+
+
+private:
+    std::unique_ptr<std::atomic<double>[]> _values;
+};
+
+
+/**
+ * @brief Render all the registered families in the Prometheus text exposition format (version 0.0.4)
+ *  If the profiler is enabled, the stage latencies since its last reset are appended as the summary
+ *  botsort_stage_latency_seconds{stream, stage, quantile}.
+ */
+BOTSORT_EXPORT std::string expose();
+
+
+/**
+ * @brief Minimal HTTP server of expose() at /metrics, for a Prometheus scraper or curl
+ *  One background thread serves the requests sequentially (one connection at a time).
+ */
+class BOTSORT_EXPORT MetricsServer
+{
+public:
+    MetricsServer() = default;
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    /**
+     * @brief Listen on address:port and start serving
+     *
+     * @param port TCP port, 0 for a free port (see port())
+     * @param address IPv4 address to bind, localhost by default
+     * @return true if the server is listening
+     */
+    bool start(uint16_t port, const std::string &address = "127.0.0.1");
+
+    void stop();
+
+    /**
+     * @brief Port the server listens on, 0 if it is not started
+     */
+    uint16_t port() const
+    {
+        return _port;
+    }
+
+
+private:
+    void _serve();
+
+
+private:
+    intptr_t _socket = -1;
+    uint16_t _port = 0;
+    std::atomic<bool> _stop{false};
+    std::thread _thread;
+};
+}// namespace bot_metrics
@@ -1,98 +1,298 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
-#include <iostream>
-#include <mutex>
-#include <regex>
+#include <cstdint>
+#include <ostream>
 #include <string>
-#include <thread>
+#include <vector>
 
-#if PROFILE
-#define PROFILE_SCOPE(name) Profiler timer##__LINE__(name)
-#define PROFILE_FUNCTION() PROFILE_SCOPE(__PRETTY_FUNCTION__)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+        defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
 #else
-#define PROFILE_SCOPE(name)
+#include <x86intrin.h>
+#endif
+#define BOT_PROFILER_USE_TSC 1
+#endif
+
+#include "LatencyHistogram.h"
+#include "botsort_export.h"
+
+
+/**
+ * Tracing of the tracker stages
+ *  The instrumentation is always compiled in and disabled by default, it is enabled at runtime
+ *  with bot_profiler::set_enabled(true) or the BOTSORT_PROFILE=1 environment variable.
+ *  Each scope is registered once (static ID per call site), a scope exit appends one event to
+ *  the lock-free ring buffer of the calling thread. A collector thread drains the buffers every
+ *  few milliseconds into a latency histogram per scope and stream; events are dropped (and counted)
+ *  if a buffer is full. Multi-camera processes tag the events of each stream with set_stream_id().
+ *  The events can also be streamed to a Chrome trace-event JSON file (start_trace()), viewable in
+ *  chrome://tracing or https://ui.perfetto.dev, to inspect the timeline of each stream and thread.
+ *
+ *  PROFILE_SCOPE("name")           times the enclosing block
+ *  PROFILE_FUNCTION()              times the enclosing function, named by its full signature
+ *  PROFILE_BEGIN(timer, "name")    times the code up to PROFILE_END(timer) or the end of the block
+ *  PROFILE_COUNT(timer, count)     tags the event of the timer with a number of objects (trace only)
+ *
+ *  With the allocation hooks of allocation_hooks.h installed (tests and benchmarks), each event also
+ *  holds the number of heap allocations done by the thread in the scope, reported per call.
+ */
+#define BOT_PROFILER_CONCAT_(a, b) a##b
+#define BOT_PROFILER_CONCAT(a, b) BOT_PROFILER_CONCAT_(a, b)
+
+#define PROFILE_BEGIN(timer, name)                                             \
+    static const ::bot_profiler::ScopeId BOT_PROFILER_CONCAT(timer,            \
+                                                             _scope_id) =      \
+            ::bot_profiler::register_scope(name);                              \
+    ::bot_profiler::ScopedTimer timer(BOT_PROFILER_CONCAT(timer, _scope_id))
+#define PROFILE_END(timer) timer.stop()
+#define PROFILE_COUNT(timer, count) timer.set_count(count)
+#define PROFILE_SCOPE(name)                                                    \
+    PROFILE_BEGIN(BOT_PROFILER_CONCAT(_profile_scope_, __LINE__), name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(BOT_PROFILER_FUNCTION_NAME)
+
+// Qualified name of the enclosing function, so that the methods and overloads of the same name get their own scope
+#ifdef _MSC_VER
+#define BOT_PROFILER_FUNCTION_NAME __FUNCSIG__
+#else
+#define BOT_PROFILER_FUNCTION_NAME __PRETTY_FUNCTION__
 #endif
 
 
-class ProfilerManager
+namespace bot_profiler
 {
-public:
-    static ProfilerManager &get_instance()
-    {
-        static ProfilerManager instance;
-        return instance;
-    }
+using ScopeId = uint16_t;
+using StreamId = uint16_t;
 
-    void add_profile(const std::string &name, long long duration)
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto &data = profiles_[name];
-        data.total_duration += duration;
-        data.frame_count++;
+constexpr size_t MAX_SCOPES = 1024;
 
-        if (data.frame_count == 100)
-        {
-            std::string func_name = parse_function_name(name);
-            std::cout << "[" << func_name << "] - Average over 100 frames: "
-                      << (data.total_duration / 100.0 * 0.001) << " ms"
-                      << " (" << 1000.0 / (data.total_duration / 100.0 * 0.001)
-                      << " FPS)" << std::endl;
-            data.total_duration = 0;
-            data.frame_count = 0;
-        }
-    }
 
-private:
-    ProfilerManager()
-    {
-    }
+/**
+ * @brief Timestamp in ticks: TSC on x86 (invariant TSC assumed), steady_clock nanoseconds otherwise
+ */
+inline uint64_t now()
+{
+#ifdef BOT_PROFILER_USE_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+#endif
+}
 
-    std::string parse_function_name(const std::string &function_name)
-    {
-        // Regex to match the function name and class (if any)
-        std::regex name_regex("([\\w:]+)\\(");
-        std::smatch matches;
 
-        if (std::regex_search(function_name, matches, name_regex) &&
-            matches.size() > 1)
-            return matches[1].str();
+/**
+ * @brief Register a scope name (string literal or static string), once per call site
+ *
+ * @param name Scope name
+ * @return ScopeId ID of the scope, the same name always gets the same ID
+ */
+BOTSORT_EXPORT ScopeId register_scope(const char *name);
+
+/**
+ * @brief Name of a registered scope
+ */
+BOTSORT_EXPORT const char *scope_name(ScopeId scope_id);
+
+/**
+ * @brief Enable or disable the tracing, the collector thread runs while the tracing is enabled
+ */
+BOTSORT_EXPORT void set_enabled(bool enabled);
+
+namespace detail
+{
+BOTSORT_EXPORT extern std::atomic<bool> enabled;
+}
+
+inline bool is_enabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Enable or disable the allocation counting of the scopes, enabled by BOTSORT_ALLOCATION_HOOKS()
+ *  The counts are only meaningful with the hooks of allocation_hooks.h installed.
+ */
+BOTSORT_EXPORT void set_allocation_counting(bool enabled);
+
+namespace detail
+{
+BOTSORT_EXPORT extern std::atomic<bool> allocation_counting;
+}
+
+inline bool is_counting_allocations()
+{
+    return detail::allocation_counting.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Heap allocations done by the calling thread, incremented by the allocation hooks
+ */
+BOTSORT_EXPORT uint64_t &thread_allocations();
+
+/**
+ * @brief Set the stream (e.g. camera) the events of the calling thread are tagged with, 0 by default
+ */
+BOTSORT_EXPORT void set_stream_id(StreamId stream_id);
+BOTSORT_EXPORT StreamId get_stream_id();
+
+/**
+ * @brief Set the frame the events of the calling thread are tagged with in the trace
+ */
+BOTSORT_EXPORT void set_frame_id(uint32_t frame_id);
+BOTSORT_EXPORT uint32_t get_frame_id();
+
+/**
+ * @brief Append a scope event, tagged with the stream and frame of the calling thread, to the ring buffer
+ *  of the calling thread (lock-free, wait-free)
+ *
+ * @param count Number of objects processed in the scope (trace argument)
+ * @param allocations Heap allocations done in the scope (allocation counting)
+ */
+BOTSORT_EXPORT void record(ScopeId scope_id, uint64_t start, uint64_t end,
+                           uint32_t count = 0, uint32_t allocations = 0);
+
+/**
+ * @brief Convert a duration in ticks (see now()) to nanoseconds
+ */
+BOTSORT_EXPORT double ticks_to_ns(uint64_t ticks);
+
 
-        // Fallback in case the regex fails to match
-        return function_name;
+/**
+ * @brief Latency statistics of a scope in a stream
+ *  The percentiles are upper bounds of histogram buckets (relative error < 1.6%)
+ */
+struct ScopeStats
+{
+    std::string name;
+    ScopeId scope_id = 0;
+    StreamId stream_id = 0;
+    uint64_t count = 0;
+    double total_ms = 0.0, min_ms = 0.0, max_ms = 0.0;
+    double p50_ms = 0.0, p90_ms = 0.0, p99_ms = 0.0, p999_ms = 0.0;
+    uint64_t allocations = 0;///< Heap allocations in all the calls (allocation counting)
+
+    double mean_ms() const
+    {
+        return count ? total_ms / static_cast<double>(count) : 0.0;
     }
 
-    struct ProfileData
+    double allocations_per_call() const
     {
-        long long total_duration = 0;
-        int frame_count = 0;
-    };
+        return count ? static_cast<double>(allocations) /
+                               static_cast<double>(count)
+                     : 0.0;
+    }
+};
 
-    std::unordered_map<std::string, ProfileData> profiles_;
-    std::mutex mutex_;
+/**
+ * @brief Statistics of all the scopes called since the last reset
+ */
+struct Snapshot
+{
+    std::vector<ScopeStats> scopes;///< Sorted by stream, then scope registration order
+    uint64_t dropped_events = 0;   ///< Events dropped because a thread buffer was full
+    double interval_s = 0.0;       ///< Time since the last reset (or the start of the tracing)
 };
 
+/**
+ * @brief Drain the thread buffers into the histograms (also done by the collector thread)
+ */
+BOTSORT_EXPORT void collect();
+
+/**
+ * @brief Collect the pending events and return the statistics of each scope and stream
+ *
+ * @param reset_after If true, the histograms are cleared atomically with the snapshot (interval reporting)
+ * @return Snapshot Statistics
+ */
+BOTSORT_EXPORT Snapshot snapshot(bool reset_after = false);
+
+/**
+ * @brief Number of events dropped because a thread buffer was full
+ */
+BOTSORT_EXPORT uint64_t dropped_events();
 
-class Profiler
+/**
+ * @brief Clear the histograms
+ */
+BOTSORT_EXPORT void reset();
+
+/**
+ * @brief Print a table of the statistics of each scope and stream (and the allocations per call if counted)
+ */
+BOTSORT_EXPORT void print_report(std::ostream &os);
+
+/**
+ * @brief Enable the tracing and stream the events to a Chrome trace-event JSON file
+ *  One complete ("X") event per scope call: pid is the stream, tid the thread, the args hold the
+ *  frame id, the object count and the heap allocations (if counted). The events are written by the
+ *  collector as they are drained, so the memory stays bounded by the thread buffers whatever the
+ *  length of the trace.
+ *  The JSON array is closed by stop_trace(), the file remains loadable if the process crashes.
+ *
+ * @param filepath Output file, overwritten
+ * @return true if the file was opened
+ */
+BOTSORT_EXPORT bool start_trace(const std::string &filepath);
+
+/**
+ * @brief Write the pending events and close the trace file (the tracing stays enabled)
+ */
+BOTSORT_EXPORT void stop_trace();
+
+
+/**
+ * @brief Records the time between its construction and stop() (or its destruction) if the tracing is enabled
+ */
+class ScopedTimer
 {
 public:
-    Profiler(const std::string &name)
-        : _func_name(name),
-          _start_time_point(std::chrono::high_resolution_clock::now())
+    explicit ScopedTimer(ScopeId scope_id)
+        : _scope_id(scope_id), _start(is_enabled() ? now() : 0),
+          _count_allocations(_start && is_counting_allocations()),
+          _start_allocations(_count_allocations ? thread_allocations() : 0)
     {
     }
 
-    ~Profiler()
+    ~ScopedTimer()
     {
-        auto end_time_point = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
-                                end_time_point - _start_time_point)
-                                .count();
-        ProfilerManager::get_instance().add_profile(_func_name, duration);
+        stop();
     }
 
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    void stop()
+    {
+        if (_start)
+        {
+            const uint64_t allocations =
+                    _count_allocations
+                            ? thread_allocations() - _start_allocations
+                            : 0;
+            record(_scope_id, _start, now(), _count,
+                   static_cast<uint32_t>(allocations));
+            _start = 0;
+        }
+    }
+
+    void set_count(size_t count)
+    {
+        _count = static_cast<uint32_t>(count);
+    }
+
+
 private:
-    std::string _func_name;
-    std::chrono::time_point<std::chrono::high_resolution_clock>
-            _start_time_point;
+    ScopeId _scope_id;
+    uint32_t _count = 0;
+    uint64_t _start;
+    bool _count_allocations;
+    uint64_t _start_allocations;
 };
+}// namespace bot_profiler
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "DataType.h"
+#include "botsort_export.h"
+
+
+/**
+ * Recording and replay of tracking sessions
+ *  A session file holds, for each frame given to BoTSORT::track(), the inputs of the tracker
+ *  (detections and frame size) and the outputs of its expensive stages (GMC homography and ReID
+ *  features), so that BoTSORT::replay() runs the association and Kalman filter on the exact same data
+ *  without video decoding, camera motion estimation or inference. The output tracks are recorded
+ *  too, to check that a replay reproduces the session bit-exactly.
+ *
+ * File format (native byte order, little-endian on all supported platforms):
+ *  header: "BOTREPLY", uint32 version, uint32 feature dim, uint32 length + distance metric,
+ *          uint8 late features
+ *  frame:  uint32 frame id, int32 width, int32 height,
+ *          uint32 n + n detections (float x, y, w, h, int32 class id, float confidence),
+ *          uint8 has homography + 9 floats (row-major) if set,
+ *          uint32 n + n uint32 detection indices + n * feature dim floats,
+ *          uint32 n + n uint32 late detection indices,
+ *          uint32 n + n * feature dim floats of late features,
+ *          uint32 n + n tracks (int32 track id, float x, y, w, h)
+ */
+namespace bot_replay
+{
+/**
+ * @brief Settings of the recorded tracker needed by the replay
+ */
+struct SessionInfo
+{
+    std::string distance_metric;///< Appearance distance of the ReID model, empty if ReID was disabled
+    bool late_features = false; ///< Features applied one frame late (reid_late_features)
+};
+
+/**
+ * @brief Output track of a recorded frame
+ */
+struct TrackRecord
+{
+    int track_id;
+    cv::Rect_<float> tlwh;
+};
+
+/**
+ * @brief Inputs and stage outputs of one BoTSORT::track() call
+ */
+struct FrameRecord
+{
+    uint32_t frame_id = 0;
+    cv::Size frame_size;
+    std::vector<Detection> detections;///< As given to track(), before clamping
+    std::optional<HomographyMatrix> homography;///< Camera motion applied to the tracks, if GMC ran
+    std::vector<uint32_t> feature_indices;///< Detections (indices in detections) with a ReID feature
+    FeatureMatrix features;             ///< Feature given to each of these detections, one row per index
+    std::vector<uint32_t> late_indices; ///< Detections whose feature is deferred to the next frame
+    FeatureMatrix late_features;        ///< Features of the late_indices of the previous frame, one row per index
+    std::vector<TrackRecord> tracks;    ///< Output tracks
+};
+
+
+/**
+ * @brief Writes a session file frame by frame
+ *  Each frame is flushed, so that the file is readable up to the last frame if the process dies.
+ */
+class BOTSORT_EXPORT ReplayWriter
+{
+public:
+    ReplayWriter() = default;
+    ~ReplayWriter() = default;
+
+    ReplayWriter(const ReplayWriter &) = delete;
+    ReplayWriter &operator=(const ReplayWriter &) = delete;
+
+    /**
+     * @brief Create the file and write the header
+     *
+     * @param filepath Output file, overwritten
+     * @param session Settings of the recorded tracker
+     * @return true if the file was created
+     */
+    bool open(const std::string &filepath, const SessionInfo &session);
+
+    void write(const FrameRecord &frame);
+
+    void close();
+
+    bool is_open() const
+    {
+        return _file.is_open();
+    }
+
+
+private:
+    std::ofstream _file;
+};
+
+
+/**
+ * @brief Reads a session file frame by frame
+ */
+class BOTSORT_EXPORT ReplayReader
+{
+public:
+    ReplayReader() = default;
+    ~ReplayReader() = default;
+
+    ReplayReader(const ReplayReader &) = delete;
+    ReplayReader &operator=(const ReplayReader &) = delete;
+
+    /**
+     * @brief Open the file and read the header
+     *
+     * @param filepath Session file
+     * @return true if the file is a session file of a compatible version and feature dimension
+     */
+    bool open(const std::string &filepath);
+
+    /**
+     * @brief Read the next frame
+     *
+     * @param frame Frame record, overwritten
+     * @return true if a frame was read, false at the end of the file (or on a truncated frame)
+     */
+    bool read(FrameRecord &frame);
+
+    const SessionInfo &session() const
+    {
+        return _session;
+    }
+
+
+private:
+    std::ifstream _file;
+    SessionInfo _session;
+};
+}// namespace bot_replay
@@ -1,7 +1,7 @@
 #pragma once
-#include <deque>
 #include <memory>
 
+#include "FeatureHistory.h"
 #include "KalmanFilter.h"
 #include "KalmanFilterAccBased.h"
 #include "botsort_export.h"
@@ -17,6 +17,16 @@ enum TrackState
     Removed
 };
 
+/**
+ * @brief Feature vector encoded in a quantized format (see FeatureQuantization.h), with its squared
+ *  norm computed in that format
+ */
+struct EncodedFeature
+{
+    const uint8_t *data;
+    float sq_norm;
+};
+
 class BOTSORT_EXPORT Track
 {
 public:
@@ -27,11 +37,27 @@ public:
      * @param score Detection score
      * @param class_id Detection class ID
      * @param feat (Optional) Detection feature vector
-     * @param feat_history_size Size of the feature history (default: 50)
+     * @param feat_history_size Size of the feature history, 0 disables the history (default: 0)
+     * @param feat_history_format Storage format of the feature history (default: Float32)
+     * @param appearance_format Format of the features in the appearance distance, the track keeps
+     *  encoded copies of its features if it is quantized (default: Float32)
      */
     Track(std::vector<float> tlwh, float score, uint8_t class_id,
           std::optional<FeatureVector> feat = std::nullopt,
-          int feat_history_size = 50);
+          int feat_history_size = 0,
+          FeatureFormat feat_history_format = FeatureFormat::Float32,
+          FeatureFormat appearance_format = FeatureFormat::Float32);
+
+    /**
+     * @brief Reinitialize the track in place as a new track of the given detection, without feature
+     *  Same state as the constructor (no ID, zero Kalman state until activate()), nothing of the
+     *  previous owner is kept but the capacity of the vectors (see TrackPool)
+     * 
+     * @param tlwh Detection bounding box in the format [top-left-x, top-left-y, width, height]
+     * @param score Detection score
+     * @param class_id Detection class ID
+     */
+    void reset(const cv::Rect_<float> &tlwh, float score, uint8_t class_id);
 
     /**
      * @brief Get the next track ID
@@ -68,7 +94,7 @@ public:
     /**
      * @brief Get the latest detection bounding box in the format [top-left-x, top-left-y, width, height]
      */
-    std::vector<float> get_tlwh() const;
+    const std::vector<float> &get_tlwh() const;
 
     /**
      * @brief Get the score object
@@ -137,14 +163,86 @@ public:
     void update(KalmanFilter &kalman_filter, Track &new_track,
                 uint32_t frame_id);
 
+    /**
+     * @brief Set the visual feature vector of a track created without one (selective re-ID)
+     * 
+     * @param feat Detection feature vector
+     * @return true if the feature was applied, false if it was rejected (zero or non-finite)
+     */
+    bool set_features(const FeatureVector &feat);
+
+    /**
+     * @brief Whether the track has a visual feature vector
+     */
+    bool has_features() const
+    {
+        return _has_feat;
+    }
+
+    /**
+     * @brief Get the latest (normalized) feature vector, only valid if has_features()
+     */
+    const FeatureVector &get_curr_feat() const
+    {
+        return _feat->curr;
+    }
+
+    /**
+     * @brief Get the smoothed (exponential moving average) feature vector, only valid if has_features()
+     */
+    const FeatureVector &get_smooth_feat() const
+    {
+        return _feat->smooth;
+    }
+
+    /**
+     * @brief Format of the features in the appearance distance, see get_encoded_curr_feat()
+     */
+    FeatureFormat get_appearance_format() const
+    {
+        return _appearance_format;
+    }
+
+    /**
+     * @brief Get the latest feature encoded in get_appearance_format(), only valid if has_features()
+     *  and the format is quantized
+     */
+    EncodedFeature get_encoded_curr_feat() const
+    {
+        return {_feat->encoded.data(), _feat->curr_sq_norm};
+    }
+
+    /**
+     * @brief Get the smoothed feature encoded in get_appearance_format(), only valid if has_features()
+     *  and the format is quantized
+     */
+    EncodedFeature get_encoded_smooth_feat() const
+    {
+        return {_feat->encoded.data() +
+                        feature_storage_bytes(_appearance_format),
+                _feat->smooth_sq_norm};
+    }
+
+    const FeatureHistory &get_feature_history() const
+    {
+        return _feat_history;
+    }
+
+    /**
+     * @brief Memory used by the track, including its heap allocations (bytes)
+     */
+    size_t memory_footprint() const;
+
 private:
     /**
      * @brief Updates visual feature vector and feature history
      * Done by using a weighted average of the current feature vector and the previous feature vector
      * 
      * @param feat Current feature vector
+     * @return true if the feature was applied, a zero or non-finite feature is rejected
+     *  (its normalization would poison the smoothed feature with NaNs)
      */
-    void _update_features(const std::shared_ptr<FeatureVector> &feat);
+    bool _update_features(const FeatureVector &feat);
 
     /**
      * @brief Populate a DetVec bbox object (xywh) from the detection bounding box (tlwh)
@@ -181,10 +279,9 @@ public:
     int state;
 
     uint32_t frame_id, tracklet_len, start_frame;
+    uint32_t feat_frame_id;///< Frame-id of the last feature update
 
     std::vector<float> det_tlwh;
-    std::shared_ptr<FeatureVector> curr_feat;
-    std::unique_ptr<FeatureVector> smooth_feat;
     KFStateSpaceVec mean;
     KFStateSpaceMatrix covariance;
 
@@ -195,6 +292,20 @@ private:
     uint8_t _class_id;
     static constexpr float _alpha = 0.9;
 
-    int _feat_history_size;
-    std::deque<std::shared_ptr<FeatureVector>> _feat_history;
+    // Feature vectors, allocated with the first feature: the tracks that never get one (Re-ID
+    // disabled, detections skipped by selective re-ID) don't carry them
+    struct Features
+    {
+        FeatureVector curr, smooth;
+
+        // Current then smoothed feature encoded in the appearance format (quantized formats only),
+        // refreshed with the features so that the distance does not re-encode them every frame
+        std::vector<uint8_t> encoded;
+        float curr_sq_norm = 0.0F, smooth_sq_norm = 0.0F;
+    };
+
+    FeatureFormat _appearance_format;
+    bool _has_feat;
+    std::unique_ptr<Features> _feat;
+    FeatureHistory _feat_history;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DataType.h"
+#include "FrameArena.h"
 
 /**
  * @brief Calculate the cosine distance between two feature vectors
@@ -9,10 +10,9 @@
  * @param y Feature vector 2
  * @return float Cosine distance (1 - cosine similarity)
  */
-inline float cosine_distance(const std::unique_ptr<FeatureVector> &x,
-                             const std::shared_ptr<FeatureVector> &y)
+inline float cosine_distance(const FeatureVector &x, const FeatureVector &y)
 {
-    return 1.0f - (x->dot(*y) / (x->norm() * y->norm() + 1e-5f));
+    return 1.0f - (x.dot(y) / (x.norm() * y.norm() + 1e-5f));
 }
 
 
@@ -23,10 +23,9 @@ inline float cosine_distance(const std::unique_ptr<FeatureVector> &x,
  * @param y Feature vector 2
  * @return float Euclidean distance
  */
-inline float euclidean_distance(const std::unique_ptr<FeatureVector> &x,
-                                const std::shared_ptr<FeatureVector> &y)
+inline float euclidean_distance(const FeatureVector &x, const FeatureVector &y)
 {
-    return (x->transpose() - y->transpose()).norm();
+    return (x - y).norm();
 }
 
 
@@ -51,7 +50,37 @@ inline float iou(const std::vector<float> &tlwh_a,
     return area_i / (area_a + area_b - area_i);
 }
 
+/**
+ * @brief Solve the linear assignment problem of a cost matrix with the LAPJV algorithm
+ * 
+ * @param cost Cost matrix (tracks x detections)
+ * @param rowsol Column assigned to each row, -1 if unassigned
+ * @param colsol Row assigned to each column, -1 if unassigned
+ * @param extend_cost Extend the cost matrix so that non-square matrices can be solved (default: false)
+ * @param cost_limit Cost above which a pair is left unassigned (default: no limit)
+ * @param return_cost Whether to compute the cost of the assignment (default: true)
+ * @return double Cost of the assignment
+ */
 double lapjv(CostMatrix &cost, std::vector<int> &rowsol,
              std::vector<int> &colsol, bool extend_cost = false,
              float cost_limit = std::numeric_limits<float>::max(),
-             bool return_cost = true);
\ No newline at end of file
+             bool return_cost = true);
+
+/**
+ * @brief lapjv() with the solver workspace (extended cost matrix and scratch arrays) taken from a frame arena
+ * 
+ * @param rowsol Column assigned to each row, cost.rows() elements
+ * @param colsol Row assigned to each column, cost.cols() elements
+ * @param arena Frame arena of the workspace, the solve itself does not allocate once the arena is warmed up
+ */
+double lapjv(const Eigen::Ref<const CostMatrix> &cost, int *rowsol,
+             int *colsol, FrameArena &arena, bool extend_cost = false,
+             float cost_limit = std::numeric_limits<float>::max(),
+             bool return_cost = true);
+
+/**
+ * @brief Arena memory used by lapjv() for a rows x cols cost matrix (bytes), to size a FrameArena
+ */
+size_t lapjv_arena_bytes(Eigen::Index rows, Eigen::Index cols,
+                         bool extend_cost = false,
+                         float cost_limit = std::numeric_limits<float>::max());
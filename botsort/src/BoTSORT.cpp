@@ -1,5 +1,6 @@
 #include "BoTSORT.h"
 
+#include <algorithm>
 #include <optional>
 #include <unordered_set>
 
@@ -8,7 +9,67 @@
 #include "DataType.h"
 #include "INIReader.h"
 #include "matching.h"
+#include "metrics.h"
 #include "profiler.h"
+#include "utils.h"
+
+
+namespace
+{
+enum AssociationStage : size_t
+{
+    FIRST_ASSOCIATION,
+    SECOND_ASSOCIATION,
+    UNCONFIRMED_ASSOCIATION
+};
+
+enum TrackCount : size_t
+{
+    ACTIVE_TRACKS,
+    LOST_TRACKS
+};
+
+enum ReIDResult : size_t
+{
+    REID_EXTRACTED,
+    REID_SKIPPED
+};
+
+bot_metrics::Counter frames_total("botsort_frames_total",
+                                  "Frames processed by the tracker");
+bot_metrics::Gauge frames_per_second(
+        "botsort_frames_per_second",
+        "Input frame rate of the tracker (exponential moving average)");
+bot_metrics::Counter detections_total("botsort_detections_total",
+                                      "Detections given to the tracker");
+bot_metrics::Counter output_tracks_total("botsort_output_tracks_total",
+                                         "Tracks returned by the tracker");
+bot_metrics::Gauge tracks("botsort_tracks", "Current number of tracks",
+                          "state", {"active", "lost"});
+bot_metrics::Counter tracks_created_total("botsort_tracks_created_total",
+                                          "New tracks initialized");
+bot_metrics::Counter
+        tracks_removed_total("botsort_tracks_removed_total",
+                             "Tracks removed (lost for too long or "
+                             "unconfirmed without match)");
+bot_metrics::Counter association_candidates_total(
+        "botsort_association_candidates_total",
+        "Detections entering each association stage", "stage",
+        {"first", "second", "unconfirmed"});
+bot_metrics::Counter association_matches_total(
+        "botsort_association_matches_total",
+        "Detections matched to a track in each association stage", "stage",
+        {"first", "second", "unconfirmed"});
+bot_metrics::Counter reid_detections_total(
+        "botsort_reid_detections_total",
+        "Re-ID candidate detections, embedded or skipped (selective re-ID, "
+        "feature cache)",
+        "result", {"extracted", "skipped"});
+bot_metrics::Counter reid_cache_hits_total(
+        "botsort_reid_cache_hits_total",
+        "Detections that reused a cached feature (reid_cache)");
+}// namespace
+
 
 BoTSORT::BoTSORT(const std::string &tracker_config_path,
                  const std::string &gmc_config_path,
@@ -23,13 +84,19 @@ BoTSORT::BoTSORT(const std::string &tracker_config_path,
     _max_time_lost = _buffer_size;
     _kalman_filter = std::make_unique<KalmanFilter>(
             static_cast<double>(1.0 / _frame_rate));
+    _track_pool = std::make_unique<TrackPool>(
+            _feat_history_size, _feat_history_format, _appearance_format);
 
 
     // Re-ID module, load visual feature extractor here
     if (_reid_enabled && reid_config_path.size() > 0 &&
         reid_onnx_model_path.size() > 0)
+    {
         _reid_model = std::make_unique<ReIDModel>(reid_config_path,
                                                   reid_onnx_model_path);
+        if (_reid_async)
+            _reid_worker = std::make_unique<ReIDWorker>(*_reid_model);
+    }
     else
     {
         std::cout << "Re-ID module disabled" << std::endl;
@@ -53,13 +120,98 @@ BoTSORT::BoTSORT(const std::string &tracker_config_path,
 std::vector<std::shared_ptr<Track>>
 BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
 {
-    //PROFILE_FUNCTION();
+    std::vector<std::shared_ptr<Track>> output_tracks;
+    _track(detections, frame, frame.size(), nullptr, nullptr, output_tracks);
+    return output_tracks;
+}
+
+
+void BoTSORT::track(const std::vector<Detection> &detections,
+                    const cv::Mat &frame,
+                    std::vector<std::shared_ptr<Track>> &output_tracks)
+{
+    _track(detections, frame, frame.size(), nullptr, nullptr, output_tracks);
+}
+
+
+std::vector<std::shared_ptr<Track>>
+BoTSORT::replay(const bot_replay::FrameRecord &frame,
+                const bot_replay::SessionInfo &session)
+{
+    // The detections are clamped to the frame in place, on a copy that keeps its capacity
+    _replay_detections = frame.detections;
+    std::vector<std::shared_ptr<Track>> output_tracks;
+    _track(_replay_detections, cv::Mat(), frame.frame_size, &frame, &session,
+           output_tracks);
+    return output_tracks;
+}
+
+
+bool BoTSORT::start_recording(const std::string &filepath)
+{
+    bot_replay::SessionInfo session;
+    if (_reid_enabled)
+        session.distance_metric = _reid_model->get_distance_metric();
+    session.late_features = _reid_worker && _reid_late_features;
+
+    auto recorder = std::make_unique<bot_replay::ReplayWriter>();
+    if (!recorder->open(filepath, session))
+        return false;
+    _recorder = std::move(recorder);
+    return true;
+}
+
+
+void BoTSORT::stop_recording()
+{
+    _recorder.reset();
+}
+
+
+void BoTSORT::_track(const std::vector<Detection> &detections,
+                     const cv::Mat &frame, cv::Size frame_size,
+                     const bot_replay::FrameRecord *replay_frame,
+                     const bot_replay::SessionInfo *replay_session,
+                     std::vector<std::shared_ptr<Track>> &output_tracks)
+{
+    PROFILE_BEGIN(track_timer, "BoTSORT::track");
+    PROFILE_COUNT(track_timer, detections.size());
     ////////////////// CREATE TRACK OBJECT FOR ALL THE DETECTIONS //////////////////
+    PROFILE_BEGIN(split_timer, "BoTSORT::track/split_detections");
+    PROFILE_COUNT(split_timer, detections.size());
     // For all detections, extract features, create tracks and classify on the segregate of confidence
     _frame_id++;
-    std::vector<std::shared_ptr<Track>> activated_tracks, refind_tracks;
-    std::vector<std::shared_ptr<Track>> detections_high_conf,
-            detections_low_conf;
+    bot_profiler::set_frame_id(_frame_id);
+    _metrics_stream_id = bot_profiler::get_stream_id();
+    _frame_arena.reset();
+    _track_pool->recycle();
+
+    const bool recording = _recorder && !replay_frame;
+    if (recording)
+    {
+        _record.frame_id = _frame_id;
+        _record.frame_size = frame_size;
+        _record.detections = detections;
+        _record.homography.reset();
+        _record.late_indices.clear();
+        _record.late_features.resize(0, FEATURE_DIM);
+        _recorded_features.clear();
+    }
+
+    // Track created for each detection, to match the recorded features with the detections
+    std::vector<std::shared_ptr<Track>> &detection_tracks =
+            _scratch.detection_tracks;
+    if (recording || replay_frame)
+        detection_tracks.resize(detections.size());
+
+    std::vector<std::shared_ptr<Track>> &activated_tracks =
+            _scratch.activated_tracks;
+    std::vector<std::shared_ptr<Track>> &refind_tracks =
+            _scratch.refind_tracks;
+    std::vector<std::shared_ptr<Track>> &detections_high_conf =
+            _scratch.detections_high_conf;
+    std::vector<std::shared_ptr<Track>> &detections_low_conf =
+            _scratch.detections_low_conf;
     detections_low_conf.reserve(detections.size()),
             detections_high_conf.reserve(detections.size());
 
@@ -71,30 +223,21 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
             detection.bbox_tlwh.x = std::max(0.0f, detection.bbox_tlwh.x);
             detection.bbox_tlwh.y = std::max(0.0f, detection.bbox_tlwh.y);
             detection.bbox_tlwh.width =
-                    std::min(static_cast<float>(frame.cols - 1),
+                    std::min(static_cast<float>(frame_size.width - 1),
                              detection.bbox_tlwh.width);
             detection.bbox_tlwh.height =
-                    std::min(static_cast<float>(frame.rows - 1),
+                    std::min(static_cast<float>(frame_size.height - 1),
                              detection.bbox_tlwh.height);
 
-            std::shared_ptr<Track> tracklet;
-            std::vector<float> tlwh = {
-                    detection.bbox_tlwh.x, detection.bbox_tlwh.y,
-                    detection.bbox_tlwh.width, detection.bbox_tlwh.height};
-
+            // Visual features are extracted after KF predict and GMC, once the detections to embed are known
+            // The tracks of the detections are recycled, most of them are dropped after the association
             if (detection.confidence > _track_low_thresh)
             {
-                if (_reid_enabled)
-                {
-                    FeatureVector embedding =
-                            _extract_features(frame, detection.bbox_tlwh);
-                    tracklet = std::make_shared<Track>(
-                            tlwh, detection.confidence, detection.class_id,
-                            embedding);
-                }
-                else
-                    tracklet = std::make_shared<Track>(
-                            tlwh, detection.confidence, detection.class_id);
+                std::shared_ptr<Track> tracklet =
+                        _track_pool->acquire(detection);
+                if (!detection_tracks.empty())
+                    detection_tracks[&detection - detections.data()] =
+                            tracklet;
 
                 if (detection.confidence >= _track_high_thresh)
                     detections_high_conf.push_back(tracklet);
@@ -105,7 +248,10 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
     }
 
     // Segregate tracks in unconfirmed and tracked tracks
-    std::vector<std::shared_ptr<Track>> unconfirmed_tracks, tracked_tracks;
+    std::vector<std::shared_ptr<Track>> &unconfirmed_tracks =
+            _scratch.unconfirmed_tracks;
+    std::vector<std::shared_ptr<Track>> &tracked_tracks =
+            _scratch.tracked_tracks;
     for (const std::shared_ptr<Track> &track: _tracked_tracks)
     {
         if (!track->is_activated)
@@ -117,58 +263,175 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
             tracked_tracks.push_back(track);
         }
     }
+    PROFILE_END(split_timer);
     ////////////////// CREATE TRACK OBJECT FOR ALL THE DETECTIONS //////////////////
 
 
     ////////////////// Apply KF predict and GMC before running association algorithm //////////////////
     // Merge currently tracked tracks and lost tracks
-    std::vector<std::shared_ptr<Track>> tracks_pool;
-    tracks_pool = _merge_track_lists(tracked_tracks, _lost_tracks);
+    PROFILE_BEGIN(predict_timer, "BoTSORT::track/predict");
+    std::vector<std::shared_ptr<Track>> &tracks_pool = _scratch.tracks_pool;
+    _merge_track_lists(tracked_tracks, _lost_tracks, tracks_pool);
 
     // Predict the location of the tracks with KF (even for lost tracks)
     Track::multi_predict(tracks_pool, *_kalman_filter);
+    PROFILE_COUNT(predict_timer, tracks_pool.size());
+    PROFILE_END(predict_timer);
+
+    // Asynchronous re-ID: submit the crops now so that inference overlaps with GMC,
+    // selective re-ID gates against the tracks after GMC as in the synchronous mode, so it submits after GMC
+    _reid_stats = ReIDStats();
+    _reid_stats.candidates = static_cast<uint32_t>(
+            detections_high_conf.size() + detections_low_conf.size());
+    std::vector<std::shared_ptr<Track>> reid_detections;
+    ReIDWorker::Ticket reid_ticket = 0;
+    auto submit_reid = [&]() {
+        PROFILE_SCOPE("BoTSORT::track/reid_submit");
+        reid_detections = _get_reid_detections(
+                frame, detections_high_conf, detections_low_conf, tracks_pool,
+                unconfirmed_tracks);
+        reid_ticket = _reid_worker->submit(frame, _get_rois(reid_detections));
+    };
+    if (_reid_worker && !replay_frame)
+    {
+        _apply_late_features(nullptr);
+        if (!_selective_reid)
+            submit_reid();
+    }
+    else if (replay_frame)
+    {
+        _apply_late_features(replay_frame);
+    }
+    _associations.clear();
 
-    // Estimate camera motion and apply camera motion compensation
-    if (_gmc_enabled)
+    // Estimate camera motion (or use the recorded one) and apply camera motion compensation
+    if (replay_frame ? replay_frame->homography.has_value() : _gmc_enabled)
     {
-        HomographyMatrix H = _gmc_algo->apply(frame, detections);
+        PROFILE_SCOPE("BoTSORT::track/gmc");
+        HomographyMatrix H = replay_frame ? *replay_frame->homography
+                                          : _gmc_algo->apply(frame, detections);
         Track::multi_gmc(tracks_pool, H);
         Track::multi_gmc(unconfirmed_tracks, H);
+        if (recording)
+            _record.homography = H;
     }
+    if (_reid_worker && !replay_frame && _selective_reid)
+        submit_reid();
     ////////////////// Apply KF predict and GMC before running association algorithm //////////////////
 
 
+    ////////////////// Extract visual features //////////////////
+    PROFILE_BEGIN(reid_timer, "BoTSORT::track/reid");
+    // Appearance distance of the association, nullptr if the appearance is not used
+    const std::string *distance_metric =
+            _reid_enabled ? &_reid_model->get_distance_metric() : nullptr;
+    if (replay_frame)
+    {
+        // Recorded features, the appearance is used if the recorded tracker used it
+        distance_metric = replay_session->distance_metric.empty()
+                                  ? nullptr
+                                  : &replay_session->distance_metric;
+        _reid_stats.extracted = static_cast<uint32_t>(
+                _set_replay_features(detection_tracks, *replay_frame));
+
+        // Detections whose features the recorded tracker applied one frame late
+        for (uint32_t index: replay_frame->late_indices)
+            _late_detections.push_back(detection_tracks[index]);
+        _late_frame_id = _frame_id;
+        _reid_stats.deferred =
+                static_cast<uint32_t>(replay_frame->late_indices.size());
+    }
+    else if (_reid_worker)
+    {
+        // Join the features before the first association, or let them arrive one frame late
+        if (_reid_late_features && !_reid_worker->ready(reid_ticket))
+        {
+            _late_ticket = reid_ticket;
+            _late_frame_id = _frame_id;
+            _late_detections = reid_detections;
+            _reid_stats.deferred =
+                    static_cast<uint32_t>(reid_detections.size());
+            if (recording)
+                for (const std::shared_ptr<Track> &detection: reid_detections)
+                    _record.late_indices.push_back(static_cast<uint32_t>(
+                            std::find(detection_tracks.begin(),
+                                      detection_tracks.end(), detection) -
+                            detection_tracks.begin()));
+        }
+        else
+        {
+            _set_features(reid_detections, _reid_worker->wait(reid_ticket));
+        }
+    }
+    else if (_reid_enabled)
+    {
+        reid_detections = _get_reid_detections(
+                frame, detections_high_conf, detections_low_conf, tracks_pool,
+                unconfirmed_tracks);
+        _set_features(reid_detections,
+                      _extract_features(frame, reid_detections));
+    }
+    if (_reid_enabled && !replay_frame)
+    {
+        _reid_stats.extracted = static_cast<uint32_t>(reid_detections.size());
+        _reid_stats.skipped = _reid_stats.candidates - _reid_stats.extracted;
+
+        reid_detections_total.inc(_metrics_stream_id, _reid_stats.extracted,
+                                  REID_EXTRACTED);
+        reid_detections_total.inc(_metrics_stream_id, _reid_stats.skipped,
+                                  REID_SKIPPED);
+        reid_cache_hits_total.inc(_metrics_stream_id, _reid_stats.cache_hits);
+    }
+    PROFILE_COUNT(reid_timer, _reid_stats.extracted);
+    PROFILE_END(reid_timer);
+    ////////////////// Extract visual features //////////////////
+
+
     ////////////////// ASSOCIATION ALGORITHM STARTS HERE //////////////////
     ////////////////// First association, with high score detection boxes //////////////////
+    PROFILE_BEGIN(first_association_timer, "BoTSORT::track/first_association");
+    PROFILE_COUNT(first_association_timer, detections_high_conf.size());
     // Find IoU distance between all tracked tracks and high confidence detections
-    CostMatrix iou_dists, raw_emd_dist, iou_dists_mask_1st_association,
-            emd_dist_mask_1st_association;
-
-    std::tie(iou_dists, iou_dists_mask_1st_association) =
-            iou_distance(tracks_pool, detections_high_conf, _proximity_thresh);
+    // The cost matrices live in the frame arena, the embedding ones are empty without appearance
+    const auto num_pool_tracks = static_cast<Eigen::Index>(tracks_pool.size());
+    const auto num_high_conf =
+            static_cast<Eigen::Index>(detections_high_conf.size());
+    Eigen::Map<CostMatrix> iou_dists =
+            _frame_arena.matrix(num_pool_tracks, num_high_conf);
+    Eigen::Map<CostMatrix> iou_dists_mask_1st_association =
+            _frame_arena.matrix(num_pool_tracks, num_high_conf);
+    Eigen::Map<CostMatrix> raw_emd_dist = _frame_arena.matrix(
+            distance_metric ? num_pool_tracks : 0,
+            distance_metric ? num_high_conf : 0);
+    Eigen::Map<CostMatrix> emd_dist_mask_1st_association =
+            _frame_arena.matrix(raw_emd_dist.rows(), raw_emd_dist.cols());
+
+    iou_distance(tracks_pool, detections_high_conf, _proximity_thresh,
+                 iou_dists, iou_dists_mask_1st_association);
     fuse_score(iou_dists,
                detections_high_conf);// Fuse the score with IoU distance
 
-    if (_reid_enabled)
+    if (distance_metric)
     {
         // If re-ID is enabled, find the embedding distance between all tracked tracks and high confidence detections
-        std::tie(raw_emd_dist, emd_dist_mask_1st_association) =
-                embedding_distance(tracks_pool, detections_high_conf,
-                                   _appearance_thresh,
-                                   _reid_model->get_distance_metric());
+        embedding_distance(tracks_pool, detections_high_conf,
+                           _appearance_thresh, *distance_metric,
+                           _appearance_format, raw_emd_dist,
+                           emd_dist_mask_1st_association);
         fuse_motion(*_kalman_filter, raw_emd_dist, tracks_pool,
-                    detections_high_conf,
+                    detections_high_conf, _frame_arena,
                     _lambda);// Fuse the motion with embedding distance
     }
 
-    // Fuse the IoU distance and embedding distance to get the final distance matrix
-    CostMatrix distances_first_association = fuse_iou_with_emb(
-            iou_dists, raw_emd_dist, iou_dists_mask_1st_association,
-            emd_dist_mask_1st_association);
+    // Fuse the IoU distance and embedding distance to get the final distance matrix (in iou_dists)
+    fuse_iou_with_emb_inplace(iou_dists, raw_emd_dist,
+                              iou_dists_mask_1st_association,
+                              emd_dist_mask_1st_association);
 
     // Perform linear assignment on the final distance matrix, LAPJV algorithm is used here
-    AssociationData first_associations =
-            linear_assignment(distances_first_association, _match_thresh);
+    AssociationData &first_associations = _scratch.first_associations;
+    linear_assignment(iou_dists, _match_thresh, _frame_arena,
+                      first_associations);
 
     // Update the tracks with the associated detections
     for (const std::pair<int, int> &match: first_associations.matches)
@@ -177,6 +440,8 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
         const std::shared_ptr<Track> &detection =
                 detections_high_conf[match.second];
 
+        _record_association(detection, track);
+
         // If track was being actively tracked, we update the track with the new associated detection
         if (track->state == TrackState::Tracked)
         {
@@ -191,12 +456,23 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
             refind_tracks.push_back(track);
         }
     }
+    association_candidates_total.inc(_metrics_stream_id,
+                                     detections_high_conf.size(),
+                                     FIRST_ASSOCIATION);
+    association_matches_total.inc(_metrics_stream_id,
+                                  first_associations.matches.size(),
+                                  FIRST_ASSOCIATION);
+    PROFILE_END(first_association_timer);
     ////////////////// First association, with high score detection boxes //////////////////
 
 
     ////////////////// Second association, with low score detection boxes //////////////////
+    PROFILE_BEGIN(second_association_timer,
+                  "BoTSORT::track/second_association");
+    PROFILE_COUNT(second_association_timer, detections_low_conf.size());
     // Get all unmatched but tracked tracks after the first association, these tracks will be used for the second association
-    std::vector<std::shared_ptr<Track>> unmatched_tracks_after_1st_association;
+    std::vector<std::shared_ptr<Track>>
+            &unmatched_tracks_after_1st_association = _scratch.unmatched_tracks;
     for (int track_idx: first_associations.unmatched_track_indices)
     {
         const std::shared_ptr<Track> &track = tracks_pool[track_idx];
@@ -207,13 +483,16 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
     }
 
     // Find IoU distance between unmatched but tracked tracks left after the first association and low confidence detections
-    CostMatrix iou_dists_second;
-    iou_dists_second = iou_distance(unmatched_tracks_after_1st_association,
-                                    detections_low_conf);
+    Eigen::Map<CostMatrix> iou_dists_second = _frame_arena.matrix(
+            static_cast<Eigen::Index>(
+                    unmatched_tracks_after_1st_association.size()),
+            static_cast<Eigen::Index>(detections_low_conf.size()));
+    iou_distance(unmatched_tracks_after_1st_association, detections_low_conf,
+                 iou_dists_second);
 
     // Perform linear assignment on the distance matrix, LAPJV algorithm is used here
-    AssociationData second_associations =
-            linear_assignment(iou_dists_second, 0.5);
+    AssociationData &second_associations = _scratch.second_associations;
+    linear_assignment(iou_dists_second, 0.5, _frame_arena, second_associations);
 
     // Update the tracks with the associated detections
     for (const std::pair<int, int> &match: second_associations.matches)
@@ -223,6 +502,8 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
         const std::shared_ptr<Track> &detection =
                 detections_low_conf[match.second];
 
+        _record_association(detection, track);
+
         // If track was being actively tracked, we update the track with the new associated detection
         if (track->state == TrackState::Tracked)
         {
@@ -239,7 +520,7 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
     }
 
     // The tracks that are not associated with any detection even after the second association are marked as lost
-    std::vector<std::shared_ptr<Track>> lost_tracks;
+    std::vector<std::shared_ptr<Track>> &lost_tracks = _scratch.lost_tracks;
     for (int unmatched_track_index: second_associations.unmatched_track_indices)
     {
         const std::shared_ptr<Track> &track =
@@ -250,12 +531,22 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
             lost_tracks.push_back(track);
         }
     }
+    association_candidates_total.inc(_metrics_stream_id,
+                                     detections_low_conf.size(),
+                                     SECOND_ASSOCIATION);
+    association_matches_total.inc(_metrics_stream_id,
+                                  second_associations.matches.size(),
+                                  SECOND_ASSOCIATION);
+    PROFILE_END(second_association_timer);
     ////////////////// Second association, with low score detection boxes //////////////////
 
 
     ////////////////// Deal with unconfirmed tracks //////////////////
+    PROFILE_BEGIN(unconfirmed_timer, "BoTSORT::track/unconfirmed_association");
+    PROFILE_COUNT(unconfirmed_timer, unconfirmed_tracks.size());
     std::vector<std::shared_ptr<Track>>
-            unmatched_detections_after_1st_association;
+            &unmatched_detections_after_1st_association =
+                    _scratch.unmatched_detections;
     for (int detection_idx: first_associations.unmatched_det_indices)
     {
         const std::shared_ptr<Track> &detection =
@@ -264,36 +555,50 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
     }
 
     //Find IoU distance between unconfirmed tracks and high confidence detections left after the first association
-    CostMatrix iou_dists_unconfirmed, raw_emd_dist_unconfirmed,
-            iou_dists_mask_unconfirmed, emd_dist_mask_unconfirmed;
-
-    std::tie(iou_dists_unconfirmed, iou_dists_mask_unconfirmed) = iou_distance(
-            unconfirmed_tracks, unmatched_detections_after_1st_association,
-            _proximity_thresh);
+    const auto num_unconfirmed =
+            static_cast<Eigen::Index>(unconfirmed_tracks.size());
+    const auto num_unmatched_dets = static_cast<Eigen::Index>(
+            unmatched_detections_after_1st_association.size());
+    Eigen::Map<CostMatrix> iou_dists_unconfirmed =
+            _frame_arena.matrix(num_unconfirmed, num_unmatched_dets);
+    Eigen::Map<CostMatrix> iou_dists_mask_unconfirmed =
+            _frame_arena.matrix(num_unconfirmed, num_unmatched_dets);
+    Eigen::Map<CostMatrix> raw_emd_dist_unconfirmed = _frame_arena.matrix(
+            distance_metric ? num_unconfirmed : 0,
+            distance_metric ? num_unmatched_dets : 0);
+    Eigen::Map<CostMatrix> emd_dist_mask_unconfirmed = _frame_arena.matrix(
+            raw_emd_dist_unconfirmed.rows(), raw_emd_dist_unconfirmed.cols());
+
+    iou_distance(unconfirmed_tracks, unmatched_detections_after_1st_association,
+                 _proximity_thresh, iou_dists_unconfirmed,
+                 iou_dists_mask_unconfirmed);
     fuse_score(iou_dists_unconfirmed,
                unmatched_detections_after_1st_association);
 
-    if (_reid_enabled)
+    if (distance_metric)
     {
         // Find embedding distance between unconfirmed tracks and high confidence detections left after the first association
-        std::tie(raw_emd_dist_unconfirmed, emd_dist_mask_unconfirmed) =
-                embedding_distance(unconfirmed_tracks,
-                                   unmatched_detections_after_1st_association,
-                                   _appearance_thresh,
-                                   _reid_model->get_distance_metric());
+        embedding_distance(unconfirmed_tracks,
+                           unmatched_detections_after_1st_association,
+                           _appearance_thresh, *distance_metric,
+                           _appearance_format, raw_emd_dist_unconfirmed,
+                           emd_dist_mask_unconfirmed);
         fuse_motion(*_kalman_filter, raw_emd_dist_unconfirmed,
                     unconfirmed_tracks,
-                    unmatched_detections_after_1st_association, _lambda);
+                    unmatched_detections_after_1st_association, _frame_arena,
+                    _lambda);
     }
 
-    // Fuse the IoU distance and the embedding distance
-    CostMatrix distances_unconfirmed = fuse_iou_with_emb(
-            iou_dists_unconfirmed, raw_emd_dist_unconfirmed,
-            iou_dists_mask_unconfirmed, emd_dist_mask_unconfirmed);
+    // Fuse the IoU distance and the embedding distance (in iou_dists_unconfirmed)
+    fuse_iou_with_emb_inplace(iou_dists_unconfirmed, raw_emd_dist_unconfirmed,
+                              iou_dists_mask_unconfirmed,
+                              emd_dist_mask_unconfirmed);
 
     // Perform linear assignment on the distance matrix, LAPJV algorithm is used here
-    AssociationData unconfirmed_associations =
-            linear_assignment(distances_unconfirmed, 0.7);
+    AssociationData &unconfirmed_associations =
+            _scratch.unconfirmed_associations;
+    linear_assignment(iou_dists_unconfirmed, 0.7, _frame_arena,
+                      unconfirmed_associations);
 
     for (const std::pair<int, int> &match: unconfirmed_associations.matches)
     {
@@ -303,12 +608,14 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
 
         // If the unconfirmed track is associated with a detection we update the track with the new associated detection
         // and add the track to the activated tracks list
+        _record_association(detection, track);
         track->update(*_kalman_filter, *detection, _frame_id);
         activated_tracks.push_back(track);
     }
 
     // All the unconfirmed tracks that are not associated with any detection are marked as removed
-    std::vector<std::shared_ptr<Track>> removed_tracks;
+    std::vector<std::shared_ptr<Track>> &removed_tracks =
+            _scratch.removed_tracks;
     for (int unmatched_track_index:
          unconfirmed_associations.unmatched_track_indices)
     {
@@ -317,11 +624,21 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
         track->mark_removed();
         removed_tracks.push_back(track);
     }
+    association_candidates_total.inc(
+            _metrics_stream_id,
+            unmatched_detections_after_1st_association.size(),
+            UNCONFIRMED_ASSOCIATION);
+    association_matches_total.inc(_metrics_stream_id,
+                                  unconfirmed_associations.matches.size(),
+                                  UNCONFIRMED_ASSOCIATION);
+    PROFILE_END(unconfirmed_timer);
     ////////////////// Deal with unconfirmed tracks //////////////////
 
 
     ////////////////// Initialize new tracks //////////////////
-    std::vector<std::shared_ptr<Track>> unmatched_high_conf_detections;
+    PROFILE_BEGIN(new_tracks_timer, "BoTSORT::track/new_tracks");
+    std::vector<std::shared_ptr<Track>> &unmatched_high_conf_detections =
+            _scratch.unmatched_high_conf_detections;
     for (int detection_idx: unconfirmed_associations.unmatched_det_indices)
     {
         const std::shared_ptr<Track> &detection =
@@ -335,14 +652,19 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
     {
         if (detection->get_score() >= _new_track_thresh)
         {
+            _record_association(detection, detection);
             detection->activate(*_kalman_filter, _frame_id);
             activated_tracks.push_back(detection);
+            tracks_created_total.inc(_metrics_stream_id);
         }
     }
+    PROFILE_COUNT(new_tracks_timer, unmatched_high_conf_detections.size());
+    PROFILE_END(new_tracks_timer);
     ////////////////// Initialize new tracks //////////////////
 
 
     ////////////////// Update lost tracks state //////////////////
+    PROFILE_BEGIN(cleanup_timer, "BoTSORT::track/cleanup");
     for (const std::shared_ptr<Track> &track: _lost_tracks)
     {
         if (_frame_id - track->end_frame() > _max_time_lost)
@@ -355,7 +677,8 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
 
 
     ////////////////// Clean up the track lists //////////////////
-    std::vector<std::shared_ptr<Track>> updated_tracked_tracks;
+    std::vector<std::shared_ptr<Track>> &updated_tracked_tracks =
+            _scratch.updated_tracked_tracks;
     for (const std::shared_ptr<Track> &_tracked_track: _tracked_tracks)
     {
         if (_tracked_track->state == TrackState::Tracked)
@@ -363,25 +686,32 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
             updated_tracked_tracks.push_back(_tracked_track);
         }
     }
-    _tracked_tracks =
-            _merge_track_lists(updated_tracked_tracks, activated_tracks);
-    _tracked_tracks = _merge_track_lists(_tracked_tracks, refind_tracks);
-
-    _lost_tracks = _merge_track_lists(_lost_tracks, lost_tracks);
-    _lost_tracks = _remove_from_list(_lost_tracks, _tracked_tracks);
-    _lost_tracks = _remove_from_list(_lost_tracks, removed_tracks);
-
-    std::vector<std::shared_ptr<Track>> tracked_tracks_cleaned,
-            lost_tracks_cleaned;
+    // The merged lists are swapped in, the previous lists become scratch vectors
+    std::vector<std::shared_ptr<Track>> &merged_tracks = _scratch.merged_tracks;
+    _merge_track_lists(updated_tracked_tracks, activated_tracks, merged_tracks);
+    _merge_track_lists(merged_tracks, refind_tracks, _tracked_tracks);
+
+    _merge_track_lists(_lost_tracks, lost_tracks, merged_tracks);
+    _lost_tracks.swap(merged_tracks);
+    _remove_from_list(_lost_tracks, _tracked_tracks);
+    _remove_from_list(_lost_tracks, removed_tracks);
+
+    std::vector<std::shared_ptr<Track>> &tracked_tracks_cleaned =
+            _scratch.tracked_tracks_cleaned;
+    std::vector<std::shared_ptr<Track>> &lost_tracks_cleaned =
+            _scratch.lost_tracks_cleaned;
     _remove_duplicate_tracks(tracked_tracks_cleaned, lost_tracks_cleaned,
                              _tracked_tracks, _lost_tracks);
-    _tracked_tracks = tracked_tracks_cleaned,
-    _lost_tracks = lost_tracks_cleaned;
+    _tracked_tracks.swap(tracked_tracks_cleaned);
+    _lost_tracks.swap(lost_tracks_cleaned);
+
+    if (_reid_cache_enabled && !replay_frame)
+        _update_feature_cache();
     ////////////////// Clean up the track lists //////////////////
 
 
     ////////////////// Update output tracks //////////////////
-    std::vector<std::shared_ptr<Track>> output_tracks;
+    output_tracks.clear();
     for (const std::shared_ptr<Track> &track: _tracked_tracks)
     {
         if (track->is_activated)
@@ -389,79 +719,509 @@ BoTSORT::track(const std::vector<Detection> &detections, const cv::Mat &frame)
             output_tracks.push_back(track);
         }
     }
+    PROFILE_COUNT(cleanup_timer, output_tracks.size());
+    PROFILE_END(cleanup_timer);
     ////////////////// Update output tracks //////////////////
 
-    return output_tracks;
+    tracks_removed_total.inc(_metrics_stream_id, removed_tracks.size());
+    _update_frame_metrics(detections.size(), output_tracks.size());
+    if (recording)
+        _write_record(detection_tracks, output_tracks);
+
+    // Release the track references held by the scratch lists
+    _scratch.clear();
 }
 
 
-FeatureVector BoTSORT::_extract_features(const cv::Mat &frame,
-                                         const cv::Rect_<float> &bbox_tlwh)
+void BoTSORT::FrameScratch::clear()
 {
-    cv::Mat patch = frame(bbox_tlwh);
-    return _reid_model->extract_features(patch);
+    for (std::vector<std::shared_ptr<Track>> *tracks_list:
+         {&detection_tracks, &detections_high_conf, &detections_low_conf,
+          &unconfirmed_tracks, &tracked_tracks, &tracks_pool,
+          &activated_tracks, &refind_tracks, &lost_tracks, &removed_tracks,
+          &unmatched_tracks, &unmatched_detections,
+          &unmatched_high_conf_detections, &updated_tracked_tracks,
+          &merged_tracks, &tracked_tracks_cleaned, &lost_tracks_cleaned})
+        tracks_list->clear();
 }
 
 
-std::vector<std::shared_ptr<Track>>
-BoTSORT::_merge_track_lists(std::vector<std::shared_ptr<Track>> &tracks_list_a,
-                            std::vector<std::shared_ptr<Track>> &tracks_list_b)
+size_t BoTSORT::_set_replay_features(
+        const std::vector<std::shared_ptr<Track>> &detection_tracks,
+        const bot_replay::FrameRecord &replay_frame)
 {
-    std::map<int, bool> exists;
-    std::vector<std::shared_ptr<Track>> merged_tracks_list;
+    size_t num_features = 0;
+    for (size_t i = 0; i < replay_frame.feature_indices.size() &&
+                       i < static_cast<size_t>(replay_frame.features.rows());
+         ++i)
+    {
+        const uint32_t index = replay_frame.feature_indices[i];
+        if (index >= detection_tracks.size() || !detection_tracks[index])
+            continue;
+        num_features += detection_tracks[index]->set_features(
+                FeatureVector(replay_frame.features.row(i)));
+    }
+    return num_features;
+}
 
-    for (const std::shared_ptr<Track> &track: tracks_list_a)
+
+void BoTSORT::_write_record(
+        const std::vector<std::shared_ptr<Track>> &detection_tracks,
+        const std::vector<std::shared_ptr<Track>> &output_tracks)
+{
+    _record.feature_indices.clear();
+    for (size_t i = 0; i < detection_tracks.size(); ++i)
+        if (detection_tracks[i] &&
+            _recorded_features.count(detection_tracks[i].get()))
+            _record.feature_indices.push_back(static_cast<uint32_t>(i));
+
+    _record.features.resize(
+            static_cast<Eigen::Index>(_record.feature_indices.size()),
+            FEATURE_DIM);
+    for (size_t i = 0; i < _record.feature_indices.size(); ++i)
+        _record.features.row(static_cast<Eigen::Index>(i)) =
+                _recorded_features.at(
+                        detection_tracks[_record.feature_indices[i]].get());
+
+    _record.tracks.clear();
+    for (const std::shared_ptr<Track> &track: output_tracks)
     {
-        exists[track->track_id] = true;
-        merged_tracks_list.push_back(track);
+        const std::vector<float> &tlwh = track->get_tlwh();
+        _record.tracks.push_back(
+                {track->track_id,
+                 cv::Rect_<float>(tlwh[0], tlwh[1], tlwh[2], tlwh[3])});
     }
 
-    for (const std::shared_ptr<Track> &track: tracks_list_b)
+    _recorder->write(_record);
+    _recorded_features.clear();
+}
+
+
+void BoTSORT::_update_frame_metrics(size_t num_detections,
+                                    size_t num_output_tracks)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (_frame_id > 1)
+    {
+        const double elapsed_s =
+                std::chrono::duration<double>(now - _last_frame_time).count();
+        if (elapsed_s > 0.0)
+            _frames_per_second = _frames_per_second > 0.0
+                                         ? 0.9 * _frames_per_second +
+                                                   0.1 / elapsed_s
+                                         : 1.0 / elapsed_s;
+        frames_per_second.set(_metrics_stream_id, _frames_per_second);
+    }
+    _last_frame_time = now;
+
+    frames_total.inc(_metrics_stream_id);
+    detections_total.inc(_metrics_stream_id, num_detections);
+    output_tracks_total.inc(_metrics_stream_id, num_output_tracks);
+    tracks.set(_metrics_stream_id, static_cast<double>(num_output_tracks),
+               ACTIVE_TRACKS);
+    tracks.set(_metrics_stream_id, static_cast<double>(_lost_tracks.size()),
+               LOST_TRACKS);
+}
+
+
+size_t BoTSORT::memory_footprint() const
+{
+    size_t footprint = sizeof(BoTSORT);
+    for (const std::shared_ptr<Track> &track: _tracked_tracks)
+        footprint += track->memory_footprint();
+    for (const std::shared_ptr<Track> &track: _lost_tracks)
+        footprint += track->memory_footprint();
+    return footprint + _track_pool->memory_footprint();
+}
+
+
+ReIDFeatures BoTSORT::_extract_features(
+        const cv::Mat &frame,
+        const std::vector<std::shared_ptr<Track>> &detections)
+{
+    return _reid_model->extract_features(frame, _get_rois(detections));
+}
+
+
+std::vector<std::shared_ptr<Track>> BoTSORT::_get_reid_detections(
+        const cv::Mat &frame,
+        const std::vector<std::shared_ptr<Track>> &detections_high_conf,
+        const std::vector<std::shared_ptr<Track>> &detections_low_conf,
+        const std::vector<std::shared_ptr<Track>> &tracks_pool,
+        const std::vector<std::shared_ptr<Track>> &unconfirmed_tracks)
+{
+    std::vector<std::shared_ptr<Track>> reid_detections;
+    if (_selective_reid)
+    {
+        reid_detections = _select_reid_detections(
+                detections_high_conf, tracks_pool, unconfirmed_tracks);
+    }
+    else
+    {
+        reid_detections = detections_high_conf;
+        reid_detections.insert(reid_detections.end(),
+                               detections_low_conf.begin(),
+                               detections_low_conf.end());
+    }
+
+    if (_reid_cache_enabled)
+    {
+        std::vector<std::shared_ptr<Track>> candidate_tracks = tracks_pool;
+        candidate_tracks.insert(candidate_tracks.end(),
+                                unconfirmed_tracks.begin(),
+                                unconfirmed_tracks.end());
+        reid_detections = _reuse_cached_features(frame, reid_detections,
+                                                 candidate_tracks);
+    }
+    return reid_detections;
+}
+
+
+std::vector<std::shared_ptr<Track>> BoTSORT::_reuse_cached_features(
+        const cv::Mat &frame,
+        const std::vector<std::shared_ptr<Track>> &detections,
+        const std::vector<std::shared_ptr<Track>> &tracks)
+{
+    // Cache entry of the track whose last embedded box overlaps the most with each detection
+    std::vector<const ReIDCacheEntry *> best_entries(detections.size(),
+                                                     nullptr);
+    std::unordered_map<const ReIDCacheEntry *, int> claims;
+    for (size_t j = 0; j < detections.size(); j++)
     {
-        if (exists.find(track->track_id) == exists.end())
+        float best_iou = _reid_cache_min_iou;
+        for (const std::shared_ptr<Track> &track: tracks)
         {
-            exists[track->track_id] = true;
-            merged_tracks_list.push_back(track);
+            auto entry = _reid_cache.find(track->track_id);
+            if (entry == _reid_cache.end() ||
+                _frame_id - entry->second.frame_id > _reid_cache_max_age)
+                continue;
+
+            const float overlap =
+                    iou(detections[j]->det_tlwh, entry->second.tlwh);
+            if (overlap >= best_iou)
+            {
+                best_iou = overlap;
+                best_entries[j] = &entry->second;
+            }
         }
+
+        if (best_entries[j])
+            claims[best_entries[j]]++;
+    }
+
+    // Reuse the cached feature if the crop did not change, a cache entry claimed by several detections is ambiguous
+    std::vector<std::shared_ptr<Track>> reid_detections;
+    for (size_t j = 0; j < detections.size(); j++)
+    {
+        const std::shared_ptr<Track> &detection = detections[j];
+        const ReIDCacheEntry *entry = best_entries[j];
+        cv::Mat thumbnail = _crop_thumbnail(frame, detection->det_tlwh);
+
+        _reid_stats.cache_lookups++;
+        if (entry && claims[entry] == 1 &&
+            _appearance_change(thumbnail, entry->thumbnail) <=
+                    _reid_cache_max_appearance_change)
+        {
+            _set_detection_feature(detection, entry->feat);
+            _reid_stats.cache_hits++;
+            continue;
+        }
+
+        ReIDCacheEntry &pending = _reid_cache_pending[detection.get()];
+        pending.tlwh = detection->det_tlwh;
+        pending.thumbnail = thumbnail;
+        pending.frame_id = _frame_id;
+        reid_detections.push_back(detection);
     }
 
-    return merged_tracks_list;
+    return reid_detections;
 }
 
 
-std::vector<std::shared_ptr<Track>> BoTSORT::_remove_from_list(
-        std::vector<std::shared_ptr<Track>> &tracks_list,
-        std::vector<std::shared_ptr<Track>> &tracks_to_remove)
+cv::Mat BoTSORT::_crop_thumbnail(const cv::Mat &frame,
+                                 const std::vector<float> &tlwh)
 {
-    std::map<int, bool> exists;
-    std::vector<std::shared_ptr<Track>> new_tracks_list;
+    const cv::Rect roi =
+            cv::Rect(cv::Rect_<float>(tlwh[0], tlwh[1], tlwh[2], tlwh[3])) &
+            cv::Rect(0, 0, frame.cols, frame.rows);
+    if (roi.empty())
+        return {};
+
+    cv::Mat thumbnail;
+    cv::resize(frame(roi), thumbnail, cv::Size(8, 16), 0, 0, cv::INTER_AREA);
+    return thumbnail;
+}
 
-    for (const std::shared_ptr<Track> &track: tracks_to_remove)
+
+float BoTSORT::_appearance_change(const cv::Mat &thumbnail_a,
+                                  const cv::Mat &thumbnail_b)
+{
+    if (thumbnail_a.empty() || thumbnail_b.empty() ||
+        thumbnail_a.size() != thumbnail_b.size() ||
+        thumbnail_a.type() != thumbnail_b.type())
+        return 1.0F;
+
+    // Mean absolute difference, normalized to [0, 1]
+    const double max_l1 = 255.0 * static_cast<double>(thumbnail_a.total() *
+                                                      thumbnail_a.channels());
+    return static_cast<float>(
+            cv::norm(thumbnail_a, thumbnail_b, cv::NORM_L1) / max_l1);
+}
+
+
+void BoTSORT::_update_feature_cache()
+{
+    // Cache the freshly extracted features of the detections associated with a track
+    for (const auto &[detection, track]: _associations)
     {
-        exists[track->track_id] = true;
+        auto pending = _reid_cache_pending.find(detection);
+        if (pending == _reid_cache_pending.end() || !detection->has_features())
+            continue;
+
+        pending->second.feat = detection->get_curr_feat();
+        _reid_cache[track->track_id] = std::move(pending->second);
     }
+    _reid_cache_pending.clear();
 
-    for (const std::shared_ptr<Track> &track: tracks_list)
+    // Evict the entries of removed tracks
+    std::unordered_set<int> alive_track_ids;
+    for (const std::shared_ptr<Track> &track: _tracked_tracks)
+        alive_track_ids.insert(track->track_id);
+    for (const std::shared_ptr<Track> &track: _lost_tracks)
+        alive_track_ids.insert(track->track_id);
+
+    for (auto entry = _reid_cache.begin(); entry != _reid_cache.end();)
     {
-        if (exists.find(track->track_id) == exists.end())
+        if (alive_track_ids.count(entry->first) == 0)
+            entry = _reid_cache.erase(entry);
+        else
+            ++entry;
+    }
+}
+
+
+std::vector<cv::Rect>
+BoTSORT::_get_rois(const std::vector<std::shared_ptr<Track>> &detections)
+{
+    std::vector<cv::Rect> rois;
+    rois.reserve(detections.size());
+    for (const std::shared_ptr<Track> &detection: detections)
+    {
+        rois.emplace_back(cv::Rect_<float>(
+                detection->det_tlwh[0], detection->det_tlwh[1],
+                detection->det_tlwh[2], detection->det_tlwh[3]));
+    }
+    return rois;
+}
+
+
+void BoTSORT::_set_features(
+        const std::vector<std::shared_ptr<Track>> &detections,
+        const ReIDFeatures &features)
+{
+    for (size_t i = 0; i < detections.size() && i < features.valid.size();
+         ++i)
+    {
+        if (features.valid[i])
+            _set_detection_feature(detections[i],
+                                   FeatureVector(features.features.row(i)));
+    }
+}
+
+
+void BoTSORT::_set_detection_feature(const std::shared_ptr<Track> &detection,
+                                     const FeatureVector &feature)
+{
+    if (detection->set_features(feature) && _recorder)
+        _recorded_features[detection.get()] = feature;
+}
+
+
+void BoTSORT::_record_association(const std::shared_ptr<Track> &detection,
+                                  const std::shared_ptr<Track> &track)
+{
+    if (!_late_detections.empty() || _reid_cache_enabled)
+    {
+        _associations[detection.get()] = track;
+    }
+}
+
+
+void BoTSORT::_apply_late_features(
+        const bot_replay::FrameRecord *replay_frame)
+{
+    if (_late_detections.empty())
+        return;
+
+    // The features are recorded with the frame they are applied in, and replayed at the same point
+    // The invalid rows are recorded as zeros, which set_features() rejects in the replay
+    ReIDFeatures features;
+    if (replay_frame)
+    {
+        features.features = replay_frame->late_features;
+        features.valid.assign(
+                static_cast<size_t>(replay_frame->late_features.rows()), true);
+    }
+    else
+    {
+        features = _reid_worker->wait(_late_ticket);
+    }
+    if (_recorder && !replay_frame)
+        _record.late_features = features.features;
+
+    // Update the tracks associated with last frame's detections, the features of unmatched detections are dropped
+    for (size_t i = 0;
+         i < _late_detections.size() && i < features.valid.size(); ++i)
+    {
+        auto target = _associations.find(_late_detections[i].get());
+        if (target == _associations.end() || !features.valid[i])
+            continue;
+
+        if (target->second->set_features(
+                    FeatureVector(features.features.row(i))))
+            target->second->feat_frame_id = _late_frame_id;
+    }
+
+    _late_detections.clear();
+}
+
+
+std::vector<std::shared_ptr<Track>> BoTSORT::_select_reid_detections(
+        const std::vector<std::shared_ptr<Track>> &detections_high_conf,
+        const std::vector<std::shared_ptr<Track>> &tracks_pool,
+        const std::vector<std::shared_ptr<Track>> &unconfirmed_tracks)
+{
+    std::vector<std::shared_ptr<Track>> candidate_tracks = tracks_pool;
+    candidate_tracks.insert(candidate_tracks.end(), unconfirmed_tracks.begin(),
+                            unconfirmed_tracks.end());
+
+    // IoU gating, a track is a candidate for a detection if their IoU distance is within proximity_thresh
+    CostMatrix iou_dists, iou_dists_mask;
+    std::tie(iou_dists, iou_dists_mask) = iou_distance(
+            candidate_tracks, detections_high_conf, _proximity_thresh);
+    const CostMatrix gated =
+            CostMatrix::Ones(iou_dists_mask.rows(), iou_dists_mask.cols()) -
+            iou_dists_mask;
+    const Eigen::VectorXf dets_per_track = gated.rowwise().sum();
+    const Eigen::RowVectorXf tracks_per_det = gated.colwise().sum();
+
+    std::vector<std::shared_ptr<Track>> reid_detections;
+    for (Eigen::Index j = 0; j < gated.cols(); j++)
+    {
+        const std::shared_ptr<Track> &detection = detections_high_conf[j];
+
+        if (tracks_per_det(j) == 0)
+        {
+            // Embed potential new tracks so that they start with a feature
+            if (detection->get_score() >= _new_track_thresh)
+            {
+                reid_detections.push_back(detection);
+                _reid_stats.new_track++;
+            }
+            continue;
+        }
+
+        Eigen::Index track_idx = 0;
+        bool ambiguous = tracks_per_det(j) > 1;
+        for (Eigen::Index i = 0; i < gated.rows() && !ambiguous; i++)
+        {
+            if (gated(i, j) > 0)
+            {
+                track_idx = i;
+                ambiguous = dets_per_track(i) > 1;
+            }
+        }
+
+        if (ambiguous)
+        {
+            reid_detections.push_back(detection);
+            _reid_stats.ambiguous++;
+            continue;
+        }
+
+        // Unambiguous IoU match, refresh the track feature only if it is missing or stale
+        const std::shared_ptr<Track> &track = candidate_tracks[track_idx];
+        if (!track->has_features() ||
+            _frame_id - track->feat_frame_id > _reid_max_feature_age)
+        {
+            reid_detections.push_back(detection);
+            _reid_stats.stale++;
+        }
+    }
+
+    return reid_detections;
+}
+
+
+void BoTSORT::_merge_track_lists(
+        const std::vector<std::shared_ptr<Track>> &tracks_list_a,
+        const std::vector<std::shared_ptr<Track>> &tracks_list_b,
+        std::vector<std::shared_ptr<Track>> &merged_tracks_list)
+{
+    // Sorted IDs of the merged tracks, a flat set that keeps its capacity across frames
+    std::vector<int> &exists = _scratch.track_ids;
+    exists.clear();
+    merged_tracks_list.clear();
+
+    for (const std::shared_ptr<Track> &track: tracks_list_a)
+    {
+        exists.push_back(track->track_id);
+        merged_tracks_list.push_back(track);
+    }
+    std::sort(exists.begin(), exists.end());
+
+    for (const std::shared_ptr<Track> &track: tracks_list_b)
+    {
+        auto it = std::lower_bound(exists.begin(), exists.end(),
+                                   track->track_id);
+        if (it == exists.end() || *it != track->track_id)
         {
-            new_tracks_list.push_back(track);
+            exists.insert(it, track->track_id);
+            merged_tracks_list.push_back(track);
         }
     }
+}
+
+
+void BoTSORT::_remove_from_list(
+        std::vector<std::shared_ptr<Track>> &tracks_list,
+        const std::vector<std::shared_ptr<Track>> &tracks_to_remove)
+{
+    std::vector<int> &exists = _scratch.track_ids;
+    exists.clear();
 
-    return new_tracks_list;
+    for (const std::shared_ptr<Track> &track: tracks_to_remove)
+    {
+        exists.push_back(track->track_id);
+    }
+    std::sort(exists.begin(), exists.end());
+
+    tracks_list.erase(
+            std::remove_if(tracks_list.begin(), tracks_list.end(),
+                           [&exists](const std::shared_ptr<Track> &track) {
+                               return std::binary_search(exists.begin(),
+                                                         exists.end(),
+                                                         track->track_id);
+                           }),
+            tracks_list.end());
 }
 
 
 void BoTSORT::_remove_duplicate_tracks(
         std::vector<std::shared_ptr<Track>> &result_tracks_a,
         std::vector<std::shared_ptr<Track>> &result_tracks_b,
-        std::vector<std::shared_ptr<Track>> &tracks_list_a,
-        std::vector<std::shared_ptr<Track>> &tracks_list_b)
+        const std::vector<std::shared_ptr<Track>> &tracks_list_a,
+        const std::vector<std::shared_ptr<Track>> &tracks_list_b)
 {
-    CostMatrix iou_dists = iou_distance(tracks_list_a, tracks_list_b);
-
-    std::unordered_set<size_t> dup_a, dup_b;
+    Eigen::Map<CostMatrix> iou_dists = _frame_arena.matrix(
+            static_cast<Eigen::Index>(tracks_list_a.size()),
+            static_cast<Eigen::Index>(tracks_list_b.size()));
+    iou_distance(tracks_list_a, tracks_list_b, iou_dists);
+
+    bool *dup_a = _frame_arena.allocate_array<bool>(tracks_list_a.size());
+    bool *dup_b = _frame_arena.allocate_array<bool>(tracks_list_b.size());
+    std::fill_n(dup_a, tracks_list_a.size(), false);
+    std::fill_n(dup_b, tracks_list_b.size(), false);
     for (Eigen::Index i = 0; i < iou_dists.rows(); i++)
     {
         for (Eigen::Index j = 0; j < iou_dists.cols(); j++)
@@ -476,30 +1236,32 @@ void BoTSORT::_remove_duplicate_tracks(
                 // We make an assumption that the longer trajectory is the correct one
                 if (time_a > time_b)
                 {
-                    dup_b.insert(
-                            j);// In list b, track with index j is a duplicate
+                    // In list b, track with index j is a duplicate
+                    dup_b[j] = true;
                 }
                 else
                 {
-                    dup_a.insert(
-                            i);// In list a, track with index i is a duplicate
+                    // In list a, track with index i is a duplicate
+                    dup_a[i] = true;
                 }
             }
         }
     }
 
     // Remove duplicates from the lists
+    result_tracks_a.clear();
     for (size_t i = 0; i < tracks_list_a.size(); i++)
     {
-        if (dup_a.find(i) == dup_a.end())
+        if (!dup_a[i])
         {
             result_tracks_a.push_back(tracks_list_a[i]);
         }
     }
 
+    result_tracks_b.clear();
     for (size_t i = 0; i < tracks_list_b.size(); i++)
     {
-        if (dup_b.find(i) == dup_b.end())
+        if (!dup_b[i])
         {
             result_tracks_b.push_back(tracks_list_b[i]);
         }
@@ -541,4 +1303,26 @@ void BoTSORT::_load_params_from_config(const std::string &config_path)
 
     _frame_rate = tracker_config.GetInteger(tracker_name, "frame_rate", 30);
     _lambda = tracker_config.GetFloat(tracker_name, "lambda", 0.985F);
+
+    _selective_reid =
+            tracker_config.GetBoolean(tracker_name, "selective_reid", false);
+    _reid_max_feature_age = tracker_config.GetInteger(
+            tracker_name, "reid_max_feature_age", 10);
+    _appearance_format = feature_format_from_string(
+            tracker_config.Get(tracker_name, "appearance_format", "fp32"));
+    _feat_history_size = static_cast<int>(
+            tracker_config.GetInteger(tracker_name, "feat_history_size", 0));
+    _feat_history_format = feature_format_from_string(
+            tracker_config.Get(tracker_name, "feat_history_format", "fp32"));
+    _reid_cache_enabled =
+            tracker_config.GetBoolean(tracker_name, "reid_cache", false);
+    _reid_cache_max_age = static_cast<unsigned int>(tracker_config.GetInteger(
+            tracker_name, "reid_cache_max_age", 5));
+    _reid_cache_min_iou =
+            tracker_config.GetFloat(tracker_name, "reid_cache_min_iou", 0.9F);
+    _reid_cache_max_appearance_change = tracker_config.GetFloat(
+            tracker_name, "reid_cache_max_appearance_change", 0.05F);
+    _reid_async = tracker_config.GetBoolean(tracker_name, "reid_async", false);
+    _reid_late_features =
+            tracker_config.GetBoolean(tracker_name, "reid_late_features", false);
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "CPU_InferenceEngine/OpenCV_DNN_InferenceEngine.h"
+
+#include <filesystem>
+#include <iostream>
+
+
+inference_backend::OpenCVDNNInferenceEngine::OpenCVDNNInferenceEngine(
+        const InferenceEngineParams &params)
+    : _params(params)
+{
+    _max_batch_size = std::max(1, _params.batch_size);
+
+    // Intra-op parallelism of the OpenCV DNN layers (global OpenCV thread pool)
+    if (_params.num_threads > 0)
+        cv::setNumThreads(_params.num_threads);
+}
+
+
+bool inference_backend::OpenCVDNNInferenceEngine::load_model(
+        const std::string &onnx_model_path)
+{
+    std::cout << "Loading ONNX model from path: " << onnx_model_path
+              << std::endl;
+    if (!std::filesystem::exists(onnx_model_path))
+    {
+        std::cout << "ONNX model not found at path: " << onnx_model_path
+                  << std::endl;
+        return false;
+    }
+
+    try
+    {
+        _net = cv::dnn::readNetFromONNX(onnx_model_path);
+    }
+    catch (const cv::Exception &e)
+    {
+        std::cout << "Failed to load ONNX model: " << e.what() << std::endl;
+        return false;
+    }
+
+    if (_net.empty())
+        return false;
+
+    _net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    _net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    _probe_batch_support();
+
+    std::cout << "OpenCV DNN engine loaded, max batch size: " << _max_batch_size
+              << ", threads: " << cv::getNumThreads() << std::endl;
+    return true;
+}
+
+
+inference_backend::ModelPredictions
+inference_backend::OpenCVDNNInferenceEngine::forward_batch(
+        const cv::Mat &input_blob)
+{
+    const int batch_size = input_blob.size[0];
+    if (_net.empty() || batch_size < 1 || batch_size > _max_batch_size)
+    {
+        std::cout << "Invalid batch size: " << batch_size << std::endl;
+        return ModelPredictions();
+    }
+
+    try
+    {
+        _net.setInput(input_blob, _params.input_layer_name);
+        _net.forward(_outputs, _params.output_layer_names);
+    }
+    catch (const cv::Exception &e)
+    {
+        std::cout << "OpenCV DNN inference failed: " << e.what() << std::endl;
+        return ModelPredictions();
+    }
+
+    ModelPredictions predictions;
+    predictions.reserve(_outputs.size());
+    for (const cv::Mat &output: _outputs)
+        predictions.emplace_back(output.ptr<float>(), output.total());
+    return predictions;
+}
+
+
+void inference_backend::OpenCVDNNInferenceEngine::_probe_batch_support()
+{
+    if (_max_batch_size == 1 || _params.input_dims.size() != 4)
+        return;
+
+    // Run a batch of two blank images
+    const int dims[] = {2, _params.input_dims[1], _params.input_dims[2],
+                        _params.input_dims[3]};
+    cv::Mat probe(4, dims, CV_32F, cv::Scalar(0));
+    try
+    {
+        _net.setInput(probe, _params.input_layer_name);
+        _net.forward(_outputs, _params.output_layer_names);
+        if (!_outputs.empty() && _outputs[0].size[0] == 2)
+            return;
+    }
+    catch (const cv::Exception &)
+    {
+        // Falls through to the static batch case
+    }
+
+    std::cout << "WARNING: The ONNX model has a static batch dimension, "
+                 "batched inference is disabled"
+              << std::endl;
+    _max_batch_size = 1;
+}
@@ -0,0 +1,52 @@
+#include "FeatureHistory.h"
+
+#include <algorithm>
+
+
+FeatureHistory::FeatureHistory(size_t capacity, FeatureFormat format)
+    : _capacity(capacity), _entry_bytes(feature_storage_bytes(format)),
+      _format(format)
+{
+}
+
+
+void FeatureHistory::push(const FeatureVector &feat)
+{
+    if (_capacity == 0)
+        return;
+
+    size_t slot;
+    if (_size < _capacity)
+    {
+        // Grow one entry at a time, the capacity is only reached by long-lived tracks
+        slot = _size++;
+        if (_data.capacity() < _size * _entry_bytes)
+            _data.reserve(std::min(_capacity, 2 * _size) * _entry_bytes);
+        _data.resize(_size * _entry_bytes);
+    }
+    else
+    {
+        slot = _oldest;
+        _oldest = (_oldest + 1) % _capacity;
+    }
+
+    encode_feature(feat, _format, _data.data() + slot * _entry_bytes);
+}
+
+
+FeatureVector FeatureHistory::at(size_t index) const
+{
+    const size_t slot = (_oldest + index) % _capacity;
+
+    FeatureVector feat;
+    decode_feature(_data.data() + slot * _entry_bytes, _format, feat);
+    return feat;
+}
+
+
+void FeatureHistory::clear()
+{
+    _size = 0;
+    _oldest = 0;
+    _data.clear();
+}
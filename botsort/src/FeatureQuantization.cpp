@@ -0,0 +1,355 @@
+#include "FeatureQuantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+namespace
+{
+static_assert(FEATURE_DIM % 32 == 0,
+              "The SIMD kernels process 32 elements per iteration");
+
+/**
+ * @brief Dot product of two INT8 vectors (values in [-127, 127])
+ */
+int32_t dot_int8(const int8_t *a, const int8_t *b)
+{
+#if defined(__AVX2__)
+    // u8 x s8 products: |a| times b with the sign of a, exact since a is never -128
+    __m256i acc = _mm256_setzero_si256();
+    for (uint32_t i = 0; i < FEATURE_DIM; i += 32)
+    {
+        const __m256i va =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        const __m256i vb =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        const __m256i abs_a = _mm256_sign_epi8(va, va);
+        const __m256i signed_b = _mm256_sign_epi8(vb, va);
+#if defined(__AVXVNNI__)
+        acc = _mm256_dpbusd_avx_epi32(acc, abs_a, signed_b);
+#elif defined(__AVX512VNNI__) && defined(__AVX512VL__)
+        acc = _mm256_dpbusd_epi32(acc, abs_a, signed_b);
+#else
+        // Pairwise sums of 127 * 127 products do not saturate the 16-bit lanes
+        const __m256i pairs = _mm256_maddubs_epi16(abs_a, signed_b);
+        acc = _mm256_add_epi32(acc,
+                               _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+#endif
+    }
+
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                                _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (uint32_t i = 0; i < FEATURE_DIM; i += 16)
+    {
+        const int8x16_t va = vld1q_s8(a + i);
+        const int8x16_t vb = vld1q_s8(b + i);
+#if defined(__ARM_FEATURE_DOTPROD)
+        acc = vdotq_s32(acc, va, vb);
+#else
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_high_s8(va, vb));
+#endif
+    }
+    return vaddvq_s32(acc);
+#else
+    int32_t sum = 0;
+    for (uint32_t i = 0; i < FEATURE_DIM; ++i)
+        sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    return sum;
+#endif
+}
+
+
+/**
+ * @brief Dot product of two FP16 vectors, accumulated in FP32
+ */
+float dot_fp16(const uint16_t *a, const uint16_t *b)
+{
+#if defined(__F16C__) && defined(__FMA__) && defined(__AVX__)
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (uint32_t i = 0; i < FEATURE_DIM; i += 16)
+    {
+        const __m256 a0 = _mm256_cvtph_ps(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+        const __m256 b0 = _mm256_cvtph_ps(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        const __m256 a1 = _mm256_cvtph_ps(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 8)));
+        const __m256 b1 = _mm256_cvtph_ps(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 8)));
+        acc0 = _mm256_fmadd_ps(a0, b0, acc0);
+        acc1 = _mm256_fmadd_ps(a1, b1, acc1);
+    }
+
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc),
+                            _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc0 = vdupq_n_f32(0.0F), acc1 = vdupq_n_f32(0.0F);
+    for (uint32_t i = 0; i < FEATURE_DIM; i += 8)
+    {
+        const float16x8_t va = vreinterpretq_f16_u16(vld1q_u16(a + i));
+        const float16x8_t vb = vreinterpretq_f16_u16(vld1q_u16(b + i));
+        acc0 = vfmaq_f32(acc0, vcvt_f32_f16(vget_low_f16(va)),
+                         vcvt_f32_f16(vget_low_f16(vb)));
+        acc1 = vfmaq_f32(acc1, vcvt_high_f32_f16(va), vcvt_high_f32_f16(vb));
+    }
+    return vaddvq_f32(vaddq_f32(acc0, acc1));
+#else
+    float sum = 0.0F;
+    for (uint32_t i = 0; i < FEATURE_DIM; ++i)
+        sum += half_to_float(a[i]) * half_to_float(b[i]);
+    return sum;
+#endif
+}
+}// namespace
+
+
+FeatureFormat feature_format_from_string(const std::string &name)
+{
+    if (name == "fp32")
+        return FeatureFormat::Float32;
+    if (name == "fp16")
+        return FeatureFormat::Float16;
+    if (name == "int8")
+        return FeatureFormat::Int8;
+
+    std::cout << "Invalid feature format " << name << " passed. "
+              << "Only 'fp32', 'fp16' and 'int8' are supported." << std::endl;
+    exit(1);
+}
+
+
+size_t feature_storage_bytes(FeatureFormat format)
+{
+    switch (format)
+    {
+        case FeatureFormat::Float16:
+            return FEATURE_DIM * sizeof(uint16_t);
+        case FeatureFormat::Int8:
+            return sizeof(float) + FEATURE_DIM * sizeof(int8_t);
+        case FeatureFormat::Float32:
+        default:
+            return FEATURE_DIM * sizeof(float);
+    }
+}
+
+
+void encode_feature(const FeatureVector &feat, FeatureFormat format,
+                    uint8_t *dst)
+{
+    switch (format)
+    {
+        case FeatureFormat::Float16: {
+            uint16_t half[FEATURE_DIM];
+            for (uint32_t i = 0; i < FEATURE_DIM; ++i)
+                half[i] = float_to_half(feat(i));
+            std::memcpy(dst, half, sizeof(half));
+            break;
+        }
+        case FeatureFormat::Int8: {
+            const float max_abs = feat.cwiseAbs().maxCoeff();
+            const float scale = max_abs > 0.0F ? max_abs / 127.0F : 1.0F;
+            std::memcpy(dst, &scale, sizeof(float));
+
+            int8_t *quantized = reinterpret_cast<int8_t *>(dst + sizeof(float));
+            for (uint32_t i = 0; i < FEATURE_DIM; ++i)
+            {
+                const float q = std::nearbyint(feat(i) / scale);
+                quantized[i] = static_cast<int8_t>(
+                        std::max(-127.0F, std::min(127.0F, q)));
+            }
+            break;
+        }
+        case FeatureFormat::Float32:
+        default:
+            std::memcpy(dst, feat.data(), FEATURE_DIM * sizeof(float));
+            break;
+    }
+}
+
+
+void decode_feature(const uint8_t *src, FeatureFormat format,
+                    FeatureVector &feat)
+{
+    switch (format)
+    {
+        case FeatureFormat::Float16: {
+            uint16_t half[FEATURE_DIM];
+            std::memcpy(half, src, sizeof(half));
+            for (uint32_t i = 0; i < FEATURE_DIM; ++i)
+                feat(i) = half_to_float(half[i]);
+            break;
+        }
+        case FeatureFormat::Int8: {
+            float scale;
+            std::memcpy(&scale, src, sizeof(float));
+
+            const int8_t *quantized =
+                    reinterpret_cast<const int8_t *>(src + sizeof(float));
+            for (uint32_t i = 0; i < FEATURE_DIM; ++i)
+                feat(i) = scale * static_cast<float>(quantized[i]);
+            break;
+        }
+        case FeatureFormat::Float32:
+        default:
+            std::memcpy(feat.data(), src, FEATURE_DIM * sizeof(float));
+            break;
+    }
+}
+
+
+float encoded_dot(const uint8_t *a, const uint8_t *b, FeatureFormat format)
+{
+    switch (format)
+    {
+        case FeatureFormat::Float16: {
+            return dot_fp16(reinterpret_cast<const uint16_t *>(a),
+                            reinterpret_cast<const uint16_t *>(b));
+        }
+        case FeatureFormat::Int8: {
+            float scale_a, scale_b;
+            std::memcpy(&scale_a, a, sizeof(float));
+            std::memcpy(&scale_b, b, sizeof(float));
+            return scale_a * scale_b *
+                   static_cast<float>(dot_int8(
+                           reinterpret_cast<const int8_t *>(a + sizeof(float)),
+                           reinterpret_cast<const int8_t *>(b +
+                                                            sizeof(float))));
+        }
+        case FeatureFormat::Float32:
+        default: {
+            Eigen::Map<const FeatureVector> feat_a(
+                    reinterpret_cast<const float *>(a));
+            Eigen::Map<const FeatureVector> feat_b(
+                    reinterpret_cast<const float *>(b));
+            return feat_a.dot(feat_b);
+        }
+    }
+}
+
+
+std::string feature_kernels_description()
+{
+#if defined(__F16C__) && defined(__FMA__) && defined(__AVX__)
+    std::string fp16 = "F16C+FMA";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    std::string fp16 = "NEON";
+#else
+    std::string fp16 = "scalar";
+#endif
+
+#if defined(__AVX2__) && defined(__AVXVNNI__)
+    std::string int8 = "AVX-VNNI";
+#elif defined(__AVX2__) && defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    std::string int8 = "AVX512-VNNI";
+#elif defined(__AVX2__)
+    std::string int8 = "AVX2";
+#elif defined(__ARM_NEON) && defined(__aarch64__) &&                           \
+        defined(__ARM_FEATURE_DOTPROD)
+    std::string int8 = "NEON dot product";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    std::string int8 = "NEON";
+#else
+    std::string int8 = "scalar";
+#endif
+
+    return "fp16: " + fp16 + ", int8: " + int8;
+}
+
+
+uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000U;
+    const uint32_t abs_bits = bits & 0x7FFFFFFFU;
+
+    // NaN and infinity
+    if (abs_bits >= 0x7F800000U)
+        return static_cast<uint16_t>(sign | 0x7C00U |
+                                     (abs_bits > 0x7F800000U ? 0x200U : 0U));
+
+    // Overflow, rounds to infinity
+    if (abs_bits >= 0x477FF000U)
+        return static_cast<uint16_t>(sign | 0x7C00U);
+
+    // Subnormal half (or zero)
+    if (abs_bits < 0x38800000U)
+    {
+        if (abs_bits < 0x33000000U)
+            return static_cast<uint16_t>(sign);
+
+        const uint32_t exponent = abs_bits >> 23;
+        const uint32_t mantissa = (abs_bits & 0x007FFFFFU) | 0x00800000U;
+        const uint32_t shift = 126U - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1U << shift) - 1U);
+        const uint32_t halfway = 1U << (shift - 1U);
+        if (remainder > halfway || (remainder == halfway && (half & 1U)))
+            ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Normal half, round the 13 dropped mantissa bits to nearest even
+    uint32_t half = ((abs_bits - 0x38000000U) >> 13);
+    const uint32_t remainder = abs_bits & 0x1FFFU;
+    if (remainder > 0x1000U || (remainder == 0x1000U && (half & 1U)))
+        ++half;
+    return static_cast<uint16_t>(sign | half);
+}
+
+
+float half_to_float(uint16_t value)
+{
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000U) << 16;
+    uint32_t exponent = (value >> 10) & 0x1FU;
+    uint32_t mantissa = value & 0x3FFU;
+
+    uint32_t bits;
+    if (exponent == 0x1FU)
+    {
+        bits = sign | 0x7F800000U | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent + 112U) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        // Subnormal half, normalize the mantissa
+        exponent = 113U;
+        while ((mantissa & 0x400U) == 0)
+        {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FFU) << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
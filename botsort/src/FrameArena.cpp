@@ -0,0 +1,57 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+
+FrameArena::FrameArena(size_t initial_capacity)
+{
+    if (initial_capacity > 0)
+        _add_block(initial_capacity);
+}
+
+
+void *FrameArena::allocate(size_t bytes)
+{
+    // Sizes are rounded so that every allocation stays aligned, whatever the block
+    bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    // Geometric growth, a frame that overflows the arena allocates O(log) blocks
+    if (_blocks.empty() || _offset + bytes > _blocks.back().size)
+        _add_block(std::max({bytes, MIN_BLOCK_SIZE, capacity()}));
+
+    void *ptr = _blocks.back().data.get() + _offset;
+    _offset += bytes;
+    _used += bytes;
+    _high_water_mark = std::max(_high_water_mark, _used);
+    return ptr;
+}
+
+
+void FrameArena::reset()
+{
+    if (_blocks.size() > 1)
+    {
+        _blocks.clear();
+        _add_block(_high_water_mark);
+    }
+    _offset = 0;
+    _used = 0;
+}
+
+
+size_t FrameArena::capacity() const
+{
+    size_t capacity = 0;
+    for (const Block &block: _blocks)
+        capacity += block.size;
+    return capacity;
+}
+
+
+void FrameArena::_add_block(size_t size)
+{
+    _blocks.push_back(
+            {std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+    _offset = 0;
+    _block_allocations++;
+}
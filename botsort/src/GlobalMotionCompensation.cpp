@@ -4,6 +4,53 @@
 #include <opencv2/videostab/motion_core.hpp>
 
 #include "INIReader.h"
+#include "metrics.h"
+#include "profiler.h"
+
+
+namespace
+{
+bot_metrics::Counter gmc_estimations_total(
+        "botsort_gmc_estimations_total",
+        "Camera motion estimations (RANSAC), accepted or rejected", "result",
+        {"accepted", "rejected"});
+bot_metrics::Gauge
+        gmc_inlier_ratio("botsort_gmc_inlier_ratio",
+                         "Inlier ratio of the last camera motion estimation");
+
+/**
+ * @brief Update the GMC metrics of the stream of the calling thread with a RANSAC estimation
+ */
+void record_motion_metrics(const RansacResult &motion, bool accepted)
+{
+    const bot_profiler::StreamId stream_id = bot_profiler::get_stream_id();
+    gmc_estimations_total.inc(stream_id, 1, accepted ? 0 : 1);
+    gmc_inlier_ratio.set(stream_id, motion.inlier_ratio());
+}
+
+
+/**
+ * @brief Load the RANSAC motion estimator parameters of a GMC method from its section of the config
+ */
+RansacParams load_ransac_params(const INIReader &gmc_config,
+                                const std::string &section,
+                                float default_reproj_thresh)
+{
+    RansacParams params;
+    params.model = RansacMotionEstimator::motion_model_from_string(
+            gmc_config.Get(section, "motion_model", "similarity"));
+    params.reproj_thresh = gmc_config.GetFloat(
+            section, "ransac_reproj_thresh", default_reproj_thresh);
+    params.confidence = gmc_config.GetFloat(section, "ransac_conf", 0.99F);
+    params.max_iters = static_cast<int>(
+            gmc_config.GetInteger(section, "ransac_max_iters", 500));
+    params.lo_iters = static_cast<int>(
+            gmc_config.GetInteger(section, "ransac_lo_iters", 3));
+    params.parallel_min_points = static_cast<int>(
+            gmc_config.GetInteger(section, "ransac_parallel_min_points", 500));
+    return params;
+}
+}// namespace
 
 std::map<std::string, GMC_Method> GlobalMotionCompensation::GMC_method_map = {
         {"orb", GMC_Method::ORB},
@@ -58,6 +105,61 @@ GlobalMotionCompensation::apply(const cv::Mat &frame,
 }
 
 
+// Detection mask
+const cv::Mat &
+GMC_DetectionMask::update(const cv::Size &frame_size,
+                          const std::vector<Detection> &detections,
+                          float downscale)
+{
+    if (_mask.size() != frame_size)
+    {
+        _reset(frame_size);
+    }
+    else
+    {
+        // Restore the foreground regions masked out in the previous frame
+        for (const cv::Rect &rect: _masked_rects)
+        {
+            _mask(rect).setTo(255);
+        }
+    }
+    _masked_rects.clear();
+
+    const float scale = downscale > 1.0F ? 1.0F / downscale : 1.0F;
+    for (const Detection &det: detections)
+    {
+        cv::Rect tlwh_downscaled(
+                static_cast<int>(det.bbox_tlwh.x * scale),
+                static_cast<int>(det.bbox_tlwh.y * scale),
+                static_cast<int>(det.bbox_tlwh.width * scale),
+                static_cast<int>(det.bbox_tlwh.height * scale));
+
+        // Clip to the valid region, outside of it the mask is always 0
+        tlwh_downscaled &= _valid_roi;
+        if (tlwh_downscaled.empty())
+            continue;
+
+        _mask(tlwh_downscaled).setTo(0);
+        _masked_rects.push_back(tlwh_downscaled);
+    }
+
+    return _mask;
+}
+
+
+void GMC_DetectionMask::_reset(const cv::Size &frame_size)
+{
+    _mask.create(frame_size, CV_8UC1);
+    _mask.setTo(0);
+
+    _valid_roi = cv::Rect(static_cast<int>(frame_size.width * 0.02),
+                          static_cast<int>(frame_size.height * 0.02),
+                          static_cast<int>(frame_size.width * 0.96),
+                          static_cast<int>(frame_size.height * 0.96));
+    _mask(_valid_roi).setTo(255);
+}
+
+
 // ORB
 ORB_GMC::ORB_GMC(const std::string &config_path)
 {
@@ -80,9 +182,8 @@ void ORB_GMC::_load_params_from_config(const std::string &config_path)
 
     _downscale = gmc_config.GetFloat(_algo_name, "downscale", 2.0);
     _inlier_ratio = gmc_config.GetFloat(_algo_name, "inlier_ratio", 0.5);
-    _ransac_conf = gmc_config.GetFloat(_algo_name, "ransac_conf", 0.99);
-    _ransac_max_iters =
-            gmc_config.GetInteger(_algo_name, "ransac_max_iters", 500);
+    _ransac = RansacMotionEstimator(
+            load_ransac_params(gmc_config, _algo_name, 3.0F));
 }
 
 
@@ -107,25 +208,9 @@ HomographyMatrix ORB_GMC::apply(const cv::Mat &frame_raw,
         cv::resize(frame, frame, cv::Size(width, height));
     }
 
-    // Create a mask, corner regions are ignored
-    cv::Mat mask = cv::Mat::zeros(frame.size(), frame.type());
-    cv::Rect roi(
-            static_cast<int>(width * 0.02), static_cast<int>(height * 0.02),
-            static_cast<int>(width * 0.96), static_cast<int>(height * 0.96));
-    mask(roi) = 255;
-
-
-    // Set all the foreground (area with detections) to 0
+    // Create a mask, corner regions and the foreground (area with detections) are ignored
     // This is to prevent the algorithm from detecting keypoints in the foreground so CMC can work better
-    for (const auto &det: detections)
-    {
-        cv::Rect tlwh_downscaled(
-                static_cast<int>(det.bbox_tlwh.x / _downscale),
-                static_cast<int>(det.bbox_tlwh.y / _downscale),
-                static_cast<int>(det.bbox_tlwh.width / _downscale),
-                static_cast<int>(det.bbox_tlwh.height / _downscale));
-        mask(tlwh_downscaled) = 0;
-    }
+    const cv::Mat &mask = _mask.update(frame.size(), detections, _downscale);
 
 
     // Detect keypoints in background
@@ -203,6 +288,7 @@ HomographyMatrix ORB_GMC::apply(const cv::Mat &frame_raw,
     // Get good matches, i.e. points that are within 2.5 standard deviations of the mean spatial distance
     std::vector<cv::DMatch> good_matches;
     std::vector<cv::Point2f> prev_points, curr_points;
+    std::vector<float> match_distances;
     for (size_t i = 0; i < matches.size(); ++i)
     {
         cv::Point2f mean_normalized_sd(
@@ -213,6 +299,7 @@ HomographyMatrix ORB_GMC::apply(const cv::Mat &frame_raw,
         {
             prev_points.push_back(_prev_keypoints[matches[i].queryIdx].pt);
             curr_points.push_back(keypoints[matches[i].trainIdx].pt);
+            match_distances.push_back(matches[i].distance);
         }
     }
 
@@ -220,15 +307,14 @@ HomographyMatrix ORB_GMC::apply(const cv::Mat &frame_raw,
     // Find the rigid transformation between the previous and current frame on the basis of the good matches
     if (prev_points.size() > 4)
     {
-        cv::Mat inliers;
-        cv::Mat homography =
-                cv::findHomography(prev_points, curr_points, cv::RANSAC, 3,
-                                   inliers, _ransac_max_iters, _ransac_conf);
-
-        double inlier_ratio = cv::countNonZero(inliers) / (double) inliers.rows;
-        if (inlier_ratio > _inlier_ratio)
+        RansacResult motion =
+                _ransac.estimate(prev_points, curr_points, match_distances);
+        const bool accepted =
+                motion.success && motion.inlier_ratio() > _inlier_ratio;
+        record_motion_metrics(motion, accepted);
+        if (accepted)
         {
-            cv2eigen(homography, H);
+            H = motion.H;
             if (_downscale > 1.0)
             {
                 H(0, 2) *= _downscale;
@@ -286,6 +372,7 @@ ECC_GMC::ECC_GMC(const std::string &config_path)
     _termination_criteria =
             cv::TermCriteria(cv::TermCriteria::EPS | cv::TermCriteria::COUNT,
                              _max_iterations, _termination_eps);
+    _warp = cv::Mat::eye(2, 3, CV_32F);
 }
 
 
@@ -301,6 +388,11 @@ void ECC_GMC::_load_params_from_config(const std::string &config_path)
     _downscale = gmc_config.GetFloat(_algo_name, "downscale", 5.0F);
     _max_iterations = gmc_config.GetInteger(_algo_name, "max_iterations", 100);
     _termination_eps = gmc_config.GetFloat(_algo_name, "termination_eps", 1e-6);
+    _pyramid_levels = static_cast<int>(std::max(
+            1L, gmc_config.GetInteger(_algo_name, "pyramid_levels", 3)));
+    _use_prev_warp = gmc_config.GetBoolean(_algo_name, "use_prev_warp", true);
+    _early_exit_correlation =
+            gmc_config.GetFloat(_algo_name, "early_exit_correlation", 0.995F);
 }
 
 
@@ -308,54 +400,96 @@ HomographyMatrix ECC_GMC::apply(const cv::Mat &frame_raw,
                                 const std::vector<Detection> &detections)
 {
     // Initialization
-    int height = frame_raw.rows;
-    int width = frame_raw.cols;
-
     HomographyMatrix H;
     H.setIdentity();
 
-    cv::Mat frame;
-    cv::cvtColor(frame_raw, frame, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(frame_raw, _frame_gray, cv::COLOR_BGR2GRAY);
 
 
     // Downscale
+    const cv::Mat *frame = &_frame_gray;
     if (_downscale > 1.0F)
     {
-        width /= _downscale, height /= _downscale;
-        cv::GaussianBlur(frame, frame, _gaussian_blur_kernel_size, 1.5);
-        cv::resize(frame, frame, cv::Size(width, height));
+        cv::Size size(static_cast<int>(frame_raw.cols / _downscale),
+                      static_cast<int>(frame_raw.rows / _downscale));
+        cv::GaussianBlur(_frame_gray, _frame_gray, _gaussian_blur_kernel_size,
+                         1.5);
+        cv::resize(_frame_gray, _frame_small, size);
+        frame = &_frame_small;
     }
 
-    if (!_first_frame_initialized)
+
+    // Image pyramid, level 0 is the (downscaled) frame, the coarsest level is kept above 32 pixels
+    int num_levels = _pyramid_levels;
+    while (num_levels > 1 &&
+           (std::min(frame->cols, frame->rows) >> (num_levels - 1)) < 32)
+        --num_levels;
+    cv::buildPyramid(*frame, _curr_pyramid, num_levels - 1);
+
+    if (!_first_frame_initialized ||
+        _prev_pyramid.size() != _curr_pyramid.size() ||
+        _prev_pyramid[0].size() != _curr_pyramid[0].size())
     {
         /**
          *  If this is the first frame, there is nothing to match
-         *  Save the keypoints and descriptors, return identity matrix
+         *  Save the pyramid, return identity matrix
          */
         _first_frame_initialized = true;
-        _prev_frame = frame.clone();
+        std::swap(_prev_pyramid, _curr_pyramid);
         return H;
     }
 
+
+    // Coarse-to-fine ECC, initialized with the previous frame's warp (camera motion is smooth)
+    if (!_use_prev_warp)
+        _warp = cv::Mat::eye(2, 3, CV_32F);
+
     try
     {
-        cv::Mat H_cvMat;
+        for (int level = num_levels - 1; level >= 0; --level)
+        {
+            const float level_scale = static_cast<float>(1 << level);
+            _warp.copyTo(_level_warp);
+            _level_warp.at<float>(0, 2) /= level_scale;
+            _level_warp.at<float>(1, 2) /= level_scale;
+
 #if CV_MAJOR_VERSION == 3
-        cv::findTransformECC(_prev_frame, frame, H_cvMat, cv::MOTION_EUCLIDEAN,
-                             _termination_criteria);
+            double correlation = cv::findTransformECC(
+                    _prev_pyramid[level], _curr_pyramid[level], _level_warp,
+                    cv::MOTION_EUCLIDEAN, _termination_criteria);
 #elif CV_MAJOR_VERSION == 4
-        cv::findTransformECC(_prev_frame, frame, H_cvMat, cv::MOTION_EUCLIDEAN,
-                             _termination_criteria, cv::noArray(), 1);
+            double correlation = cv::findTransformECC(
+                    _prev_pyramid[level], _curr_pyramid[level], _level_warp,
+                    cv::MOTION_EUCLIDEAN, _termination_criteria,
+                    cv::noArray(), 1);
 #endif
-        cv2eigen(H_cvMat, H);
-        _prev_frame = frame.clone();
+
+            _level_warp.at<float>(0, 2) *= level_scale;
+            _level_warp.at<float>(1, 2) *= level_scale;
+            _level_warp.copyTo(_warp);
+
+            // The coarse levels are already well aligned, skip the (expensive) finer levels
+            if (correlation >= _early_exit_correlation)
+                break;
+        }
+
+        for (int i = 0; i < 2; ++i)
+            for (int j = 0; j < 3; ++j)
+                H(i, j) = _warp.at<float>(i, j);
+
+        if (_downscale > 1.0F)
+        {
+            H(0, 2) *= _downscale;
+            H(1, 2) *= _downscale;
+        }
     }
     catch (const cv::Exception &e)
     {
         std::cout << "Warning: Could not estimate affine matrix" << std::endl;
+        _warp = cv::Mat::eye(2, 3, CV_32F);
     }
 
-
+    std::swap(_prev_pyramid, _curr_pyramid);
     return H;
 }
 
@@ -381,17 +515,30 @@ void SparseOptFlow_GMC::_load_params_from_config(const std::string &config_path)
 
     _maxCorners = gmc_config.GetInteger(_algo_name, "max_corners", 1000);
     _blockSize = gmc_config.GetInteger(_algo_name, "block_size", 3);
-    _ransac_max_iters =
-            gmc_config.GetInteger(_algo_name, "ransac_max_iters", 500);
 
     _qualityLevel = gmc_config.GetReal(_algo_name, "quality_level", 0.01);
     _k = gmc_config.GetReal(_algo_name, "k", 0.04);
     _minDistance = gmc_config.GetReal(_algo_name, "min_distance", 1.0);
+    _detections_masking =
+            gmc_config.GetBoolean(_algo_name, "detections_masking", true);
+
+    _grid_rows = static_cast<int>(
+            std::max(1L, gmc_config.GetInteger(_algo_name, "grid_rows", 1)));
+    _grid_cols = static_cast<int>(
+            std::max(1L, gmc_config.GetInteger(_algo_name, "grid_cols", 1)));
+    _corners_per_cell =
+            gmc_config.GetInteger(_algo_name, "corners_per_cell", 50);
+    _use_fast_detector =
+            gmc_config.Get(_algo_name, "feature_detector", "gftt") == "fast";
+    _fast_threshold = gmc_config.GetInteger(_algo_name, "fast_threshold", 20);
+    _parallel_detection =
+            gmc_config.GetBoolean(_algo_name, "parallel_detection", true);
 
 
     _downscale = gmc_config.GetFloat(_algo_name, "downscale", 2.0F);
     _inlier_ratio = gmc_config.GetFloat(_algo_name, "inlier_ratio", 0.5);
-    _ransac_conf = gmc_config.GetFloat(_algo_name, "ransac_conf", 0.99);
+    _ransac = RansacMotionEstimator(
+            load_ransac_params(gmc_config, _algo_name, 3.0F));
 }
 
 
@@ -418,11 +565,12 @@ SparseOptFlow_GMC::apply(const cv::Mat &frame_raw,
     }
 
 
-    // Detect keypoints
+    // Detect keypoints, optionally ignoring the foreground (area with detections)
+    cv::Mat mask = _detections_masking
+                           ? _mask.update(frame.size(), detections, _downscale)
+                           : cv::Mat();
     std::vector<cv::Point2f> keypoints;
-    cv::goodFeaturesToTrack(frame, keypoints, _maxCorners, _qualityLevel,
-                            _minDistance, cv::noArray(), _blockSize,
-                            _useHarrisDetector, _k);
+    _detect_keypoints(frame, mask, keypoints);
 
     if (!_first_frame_initialized || _prev_keypoints.size() == 0)
     {
@@ -456,12 +604,14 @@ SparseOptFlow_GMC::apply(const cv::Mat &frame_raw,
 
     // Keep good matches
     std::vector<cv::Point2f> prev_points, curr_points;
+    std::vector<float> flow_errors;
     for (size_t i = 0; i < matched_keypoints.size(); i++)
     {
         if (status[i])
         {
             prev_points.push_back(_prev_keypoints[i]);
             curr_points.push_back(matched_keypoints[i]);
+            flow_errors.push_back(err[i]);
         }
     }
 
@@ -469,15 +619,14 @@ SparseOptFlow_GMC::apply(const cv::Mat &frame_raw,
     // Estimate affine matrix
     if (prev_points.size() > 4)
     {
-        cv::Mat inliers;
-        cv::Mat homography =
-                cv::findHomography(prev_points, curr_points, cv::RANSAC, 3,
-                                   inliers, _ransac_max_iters, _ransac_conf);
-
-        double inlier_ratio = cv::countNonZero(inliers) / (double) inliers.rows;
-        if (inlier_ratio > _inlier_ratio)
+        RansacResult motion =
+                _ransac.estimate(prev_points, curr_points, flow_errors);
+        const bool accepted =
+                motion.success && motion.inlier_ratio() > _inlier_ratio;
+        record_motion_metrics(motion, accepted);
+        if (accepted)
         {
-            cv2eigen(homography, H);
+            H = motion.H;
             if (_downscale > 1.0)
             {
                 H(0, 2) *= _downscale;
@@ -497,6 +646,91 @@ SparseOptFlow_GMC::apply(const cv::Mat &frame_raw,
 }
 
 
+void SparseOptFlow_GMC::_detect_keypoints(const cv::Mat &frame,
+                                          const cv::Mat &mask,
+                                          std::vector<cv::Point2f> &keypoints)
+{
+    keypoints.clear();
+    const int num_cells = _grid_rows * _grid_cols;
+    if (num_cells == 1)
+    {
+        cv::goodFeaturesToTrack(frame, keypoints, _maxCorners, _qualityLevel,
+                                _minDistance, mask, _blockSize,
+                                _useHarrisDetector, _k);
+        return;
+    }
+
+    // Detect keypoints independently in each cell of the grid, the quality level
+    // is relative to the strongest corner in the cell, so low texture regions still get keypoints
+    _cell_keypoints.resize(num_cells);
+    auto detect_in_cells = [&](const cv::Range &range) {
+        for (int cell = range.start; cell < range.end; ++cell)
+        {
+            const int row = cell / _grid_cols, col = cell % _grid_cols;
+            const int x0 = col * frame.cols / _grid_cols;
+            const int x1 = (col + 1) * frame.cols / _grid_cols;
+            const int y0 = row * frame.rows / _grid_rows;
+            const int y1 = (row + 1) * frame.rows / _grid_rows;
+            const cv::Rect cell_rect(x0, y0, x1 - x0, y1 - y0);
+            const cv::Point2f offset(static_cast<float>(x0),
+                                     static_cast<float>(y0));
+
+            std::vector<cv::Point2f> &cell_keypoints = _cell_keypoints[cell];
+            cell_keypoints.clear();
+
+            cv::Mat cell_mask = mask.empty() ? cv::Mat() : mask(cell_rect);
+            if (!cell_mask.empty() && cv::countNonZero(cell_mask) == 0)
+                continue;
+
+            if (_use_fast_detector)
+            {
+                std::vector<cv::KeyPoint> fast_keypoints;
+                cv::FAST(frame(cell_rect), fast_keypoints, _fast_threshold,
+                         true);
+
+                // Drop the masked keypoints before keeping the strongest ones
+                if (!cell_mask.empty())
+                {
+                    size_t num_kept = 0;
+                    for (const cv::KeyPoint &kp: fast_keypoints)
+                    {
+                        if (cell_mask.at<uchar>(static_cast<int>(kp.pt.y),
+                                                static_cast<int>(kp.pt.x)))
+                            fast_keypoints[num_kept++] = kp;
+                    }
+                    fast_keypoints.resize(num_kept);
+                }
+                cv::KeyPointsFilter::retainBest(fast_keypoints,
+                                                _corners_per_cell);
+
+                cell_keypoints.reserve(fast_keypoints.size());
+                for (const cv::KeyPoint &kp: fast_keypoints)
+                    cell_keypoints.push_back(kp.pt + offset);
+            }
+            else
+            {
+                cv::goodFeaturesToTrack(frame(cell_rect), cell_keypoints,
+                                        _corners_per_cell, _qualityLevel,
+                                        _minDistance, cell_mask, _blockSize,
+                                        _useHarrisDetector, _k);
+                for (cv::Point2f &kp: cell_keypoints)
+                    kp += offset;
+            }
+        }
+    };
+
+    if (_parallel_detection)
+        cv::parallel_for_(cv::Range(0, num_cells), detect_in_cells);
+    else
+        detect_in_cells(cv::Range(0, num_cells));
+
+    // Concatenate in cell order, so the result is deterministic
+    for (const std::vector<cv::Point2f> &cell_keypoints: _cell_keypoints)
+        keypoints.insert(keypoints.end(), cell_keypoints.begin(),
+                         cell_keypoints.end());
+}
+
+
 // OpenCV VideoStab
 OpenCV_VideoStab_GMC::OpenCV_VideoStab_GMC(const std::string &config_path)
 {
@@ -612,19 +846,157 @@ void OptFlowModified_GMC::_load_params_from_config(
         exit(1);
     }
 
-    _downscale = gmc_config.GetFloat(_algo_name, "downscale", 2.0F);
+    _downscale = gmc_config.GetFloat(_algo_name, "downscale", 8.0F);
+    _grid_rows = static_cast<int>(
+            std::max(1L, gmc_config.GetInteger(_algo_name, "grid_rows", 4)));
+    _grid_cols = static_cast<int>(
+            std::max(1L, gmc_config.GetInteger(_algo_name, "grid_cols", 6)));
+    _win_size = static_cast<int>(
+            gmc_config.GetInteger(_algo_name, "win_size", 15));
+    _min_response = gmc_config.GetReal(_algo_name, "min_response", 0.1);
+    _detections_masking =
+            gmc_config.GetBoolean(_algo_name, "detections_masking", true);
+    _ransac = RansacMotionEstimator(
+            load_ransac_params(gmc_config, _algo_name, 1.0F));
 }
 
 
 HomographyMatrix
-OptFlowModified_GMC::apply(const cv::Mat &frame,
+OptFlowModified_GMC::apply(const cv::Mat &frame_raw,
                            const std::vector<Detection> &detections)
 {
     HomographyMatrix H;
     H.setIdentity();
 
-    std::cout << "Warning: OptFlowModified_GMC not implemented, returning "
-                 "identity matrix"
-              << std::endl;
+    if (frame_raw.empty())
+    {
+        return H;
+    }
+
+
+    // Heavily downscale, the motion is estimated on a tiny grayscale image
+    int width = frame_raw.cols;
+    int height = frame_raw.rows;
+    if (_downscale > 1.0F)
+    {
+        width = static_cast<int>(width / _downscale);
+        height = static_cast<int>(height / _downscale);
+    }
+    cv::resize(frame_raw, _frame_small, cv::Size(width, height));
+    if (_frame_small.channels() == 3)
+        cv::cvtColor(_frame_small, _curr_gray, cv::COLOR_BGR2GRAY);
+    else
+        _frame_small.copyTo(_curr_gray);
+    _curr_gray.convertTo(_curr_float, CV_32F);
+
+    if (!_first_frame_initialized || _prev_gray.size() != _curr_gray.size())
+    {
+        /**
+         *  If this is the first frame, there is nothing to match
+         *  Create the phase correlation window and the grid of points to track,
+         *  save the frame and return identity matrix
+         */
+        _first_frame_initialized = true;
+        cv::createHanningWindow(_window, _curr_float.size(), CV_32F);
+
+        _grid_points.clear();
+        const float cell_width = static_cast<float>(width) / _grid_cols;
+        const float cell_height = static_cast<float>(height) / _grid_rows;
+        for (int row = 0; row < _grid_rows; ++row)
+            for (int col = 0; col < _grid_cols; ++col)
+                _grid_points.emplace_back((col + 0.5F) * cell_width,
+                                          (row + 0.5F) * cell_height);
+
+        cv::swap(_prev_gray, _curr_gray);
+        cv::swap(_prev_float, _curr_float);
+        return H;
+    }
+
+
+    // Coarse translation of the whole frame using phase correlation
+    double response = 0.0;
+    cv::Point2d shift =
+            cv::phaseCorrelate(_prev_float, _curr_float, _window, &response);
+    const cv::Point2f coarse_shift =
+            response >= _min_response
+                    ? cv::Point2f(static_cast<float>(shift.x),
+                                  static_cast<float>(shift.y))
+                    : cv::Point2f(0.0F, 0.0F);
+
+
+    // Refine the displacement of a fixed grid of background points, initialized with the coarse translation
+    cv::Mat mask = _detections_masking
+                           ? _mask.update(_curr_gray.size(), detections,
+                                          _downscale)
+                           : cv::Mat();
+    _prev_points.clear();
+    _curr_points.clear();
+    for (const cv::Point2f &point: _grid_points)
+    {
+        if (!mask.empty() && mask.at<uchar>(static_cast<int>(point.y),
+                                            static_cast<int>(point.x)) == 0)
+            continue;
+
+        _prev_points.push_back(point);
+        _curr_points.push_back(point + coarse_shift);
+    }
+
+    RansacResult motion;
+    if (_prev_points.size() >= 3)
+    {
+        cv::calcOpticalFlowPyrLK(
+                _prev_gray, _curr_gray, _prev_points, _curr_points, _status,
+                _err, cv::Size(_win_size, _win_size), 1,
+                cv::TermCriteria(cv::TermCriteria::COUNT |
+                                         cv::TermCriteria::EPS,
+                                 10, 0.03),
+                cv::OPTFLOW_USE_INITIAL_FLOW);
+
+        size_t num_tracked = 0;
+        for (size_t i = 0; i < _status.size(); ++i)
+        {
+            if (_status[i])
+            {
+                _prev_points[num_tracked] = _prev_points[i];
+                _curr_points[num_tracked] = _curr_points[i];
+                _err[num_tracked] = _err[i];
+                ++num_tracked;
+            }
+        }
+        _prev_points.resize(num_tracked);
+        _curr_points.resize(num_tracked);
+        _err.resize(num_tracked);
+
+        if (num_tracked >= 3)
+        {
+            motion = _ransac.estimate(_prev_points, _curr_points, _err);
+            record_motion_metrics(motion, motion.success);
+        }
+    }
+
+
+    if (motion.success)
+    {
+        H = motion.H;
+    }
+    else if (response >= _min_response)
+    {
+        // Not enough tracked points, fall back to the coarse translation
+        H(0, 2) = coarse_shift.x;
+        H(1, 2) = coarse_shift.y;
+    }
+    else
+    {
+        std::cout << "Warning: Could not estimate affine matrix" << std::endl;
+    }
+
+    if (_downscale > 1.0F)
+    {
+        H(0, 2) *= _downscale;
+        H(1, 2) *= _downscale;
+    }
+
+    cv::swap(_prev_gray, _curr_gray);
+    cv::swap(_prev_float, _curr_float);
     return H;
-}
+}
\ No newline at end of file
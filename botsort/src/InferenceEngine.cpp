@@ -0,0 +1,42 @@
+#include "InferenceEngine.h"
+
+#include <iostream>
+
+#include "CPU_InferenceEngine/OpenCV_DNN_InferenceEngine.h"
+#ifdef BOTSORT_WITH_TENSORRT
+#include "TRT_InferenceEngine/TensorRT_InferenceEngine.h"
+#endif
+
+
+std::unique_ptr<inference_backend::InferenceEngine>
+inference_backend::create_inference_engine(const InferenceEngineParams &params)
+{
+    if (params.backend == "tensorrt")
+    {
+#ifdef BOTSORT_WITH_TENSORRT
+        TRTOptimizerParams trt_params;
+        trt_params.batch_size = params.batch_size;
+        trt_params.fp16 = params.fp16;
+        trt_params.tf32 = params.tf32;
+        trt_params.input_layer_name = params.input_layer_name;
+        trt_params.input_dims =
+                nvinfer1::Dims4{params.input_dims[0], params.input_dims[1],
+                                params.input_dims[2], params.input_dims[3]};
+        trt_params.output_layer_names = params.output_layer_names;
+
+        return std::make_unique<TensorRTInferenceEngine>(
+                trt_params, params.trt_logging_level);
+#else
+        std::cout << "WARNING: Built without TensorRT, using the opencv_dnn "
+                     "inference backend"
+                  << std::endl;
+        return std::make_unique<OpenCVDNNInferenceEngine>(params);
+#endif
+    }
+
+    if (params.backend == "opencv_dnn")
+        return std::make_unique<OpenCVDNNInferenceEngine>(params);
+
+    std::cout << "Unknown inference backend: " << params.backend << std::endl;
+    return nullptr;
+}
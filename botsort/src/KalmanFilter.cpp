@@ -50,8 +50,7 @@ KFDataStateSpace KalmanFilter::init(const DetVec &measurement) const
 void KalmanFilter::predict(KFStateSpaceVec &mean,
                            KFStateSpaceMatrix &covariance)
 {
-    Eigen::VectorXf std_combined;
-    std_combined.resize(KALMAN_STATE_SPACE_DIM);
+    Eigen::Matrix<float, KALMAN_STATE_SPACE_DIM, 1> std_combined;
     std_combined << mean(2), mean(3), mean(2), mean(3), mean(2), mean(3),
             mean(2), mean(3);
     std_combined.head<4>().array() *= _std_weight_position;
@@ -112,6 +111,19 @@ KFDataStateSpace KalmanFilter::update(const KFStateSpaceVec &mean,
 Eigen::Matrix<float, 1, Eigen::Dynamic> KalmanFilter::gating_distance(
         const KFStateSpaceVec &mean, const KFStateSpaceMatrix &covariance,
         const std::vector<DetVec> &measurements, bool only_position) const
+{
+    Eigen::Matrix<float, 1, Eigen::Dynamic> mahalanobis_distances(
+            measurements.size());
+    gating_distance(mean, covariance, measurements.data(), measurements.size(),
+                    mahalanobis_distances, only_position);
+    return mahalanobis_distances;
+}
+
+void KalmanFilter::gating_distance(
+        const KFStateSpaceVec &mean, const KFStateSpaceMatrix &covariance,
+        const DetVec *measurements, size_t num_measurements,
+        Eigen::Ref<Eigen::Matrix<float, 1, Eigen::Dynamic>> distances,
+        bool only_position) const
 {
     KFDataMeasurementSpace projected = this->project(mean, covariance);
     KFMeasSpaceVec projected_mean = projected.first;
@@ -123,20 +135,19 @@ Eigen::Matrix<float, 1, Eigen::Dynamic> KalmanFilter::gating_distance(
         projected_covariance.bottomRightCorner<2, 2>().setZero();
     }
 
-    Eigen::LLT<Eigen::MatrixXf> lltOfProjectedCovariance(projected_covariance);
-    Eigen::Matrix<float, 1, Eigen::Dynamic> mahalanobis_distances(
-            measurements.size());
-    mahalanobis_distances.setZero();
+    // Fixed-size decomposition and vectors, nothing is allocated per measurement
+    Eigen::LLT<KFMeasSpaceMatrix> lltOfProjectedCovariance(
+            projected_covariance);
 
-    for (Eigen::Index i = 0; i < measurements.size(); i++)
+    for (size_t i = 0; i < num_measurements; i++)
     {
-        Eigen::VectorXf diff = measurements[i] - projected_mean;
+        Eigen::Matrix<float, KALMAN_MEASUREMENT_SPACE_DIM, 1> diff =
+                (measurements[i] - projected_mean).transpose();
         // Solve for y in Ly = diff using forward substitution, more efficient than computing the inverse
-        Eigen::VectorXf y = lltOfProjectedCovariance.matrixL().solve(diff);
+        Eigen::Matrix<float, KALMAN_MEASUREMENT_SPACE_DIM, 1> y =
+                lltOfProjectedCovariance.matrixL().solve(diff);
         // Mahalanobis distance is the norm of y
-        mahalanobis_distances(i) = y.squaredNorm();
+        distances(i) = y.squaredNorm();
     }
-
-    return mahalanobis_distances;
 }
 }// namespace bot_kalman
\ No newline at end of file
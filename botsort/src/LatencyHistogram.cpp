@@ -0,0 +1,122 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1}
+                                      << bot_profiler::LatencyHistogram::
+                                                 SUB_BUCKET_BITS;
+
+
+/**
+ * @brief Index of the most significant bit of a non-zero value
+ */
+int msb_index(uint64_t value)
+{
+    int index = 0;
+    while (value >>= 1)
+        ++index;
+    return index;
+}
+}// namespace
+
+
+void bot_profiler::LatencyHistogram::record(uint64_t value)
+{
+    if (_counts.empty())
+        _counts.resize(_num_buckets(), 0);
+
+    _counts[_bucket_index(value)]++;
+    _count++;
+    _total += value;
+    _min = std::min(_min, value);
+    _max = std::max(_max, value);
+}
+
+
+void bot_profiler::LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    if (other._count == 0)
+        return;
+    if (_counts.empty())
+        _counts.resize(_num_buckets(), 0);
+
+    for (size_t i = 0; i < _counts.size(); ++i)
+        _counts[i] += other._counts[i];
+    _count += other._count;
+    _total += other._total;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+}
+
+
+void bot_profiler::LatencyHistogram::clear()
+{
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _total = 0;
+    _min = std::numeric_limits<uint64_t>::max();
+    _max = 0;
+}
+
+
+uint64_t
+bot_profiler::LatencyHistogram::value_at_percentile(double percentile) const
+{
+    if (_count == 0)
+        return 0;
+
+    const double fraction = std::clamp(percentile, 0.0, 100.0) / 100.0;
+    const uint64_t rank = std::max<uint64_t>(
+            1, static_cast<uint64_t>(
+                       std::ceil(fraction * static_cast<double>(_count))));
+    if (rank >= _count)
+        return _max;
+
+    uint64_t cumulative_count = 0;
+    for (size_t i = 0; i < _counts.size(); ++i)
+    {
+        cumulative_count += _counts[i];
+        if (cumulative_count >= rank)
+            return std::min(_bucket_upper_bound(i), _max);
+    }
+    return _max;
+}
+
+
+size_t bot_profiler::LatencyHistogram::_bucket_index(uint64_t value)
+{
+    // Exact buckets for the values below 2 * SUB_BUCKET_COUNT
+    if (value < 2 * SUB_BUCKET_COUNT)
+        return static_cast<size_t>(value);
+
+    value = std::min(value, MAX_TRACKABLE_VALUE);
+    const int exponent = msb_index(value);
+    const int shift = exponent - SUB_BUCKET_BITS;
+    const uint64_t sub_bucket = (value >> shift) - SUB_BUCKET_COUNT;
+    return static_cast<size_t>(2 * SUB_BUCKET_COUNT +
+                               (exponent - SUB_BUCKET_BITS - 1) *
+                                       SUB_BUCKET_COUNT +
+                               sub_bucket);
+}
+
+
+uint64_t bot_profiler::LatencyHistogram::_bucket_upper_bound(size_t index)
+{
+    if (index < 2 * SUB_BUCKET_COUNT)
+        return index;
+
+    const size_t log_index = index - 2 * SUB_BUCKET_COUNT;
+    const int shift = static_cast<int>(log_index / SUB_BUCKET_COUNT) + 1;
+    const uint64_t mantissa = SUB_BUCKET_COUNT + log_index % SUB_BUCKET_COUNT;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+
+size_t bot_profiler::LatencyHistogram::_num_buckets()
+{
+    return _bucket_index(MAX_TRACKABLE_VALUE) + 1;
+}
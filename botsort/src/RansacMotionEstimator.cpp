@@ -0,0 +1,397 @@
+#include "RansacMotionEstimator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include <Eigen/Eigenvalues>
+
+
+namespace
+{
+constexpr int HYPOTHESES_PER_BATCH = 16;
+constexpr int MAX_SAMPLE_ATTEMPTS = 100;
+constexpr double DEGENERACY_EPS = 1e-9;
+
+/**
+ * @brief Fixed (per hypothesis) seed, so that the sampling does not depend on the execution order
+ */
+uint64_t hypothesis_seed(int hypothesis)
+{
+    return 0x9E3779B97F4A7C15ULL * static_cast<uint64_t>(hypothesis + 1);
+}
+}// namespace
+
+
+RansacMotionEstimator::RansacMotionEstimator(const RansacParams &params)
+    : _params(params)
+{
+    _params.max_iters = std::max(1, _params.max_iters);
+    _params.lo_iters = std::max(0, _params.lo_iters);
+    _params.confidence = std::min(std::max(_params.confidence, 0.0F), 0.9999F);
+}
+
+
+MotionModel
+RansacMotionEstimator::motion_model_from_string(const std::string &name)
+{
+    if (name == "similarity")
+        return MotionModel::Similarity;
+    if (name == "affine")
+        return MotionModel::Affine;
+    if (name == "homography")
+        return MotionModel::Homography;
+
+    std::cout << "Unknown motion model: " << name
+              << " (expected similarity, affine or homography)" << std::endl;
+    exit(1);
+}
+
+
+int RansacMotionEstimator::min_sample_size() const
+{
+    switch (_params.model)
+    {
+        case MotionModel::Similarity:
+            return 2;
+        case MotionModel::Affine:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+
+RansacResult
+RansacMotionEstimator::estimate(const std::vector<cv::Point2f> &src_points,
+                                const std::vector<cv::Point2f> &dst_points,
+                                const std::vector<float> &match_costs)
+{
+    RansacResult result;
+    const int sample_size = min_sample_size();
+    _num_points = static_cast<int>(
+            std::min(src_points.size(), dst_points.size()));
+    result.inliers.assign(_num_points, 0);
+    if (_num_points < sample_size)
+        return result;
+
+    _src = src_points.data();
+    _dst = dst_points.data();
+
+
+    // PROSAC: sort the correspondences by their cost, hypotheses are first drawn from the best ones
+    _order.resize(_num_points);
+    std::iota(_order.begin(), _order.end(), 0);
+    _prosac = match_costs.size() == static_cast<size_t>(_num_points);
+    if (_prosac)
+    {
+        std::stable_sort(_order.begin(), _order.end(), [&](int a, int b) {
+            return match_costs[a] < match_costs[b];
+        });
+    }
+
+
+    // Hypothesize and verify, in batches of HYPOTHESES_PER_BATCH
+    std::array<Model, HYPOTHESES_PER_BATCH> models;
+    std::array<int, HYPOTHESES_PER_BATCH> scores;
+    const bool parallel = _num_points >= _params.parallel_min_points;
+
+    Model best_model = Model::Identity();
+    int best_score = 0;
+    int max_iters = _params.max_iters;
+    int iteration = 0;
+    while (iteration < max_iters)
+    {
+        const int batch_size =
+                std::min(HYPOTHESES_PER_BATCH, max_iters - iteration);
+
+        auto evaluate = [&](int i) {
+            std::array<int, 4> sample{};
+            _draw_sample(iteration + i, sample.data());
+            scores[i] = _fit(sample.data(), sample_size, models[i])
+                                ? _score(models[i], nullptr)
+                                : 0;
+        };
+
+        if (parallel)
+        {
+            cv::parallel_for_(cv::Range(0, batch_size),
+                              [&](const cv::Range &range) {
+                                  for (int i = range.start; i < range.end; ++i)
+                                      evaluate(i);
+                              });
+        }
+        else
+        {
+            for (int i = 0; i < batch_size; ++i)
+                evaluate(i);
+        }
+        iteration += batch_size;
+
+
+        // Keep the best hypothesis of the batch (first one on ties, which keeps the result deterministic)
+        int batch_best = 0;
+        for (int i = 1; i < batch_size; ++i)
+            if (scores[i] > scores[batch_best])
+                batch_best = i;
+
+        if (scores[batch_best] > best_score)
+        {
+            best_model = models[batch_best];
+            best_score = scores[batch_best];
+            if (_params.lo_iters > 0)
+                _local_optimization(best_model, best_score, _params.lo_iters);
+            max_iters = std::min(max_iters, _required_iterations(best_score));
+        }
+    }
+    result.iterations = iteration;
+
+    if (best_score < sample_size)
+        return result;
+
+
+    // Final least squares refit on all inliers
+    _local_optimization(best_model, best_score, 1);
+    best_score = _score(best_model, result.inliers.data());
+    if (best_score < sample_size)
+        return result;
+
+    result.success = true;
+    result.num_inliers = best_score;
+    result.H = best_model.cast<float>();
+    return result;
+}
+
+
+int RansacMotionEstimator::_subset_size(int hypothesis) const
+{
+    if (!_prosac)
+        return _num_points;
+
+    // The sampling subset grows from the best matches to all the matches over the first half of the iterations
+    const int sample_size = min_sample_size();
+    const int growth_iters = std::max(1, _params.max_iters / 2);
+    const int64_t extra = static_cast<int64_t>(_num_points - sample_size) *
+                          (hypothesis + 1) / growth_iters;
+    return static_cast<int>(
+            std::min<int64_t>(_num_points, sample_size + extra));
+}
+
+
+void RansacMotionEstimator::_draw_sample(int hypothesis, int *sample) const
+{
+    const int sample_size = min_sample_size();
+    const int subset_size = _subset_size(hypothesis);
+    cv::RNG rng(hypothesis_seed(hypothesis));
+
+    for (int i = 0; i < sample_size; ++i)
+    {
+        int index = 0;
+        for (int attempt = 0; attempt < MAX_SAMPLE_ATTEMPTS; ++attempt)
+        {
+            index = _order[rng.uniform(0, subset_size)];
+            if (std::find(sample, sample + i, index) == sample + i)
+                break;
+        }
+        sample[i] = index;
+    }
+}
+
+
+bool RansacMotionEstimator::_fit(const int *indices, int count,
+                                 Model &model) const
+{
+    if (count < min_sample_size())
+        return false;
+
+    // Centroids
+    Eigen::Vector2d src_mean = Eigen::Vector2d::Zero();
+    Eigen::Vector2d dst_mean = Eigen::Vector2d::Zero();
+    for (int i = 0; i < count; ++i)
+    {
+        const cv::Point2f &s = _src[indices[i]];
+        const cv::Point2f &d = _dst[indices[i]];
+        src_mean += Eigen::Vector2d(s.x, s.y);
+        dst_mean += Eigen::Vector2d(d.x, d.y);
+    }
+    src_mean /= count;
+    dst_mean /= count;
+
+    model.setIdentity();
+    if (_params.model == MotionModel::Similarity)
+    {
+        // Closed form least squares for [a -b tx; b a ty] on the centered points
+        double a = 0.0, b = 0.0, norm = 0.0;
+        for (int i = 0; i < count; ++i)
+        {
+            const double sx = _src[indices[i]].x - src_mean.x();
+            const double sy = _src[indices[i]].y - src_mean.y();
+            const double dx = _dst[indices[i]].x - dst_mean.x();
+            const double dy = _dst[indices[i]].y - dst_mean.y();
+            a += sx * dx + sy * dy;
+            b += sx * dy - sy * dx;
+            norm += sx * sx + sy * sy;
+        }
+        if (norm < DEGENERACY_EPS)
+            return false;
+
+        a /= norm;
+        b /= norm;
+        model(0, 0) = a;
+        model(0, 1) = -b;
+        model(1, 0) = b;
+        model(1, 1) = a;
+    }
+    else if (_params.model == MotionModel::Affine)
+    {
+        // Normal equations of the linear part on the centered points
+        Eigen::Matrix2d StS = Eigen::Matrix2d::Zero();
+        Eigen::Matrix2d StD = Eigen::Matrix2d::Zero();
+        for (int i = 0; i < count; ++i)
+        {
+            const Eigen::Vector2d s(_src[indices[i]].x - src_mean.x(),
+                                    _src[indices[i]].y - src_mean.y());
+            const Eigen::Vector2d d(_dst[indices[i]].x - dst_mean.x(),
+                                    _dst[indices[i]].y - dst_mean.y());
+            StS += s * s.transpose();
+            StD += s * d.transpose();
+        }
+        if (std::abs(StS.determinant()) < DEGENERACY_EPS)
+            return false;
+
+        model.topLeftCorner<2, 2>() = (StS.inverse() * StD).transpose();
+    }
+    else
+    {
+        // Normalized DLT
+        double src_scale = 0.0, dst_scale = 0.0;
+        for (int i = 0; i < count; ++i)
+        {
+            const cv::Point2f &s = _src[indices[i]];
+            const cv::Point2f &d = _dst[indices[i]];
+            src_scale += std::hypot(s.x - src_mean.x(), s.y - src_mean.y());
+            dst_scale += std::hypot(d.x - dst_mean.x(), d.y - dst_mean.y());
+        }
+        if (src_scale < DEGENERACY_EPS || dst_scale < DEGENERACY_EPS)
+            return false;
+        src_scale = std::sqrt(2.0) * count / src_scale;
+        dst_scale = std::sqrt(2.0) * count / dst_scale;
+
+        Eigen::Matrix<double, 9, 9> AtA = Eigen::Matrix<double, 9, 9>::Zero();
+        Eigen::Matrix<double, 2, 9> A;
+        for (int i = 0; i < count; ++i)
+        {
+            const double x = (_src[indices[i]].x - src_mean.x()) * src_scale;
+            const double y = (_src[indices[i]].y - src_mean.y()) * src_scale;
+            const double u = (_dst[indices[i]].x - dst_mean.x()) * dst_scale;
+            const double v = (_dst[indices[i]].y - dst_mean.y()) * dst_scale;
+            A << -x, -y, -1, 0, 0, 0, u * x, u * y, u, 0, 0, 0, -x, -y, -1,
+                    v * x, v * y, v;
+            AtA.noalias() += A.transpose() * A;
+        }
+
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 9, 9>> solver(
+                AtA);
+        const Eigen::Matrix<double, 9, 1> h = solver.eigenvectors().col(0);
+        Model H_normalized;
+        H_normalized << h(0), h(1), h(2), h(3), h(4), h(5), h(6), h(7), h(8);
+
+        Model T_src = Model::Identity(), T_dst_inv = Model::Identity();
+        T_src(0, 0) = T_src(1, 1) = src_scale;
+        T_src(0, 2) = -src_scale * src_mean.x();
+        T_src(1, 2) = -src_scale * src_mean.y();
+        T_dst_inv(0, 0) = T_dst_inv(1, 1) = 1.0 / dst_scale;
+        T_dst_inv(0, 2) = dst_mean.x();
+        T_dst_inv(1, 2) = dst_mean.y();
+
+        model = T_dst_inv * H_normalized * T_src;
+        if (std::abs(model(2, 2)) < DEGENERACY_EPS)
+            return false;
+        model /= model(2, 2);
+        return true;
+    }
+
+    model.block<2, 1>(0, 2) =
+            dst_mean - model.topLeftCorner<2, 2>() * src_mean;
+    return true;
+}
+
+
+int RansacMotionEstimator::_score(const Model &model, uint8_t *inliers) const
+{
+    const double thresh_sq = static_cast<double>(_params.reproj_thresh) *
+                             _params.reproj_thresh;
+    const bool projective = _params.model == MotionModel::Homography;
+
+    int num_inliers = 0;
+    for (int i = 0; i < _num_points; ++i)
+    {
+        const double x = _src[i].x, y = _src[i].y;
+        double px = model(0, 0) * x + model(0, 1) * y + model(0, 2);
+        double py = model(1, 0) * x + model(1, 1) * y + model(1, 2);
+        bool inlier = true;
+        if (projective)
+        {
+            const double w = model(2, 0) * x + model(2, 1) * y + model(2, 2);
+            inlier = std::abs(w) > DEGENERACY_EPS;
+            px /= w;
+            py /= w;
+        }
+
+        const double dx = px - _dst[i].x, dy = py - _dst[i].y;
+        inlier = inlier && dx * dx + dy * dy < thresh_sq;
+        num_inliers += inlier;
+        if (inliers)
+            inliers[i] = inlier;
+    }
+    return num_inliers;
+}
+
+
+void RansacMotionEstimator::_local_optimization(Model &model, int &num_inliers,
+                                                int iterations)
+{
+    _inlier_mask.resize(_num_points);
+    for (int iter = 0; iter < iterations; ++iter)
+    {
+        _score(model, _inlier_mask.data());
+        _inlier_indices.clear();
+        for (int i = 0; i < _num_points; ++i)
+            if (_inlier_mask[i])
+                _inlier_indices.push_back(i);
+
+        Model refined;
+        if (!_fit(_inlier_indices.data(),
+                  static_cast<int>(_inlier_indices.size()), refined))
+            return;
+
+        const int refined_inliers = _score(refined, nullptr);
+        if (refined_inliers < num_inliers)
+            return;
+
+        const bool converged = refined_inliers == num_inliers;
+        model = refined;
+        num_inliers = refined_inliers;
+        if (converged)
+            return;
+    }
+}
+
+
+int RansacMotionEstimator::_required_iterations(int num_inliers) const
+{
+    const double inlier_ratio =
+            static_cast<double>(num_inliers) / static_cast<double>(_num_points);
+    const double p_good_sample = std::pow(inlier_ratio, min_sample_size());
+    if (p_good_sample >= 1.0)
+        return 0;
+    if (p_good_sample <= DEGENERACY_EPS)
+        return _params.max_iters;
+
+    const double required = std::log(1.0 - _params.confidence) /
+                            std::log(1.0 - p_good_sample);
+    return static_cast<int>(
+            std::min<double>(_params.max_iters, std::ceil(required)));
+}
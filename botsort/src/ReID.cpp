@@ -1,47 +1,159 @@
 #include "ReID.h"
 
+#include <algorithm>
+#include <iostream>
+
 #include "INIReader.h"
+#include "ReIDPreprocessing.h"
+#include "metrics.h"
+#include "profiler.h"
+
+
+namespace
+{
+bot_metrics::Counter reid_batches_total("botsort_reid_batches_total",
+                                        "Re-ID inference batches", "result",
+                                        {"ok", "failed"});
+bot_metrics::Counter reid_patches_total("botsort_reid_patches_total",
+                                        "Crops embedded by the Re-ID model");
+}// namespace
+
 
 ReIDModel::ReIDModel(const std::string &config_path,
                      const std::string &onnx_model_path)
+    : ReIDModel(config_path, onnx_model_path, nullptr)
+{
+}
+
+
+ReIDModel::ReIDModel(
+        const std::string &config_path, const std::string &onnx_model_path,
+        std::unique_ptr<inference_backend::InferenceEngine> inference_engine)
 {
     std::cout << "Initializing ReID model" << std::endl;
     _load_params_from_config(config_path);
 
     _onnx_model_path = onnx_model_path;
-    _trt_inference_engine =
-            std::make_unique<inference_backend::TensorRTInferenceEngine>(
-                    _model_optimization_params, _trt_logging_level);
+    _inference_engine = inference_engine
+                                ? std::move(inference_engine)
+                                : inference_backend::create_inference_engine(
+                                          _inference_params);
 
-    bool net_initialized = _trt_inference_engine->load_model(_onnx_model_path);
+    bool net_initialized = _inference_engine &&
+                           _inference_engine->load_model(_onnx_model_path);
     if (!net_initialized)
     {
         std::cout << "Failed to initialize ReID model" << std::endl;
         exit(1);
     }
+
+    // Preallocated NCHW input buffer for the largest batch
+    _max_batch_size =
+            std::max(1, std::min(_inference_params.batch_size,
+                                 _inference_engine->max_batch_size()));
+    const int blob_dims[] = {_max_batch_size, 3, _input_size.height,
+                             _input_size.width};
+    _batch_blob.create(4, blob_dims, CV_32F);
+}
+
+
+FeatureVector ReIDModel::extract_features(const cv::Mat &image_patch)
+{
+    const cv::Rect patch_rect(0, 0, image_patch.cols, image_patch.rows);
+    return extract_features(image_patch, {patch_rect}).features.row(0);
 }
 
 
-FeatureVector ReIDModel::extract_features(cv::Mat &image_patch)
+ReIDFeatures ReIDModel::extract_features(const cv::Mat &frame,
+                                         const std::vector<cv::Rect> &rois)
 {
-    pre_process(image_patch);
-    std::vector<std::vector<float>> output =
-            _trt_inference_engine->forward(image_patch);
+    ReIDFeatures features;
+    features.features = FeatureMatrix::Zero(rois.size(), FEATURE_DIM);
+    features.valid.assign(rois.size(), false);
 
-    // TODO: Clean this up
-    FeatureVector feature_vector = FeatureVector::Zero(1, FEATURE_DIM);
-    for (int i = 0; i < FEATURE_DIM; i++)
-        feature_vector(0, i) = output[0][i];
+    const size_t max_batch_size = static_cast<size_t>(_max_batch_size);
+    for (size_t batch_start = 0; batch_start < rois.size();
+         batch_start += max_batch_size)
+    {
+        const size_t batch_size =
+                std::min(max_batch_size, rois.size() - batch_start);
+
+        // Crop, resize and normalize the patches straight into the input buffer
+        _batch_rois.assign(rois.begin() + batch_start,
+                           rois.begin() + batch_start + batch_size);
+        if (!preprocess(frame, _batch_rois, _batch_blob.ptr<float>()))
+            return features;
+
+        const ReIDFeatures batch_features =
+                infer(_batch_blob.ptr<float>(), batch_size);
+        features.features.middleRows(batch_start, batch_size) =
+                batch_features.features;
+        std::copy(batch_features.valid.begin(), batch_features.valid.end(),
+                  features.valid.begin() + batch_start);
+    }
 
-    return feature_vector;
+    return features;
 }
 
 
-void ReIDModel::pre_process(cv::Mat &image)
+bool ReIDModel::preprocess(const cv::Mat &frame,
+                           const std::vector<cv::Rect> &rois,
+                           float *blob) const
 {
-    cv::resize(image, image, _input_size);
-    if (_model_optimization_params.swapRB)
-        cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+    PROFILE_BEGIN(preprocess_timer, "ReIDModel::preprocess");
+    PROFILE_COUNT(preprocess_timer, rois.size());
+    if (frame.type() != CV_8UC3)
+    {
+        std::cout << "Warning: ReID expects 8-bit BGR frames" << std::endl;
+        return false;
+    }
+
+    preprocess_patches(frame, rois, _input_size, _normalization, blob);
+    return true;
+}
+
+
+ReIDFeatures ReIDModel::infer(const float *blob, size_t num_patches)
+{
+    PROFILE_BEGIN(infer_timer, "ReIDModel::infer");
+    PROFILE_COUNT(infer_timer, num_patches);
+    const bot_profiler::StreamId stream_id = bot_profiler::get_stream_id();
+    ReIDFeatures features;
+    features.features = FeatureMatrix::Zero(num_patches, FEATURE_DIM);
+    features.valid.assign(num_patches, false);
+
+    const size_t max_batch_size = static_cast<size_t>(_max_batch_size);
+    for (size_t batch_start = 0; batch_start < num_patches;
+         batch_start += max_batch_size)
+    {
+        const size_t batch_size =
+                std::min(max_batch_size, num_patches - batch_start);
+
+        const int blob_dims[] = {static_cast<int>(batch_size), 3,
+                                 _input_size.height, _input_size.width};
+        cv::Mat batch_blob(4, blob_dims, CV_32F,
+                           const_cast<float *>(blob) +
+                                   batch_start * patch_size());
+
+        inference_backend::ModelPredictions output =
+                _inference_engine->forward_batch(batch_blob);
+        if (output.empty() || output[0].size() < batch_size * FEATURE_DIM)
+        {
+            std::cout << "Warning: ReID inference failed" << std::endl;
+            reid_batches_total.inc(stream_id, 1, 1);
+            continue;
+        }
+        reid_batches_total.inc(stream_id, 1, 0);
+        reid_patches_total.inc(stream_id, batch_size);
+
+        features.features.middleRows(batch_start, batch_size) =
+                Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic,
+                                               FEATURE_DIM, Eigen::RowMajor>>(
+                        output[0].data(), batch_size, FEATURE_DIM);
+        std::fill_n(features.valid.begin() + batch_start, batch_size, true);
+    }
+
+    return features;
 }
 
 
@@ -57,34 +169,50 @@ void ReIDModel::_load_params_from_config(const std::string &config_path)
 
     _distance_metric =
             reid_config.Get(section_name, "distance_metric", "euclidean");
-    _trt_logging_level =
-            reid_config.GetInteger(section_name, "trt_log_level", 1);
 
-    _model_optimization_params.batch_size =
-            reid_config.GetInteger(section_name, "batch_size", 1);
-    _model_optimization_params.fp16 =
+    _inference_params.backend =
+            reid_config.Get(section_name, "inference_backend", "tensorrt");
+    _inference_params.num_threads = static_cast<int>(
+            reid_config.GetInteger(section_name, "num_threads", 0));
+    _inference_params.trt_logging_level = static_cast<uint8_t>(
+            reid_config.GetInteger(section_name, "trt_log_level", 1));
+
+    _inference_params.batch_size = static_cast<int>(
+            reid_config.GetInteger(section_name, "batch_size", 1));
+    _inference_params.fp16 =
             reid_config.GetBoolean(section_name, "enable_FP16", true);
-    _model_optimization_params.tf32 =
+    _inference_params.tf32 =
             reid_config.GetBoolean(section_name, "enable_TF32", true);
 
-    _model_optimization_params.input_layer_name =
+    _inference_params.input_layer_name =
             reid_config.Get(section_name, "input_layer_name", "");
 
-    std::cout << "Trying to get input dims" << std::endl;
     std::vector<int> input_dims =
             reid_config.GetList<int>(section_name, "input_layer_dimensions");
+    if (input_dims.size() != 4)
+    {
+        std::cout << "input_layer_dimensions must be NCHW" << std::endl;
+        exit(1);
+    }
     _input_size = cv::Size(input_dims[3], input_dims[2]);
+    _inference_params.input_dims = input_dims;
 
-    std::cout << "Read input dims" << std::endl;
     std::cout << "Input dims: " << input_dims[0] << " " << input_dims[1] << " "
               << input_dims[2] << " " << input_dims[3] << std::endl;
 
-    _model_optimization_params.input_dims = nvinfer1::Dims4{
-            input_dims[0], input_dims[1], input_dims[2], input_dims[3]};
-    _model_optimization_params.swapRB =
+    _normalization.swap_rb =
             reid_config.GetBoolean(section_name, "swapRB", false);
 
-    _model_optimization_params.output_layer_names =
+    std::vector<float> mean =
+            reid_config.GetList<float>(section_name, "input_mean");
+    std::vector<float> stddev =
+            reid_config.GetList<float>(section_name, "input_std");
+    if (mean.size() == 3)
+        std::copy(mean.begin(), mean.end(), _normalization.mean.begin());
+    if (stddev.size() == 3)
+        std::copy(stddev.begin(), stddev.end(), _normalization.std.begin());
+
+    _inference_params.output_layer_names =
             reid_config.GetList<std::string>(section_name,
                                              "output_layer_names");
 }
\ No newline at end of file
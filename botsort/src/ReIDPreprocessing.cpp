@@ -0,0 +1,149 @@
+#include "ReIDPreprocessing.h"
+
+#include <algorithm>
+
+
+namespace
+{
+/**
+ * @brief Bilinear sampling table of one axis: source index pairs and the weight of the second one
+ */
+void build_sampling_table(int src_offset, int src_size, int dst_size,
+                          std::vector<int> &index0, std::vector<int> &index1,
+                          std::vector<float> &weight)
+{
+    index0.resize(dst_size);
+    index1.resize(dst_size);
+    weight.resize(dst_size);
+
+    const float scale = static_cast<float>(src_size) / dst_size;
+    for (int i = 0; i < dst_size; ++i)
+    {
+        // Pixel centers are aligned, like cv::resize
+        float src_pos = std::max((i + 0.5F) * scale - 0.5F, 0.0F);
+        int i0 = std::min(static_cast<int>(src_pos), src_size - 1);
+        index0[i] = src_offset + i0;
+        index1[i] = src_offset + std::min(i0 + 1, src_size - 1);
+        weight[i] = i0 < src_size - 1 ? src_pos - static_cast<float>(i0)
+                                      : 0.0F;
+    }
+}
+
+
+/**
+ * @brief Horizontally resize one source row into 3 planar float rows (in output channel order)
+ */
+void resize_row(const uint8_t *src_row, const std::vector<int> &x0,
+                const std::vector<int> &x1, const std::vector<float> &wx,
+                bool swap_rb, float *dst)
+{
+    const int width = static_cast<int>(x0.size());
+    for (int c = 0; c < 3; ++c)
+    {
+        const int src_channel = swap_rb ? 2 - c : c;
+        float *__restrict dst_plane = dst + c * width;
+        for (int x = 0; x < width; ++x)
+        {
+            const float p0 = src_row[3 * x0[x] + src_channel];
+            const float p1 = src_row[3 * x1[x] + src_channel];
+            dst_plane[x] = p0 + (p1 - p0) * wx[x];
+        }
+    }
+}
+}// namespace
+
+
+void preprocess_patch(const uint8_t *frame_data, size_t frame_step,
+                      const cv::Size &frame_size, const cv::Rect &roi,
+                      const cv::Size &output_size,
+                      const PatchNormalization &normalization, float *output)
+{
+    const int out_w = output_size.width, out_h = output_size.height;
+    const size_t plane_size = static_cast<size_t>(out_w) * out_h;
+
+    // Per-channel affine normalization, output = pixel * scale + shift
+    float scale[3], shift[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        scale[c] = 1.0F / normalization.std[c];
+        shift[c] = -normalization.mean[c] * scale[c];
+    }
+
+    const cv::Rect src = roi & cv::Rect(0, 0, frame_size.width,
+                                        frame_size.height);
+    if (src.empty())
+    {
+        for (int c = 0; c < 3; ++c)
+            std::fill_n(output + c * plane_size, plane_size, shift[c]);
+        return;
+    }
+
+    // Scratch buffers, reused across calls by each thread
+    thread_local std::vector<int> x0, x1, y0, y1;
+    thread_local std::vector<float> wx, wy, rows;
+    build_sampling_table(src.x, src.width, out_w, x0, x1, wx);
+    build_sampling_table(src.y, src.height, out_h, y0, y1, wy);
+    rows.resize(2 * 3 * out_w);
+
+
+    // Each output row blends two horizontally resized source rows, which are cached since
+    // consecutive output rows mostly share their source rows
+    float *row_top = rows.data(), *row_bottom = rows.data() + 3 * out_w;
+    int cached_top = -1, cached_bottom = -1;
+    for (int y = 0; y < out_h; ++y)
+    {
+        if (cached_top != y0[y])
+        {
+            if (cached_bottom == y0[y])
+            {
+                std::swap(row_top, row_bottom);
+                std::swap(cached_top, cached_bottom);
+            }
+            else
+            {
+                resize_row(frame_data + y0[y] * frame_step, x0, x1, wx,
+                           normalization.swap_rb, row_top);
+                cached_top = y0[y];
+            }
+        }
+        if (cached_bottom != y1[y])
+        {
+            resize_row(frame_data + y1[y] * frame_step, x0, x1, wx,
+                       normalization.swap_rb, row_bottom);
+            cached_bottom = y1[y];
+        }
+
+        // Vertical blend and normalization, contiguous and vectorized by the compiler
+        const float w = wy[y];
+        for (int c = 0; c < 3; ++c)
+        {
+            const float *__restrict top = row_top + c * out_w;
+            const float *__restrict bottom = row_bottom + c * out_w;
+            float *__restrict out = output + c * plane_size + y * out_w;
+            const float a = scale[c], b = shift[c];
+            for (int x = 0; x < out_w; ++x)
+                out[x] = (top[x] + (bottom[x] - top[x]) * w) * a + b;
+        }
+    }
+}
+
+
+void preprocess_patches(const cv::Mat &frame, const std::vector<cv::Rect> &rois,
+                        const cv::Size &output_size,
+                        const PatchNormalization &normalization, float *output)
+{
+    const size_t patch_size =
+            static_cast<size_t>(3) * output_size.width * output_size.height;
+    auto process = [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; ++i)
+            preprocess_patch(frame.data, frame.step, frame.size(), rois[i],
+                             output_size, normalization,
+                             output + i * patch_size);
+    };
+
+    if (rois.size() > 1)
+        cv::parallel_for_(cv::Range(0, static_cast<int>(rois.size())),
+                          process);
+    else
+        process(cv::Range(0, static_cast<int>(rois.size())));
+}
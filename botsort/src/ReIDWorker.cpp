@@ -0,0 +1,148 @@
+#include "ReIDWorker.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+
+ReIDWorker::ReIDWorker(ReIDModel &reid_model, size_t num_buffers)
+    : _reid_model(reid_model), _buffers(std::max<size_t>(1, num_buffers))
+{
+    _thread = std::thread(&ReIDWorker::_run, this);
+}
+
+
+ReIDWorker::~ReIDWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _queue_cv.notify_all();
+    _thread.join();
+}
+
+
+ReIDWorker::Ticket ReIDWorker::submit(const cv::Mat &frame,
+                                      const std::vector<cv::Rect> &rois)
+{
+    Buffer *buffer = nullptr;
+    {
+        // Bounded queue: wait for a free buffer
+        std::unique_lock<std::mutex> lock(_mutex);
+        _buffer_cv.wait(lock, [this, &buffer]() {
+            for (Buffer &candidate: _buffers)
+            {
+                if (candidate.state == BufferState::Free)
+                {
+                    buffer = &candidate;
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        buffer->state = BufferState::Filling;
+        buffer->ticket = _next_ticket++;
+        buffer->num_patches = rois.size();
+        buffer->stream_id = bot_profiler::get_stream_id();
+        buffer->frame_id = bot_profiler::get_frame_id();
+    }
+
+    // Pre-process on the calling thread, the buffer is owned by the caller until it is queued
+    buffer->input.resize(rois.size() * _reid_model.patch_size());
+    const bool preprocessed =
+            _reid_model.preprocess(frame, rois, buffer->input.data());
+
+    const Ticket ticket = buffer->ticket;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (preprocessed && !rois.empty())
+        {
+            buffer->state = BufferState::Queued;
+            _queue.push_back(buffer);
+        }
+        else
+        {
+            // Nothing to infer, or a failed ticket: no feature is applied for this frame
+            buffer->output = ReIDFeatures();
+            buffer->state = BufferState::Done;
+        }
+    }
+    _queue_cv.notify_one();
+
+    return ticket;
+}
+
+
+bool ReIDWorker::ready(Ticket ticket) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const Buffer &buffer: _buffers)
+    {
+        if (buffer.state != BufferState::Free && buffer.ticket == ticket)
+            return buffer.state == BufferState::Done;
+    }
+    return false;
+}
+
+
+ReIDFeatures ReIDWorker::wait(Ticket ticket)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    Buffer *buffer = _find_buffer(ticket);
+    if (!buffer)
+        return {};
+
+    _buffer_cv.wait(lock,
+                    [buffer]() { return buffer->state == BufferState::Done; });
+
+    ReIDFeatures features = std::move(buffer->output);
+    buffer->state = BufferState::Free;
+    lock.unlock();
+
+    _buffer_cv.notify_all();
+    return features;
+}
+
+
+void ReIDWorker::_run()
+{
+    while (true)
+    {
+        Buffer *buffer = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queue_cv.wait(lock, [this]() { return _stop || !_queue.empty(); });
+            if (_stop)
+                return;
+
+            buffer = _queue.front();
+            _queue.pop_front();
+        }
+
+        // The inference is traced on the stream and frame of the tracker that submitted it
+        bot_profiler::set_stream_id(buffer->stream_id);
+        bot_profiler::set_frame_id(buffer->frame_id);
+        ReIDFeatures features =
+                _reid_model.infer(buffer->input.data(), buffer->num_patches);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            buffer->output = std::move(features);
+            buffer->state = BufferState::Done;
+        }
+        _buffer_cv.notify_all();
+    }
+}
+
+
+ReIDWorker::Buffer *ReIDWorker::_find_buffer(Ticket ticket)
+{
+    for (Buffer &buffer: _buffers)
+    {
+        if (buffer.state != BufferState::Free && buffer.ticket == ticket)
+            return &buffer;
+    }
+    return nullptr;
+}
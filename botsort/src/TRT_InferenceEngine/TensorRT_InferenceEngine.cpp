@@ -1,23 +1,213 @@
 #include "TRT_InferenceEngine/TensorRT_InferenceEngine.h"
 
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
 
 #include <NvOnnxParser.h>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+
+
+/**
+ * @brief 64-bit FNV-1a hash, the running hash is passed in to hash several buffers
+ */
+uint64_t fnv1a(const void *data, size_t size,
+               uint64_t hash = FNV_OFFSET_BASIS)
+{
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+template<typename T>
+uint64_t fnv1a_value(const T &value, uint64_t hash)
+{
+    return fnv1a(&value, sizeof(T), hash);
+}
+
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path)
+    {
+#ifdef _WIN32
+        _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+        if (_file == INVALID_HANDLE_VALUE)
+            return;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+            return;
+
+        _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0,
+                                      nullptr);
+        if (!_mapping)
+            return;
+
+        _data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (_data)
+            _size = static_cast<size_t>(size.QuadPart);
+#else
+        _fd = open(path.c_str(), O_RDONLY);
+        if (_fd < 0)
+            return;
+
+        struct stat file_stat
+        {
+        };
+        if (fstat(_fd, &file_stat) != 0 || file_stat.st_size == 0)
+            return;
+
+        void *data = mmap(nullptr, static_cast<size_t>(file_stat.st_size),
+                          PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (data == MAP_FAILED)
+            return;
+
+        _data = data;
+        _size = static_cast<size_t>(file_stat.st_size);
+        madvise(_data, _size, MADV_SEQUENTIAL);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (_data)
+            UnmapViewOfFile(_data);
+        if (_mapping)
+            CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE)
+            CloseHandle(_file);
+#else
+        if (_data)
+            munmap(_data, _size);
+        if (_fd >= 0)
+            close(_fd);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const void *data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+
+private:
+    void *_data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+};
+
+
+/**
+ * @brief Write the buffer to a temporary file next to the path, then rename it
+ *  Readers never see a partially written file, concurrent writers produce the same content
+ */
+bool write_file_atomic(const std::string &path, const void *data, size_t size)
+{
+    std::random_device random_device;
+    std::ostringstream tmp_path;
+    tmp_path << path << ".tmp" << std::hex << random_device();
+
+    FILE *file = std::fopen(tmp_path.str().c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool written = std::fwrite(data, 1, size, file) == size &&
+                   std::fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = std::fclose(file) == 0 && written;
+
+    std::error_code error;
+    if (written)
+        std::filesystem::rename(tmp_path.str(), path, error);
+    if (!written || error)
+    {
+        std::filesystem::remove(tmp_path.str(), error);
+        return false;
+    }
+    return true;
+}
+}// namespace
+
+
 inference_backend::TensorRTInferenceEngine::TensorRTInferenceEngine(
         TRTOptimizerParams &optimization_params, uint8_t logging_level)
 {
     _set_optimization_params(optimization_params);
     _init_TRT_logger(logging_level);
+
+    // On failure the handle is left null, load_model() then fails
+    if (!_cuda_succeeded(cudaStreamCreateWithFlags(&_cuda_stream,
+                                                   cudaStreamNonBlocking),
+                         "cudaStreamCreateWithFlags"))
+        _cuda_stream = nullptr;
+    if (!_cuda_succeeded(cudaEventCreateWithFlags(&_inference_done,
+                                                  cudaEventDisableTiming),
+                         "cudaEventCreateWithFlags"))
+        _inference_done = nullptr;
 }
 
 
 inference_backend::TensorRTInferenceEngine::~TensorRTInferenceEngine()
 {
-    for (auto &buffer: _buffers)
-        cudaFree(buffer);
-
-    cudaStreamDestroy(_cuda_stream);
+    if (_cuda_stream)
+        cudaStreamSynchronize(_cuda_stream);
+    _free_buffers();
+
+    if (_inference_done)
+        cudaEventDestroy(_inference_done);
+    if (_cuda_stream)
+        cudaStreamDestroy(_cuda_stream);
 }
 
 
@@ -36,6 +226,21 @@ void inference_backend::TensorRTInferenceEngine::_init_TRT_logger(
 }
 
 
+bool inference_backend::TensorRTInferenceEngine::_cuda_succeeded(
+        cudaError_t status, const char *call) const
+{
+    if (status == cudaSuccess)
+        return true;
+
+    _logger->log(nvinfer1::ILogger::Severity::kERROR,
+                 std::string(call)
+                         .append(" failed: ")
+                         .append(cudaGetErrorString(status))
+                         .c_str());
+    return false;
+}
+
+
 bool inference_backend::TensorRTInferenceEngine::load_model(
         const std::string &onnx_model_path)
 {
@@ -44,6 +249,13 @@ bool inference_backend::TensorRTInferenceEngine::load_model(
                          .append(onnx_model_path)
                          .c_str());
 
+    if (!_cuda_stream || !_inference_done)
+    {
+        _logger->log(nvinfer1::ILogger::Severity::kERROR,
+                     std::string("CUDA stream or event not created").c_str());
+        return false;
+    }
+
     // Check if ONNX model exists
     if (!file_exists(onnx_model_path))
     {
@@ -62,21 +274,40 @@ bool inference_backend::TensorRTInferenceEngine::load_model(
                      std::string("Engine not found at path: ")
                              .append(engine_path)
                              .c_str());
-        _build_engine(onnx_model_path);
+        if (!_build_engine(onnx_model_path, engine_path))
+            return false;
     }
 
-    // Deserialize engine
+    // Deserialize engine, a cached engine that can't be deserialized (e.g. truncated) is rebuilt once
     _logger->log(nvinfer1::ILogger::Severity::kINFO,
                  std::string("Deserializing engine from path: ")
                          .append(engine_path)
                          .c_str());
-    if (_deserialize_engine(engine_path))
+    bool deserialized = _deserialize_engine(engine_path);
+    if (!deserialized)
+    {
+        _logger->log(nvinfer1::ILogger::Severity::kWARNING,
+                     std::string("Rebuilding invalid engine: ")
+                             .append(engine_path)
+                             .c_str());
+        std::error_code error;
+        std::filesystem::remove(engine_path, error);
+        deserialized = _build_engine(onnx_model_path, engine_path) &&
+                       _deserialize_engine(engine_path);
+    }
+
+    if (deserialized)
     {
         _logger->log(nvinfer1::ILogger::Severity::kINFO,
                      std::string("Engine deserialized successfully. Allocating "
                                  "buffers..")
                              .c_str());
-        _allocate_buffers();
+        if (!_allocate_buffers())
+        {
+            _logger->log(nvinfer1::ILogger::Severity::kERROR,
+                         std::string("Failed to allocate buffers").c_str());
+            return false;
+        }
         _logger->log(nvinfer1::ILogger::Severity::kINFO,
                      std::string("Engine loaded successfully").c_str());
         return true;
@@ -87,44 +318,57 @@ bool inference_backend::TensorRTInferenceEngine::load_model(
     return false;
 }
 
-#include <Windows.h>
 std::string inference_backend::TensorRTInferenceEngine::get_engine_path(
         const std::string &onnx_model_path) const
 {
-    // Parent director + model name
-    std::string engine_path =
-            std::filesystem::path(onnx_model_path).parent_path().string() +
-            "/" + std::filesystem::path(onnx_model_path).stem().string();
-
-    // Hostnamec
-    //char hostname[1024];
-    //gethostname(hostname, sizeof(hostname));
-    //std::string suffix(hostname);
-    std::string suffix;
-
-    // TensorRT version
-    suffix.append("_TRT" + std::to_string(NV_TENSORRT_VERSION));
-
-    // CUDA version
-    suffix.append("_CUDA" + std::to_string(CUDART_VERSION));
+    // Engine path = parent_dir/model_name_TRT_version_smXY_cache_key.engine
+    int device = 0;
+    cudaDeviceProp device_prop{};
+    cudaGetDevice(&device);
+    cudaGetDeviceProperties(&device_prop, device);
+
+    std::ostringstream suffix;
+    suffix << "_TRT" << NV_TENSORRT_VERSION << "_sm" << device_prop.major
+           << device_prop.minor << "_" << std::hex << std::setw(16)
+           << std::setfill('0') << _engine_cache_key(onnx_model_path);
+
+    const std::filesystem::path model_path(onnx_model_path);
+    return (model_path.parent_path() /
+            (model_path.stem().string() + suffix.str() + ".engine"))
+            .string();
+}
 
-    // Batch size
-    suffix.append("_" + std::to_string(_optimization_params.batch_size));
 
-    // int8, tf32, fp16, fp32
-    if (_optimization_params.int8)
-        suffix.append("_INT8");
-    else
+uint64_t inference_backend::TensorRTInferenceEngine::_engine_cache_key(
+        const std::string &onnx_model_path) const
+{
+    // Content of the ONNX model: a model updated in place gets a new engine
+    uint64_t hash = FNV_OFFSET_BASIS;
+    std::ifstream onnx_file(onnx_model_path, std::ios::binary);
+    std::vector<char> chunk(1 << 16);
+    while (onnx_file.read(chunk.data(), static_cast<std::streamsize>(
+                                                chunk.size())) ||
+           onnx_file.gcount() > 0)
     {
-        if (_optimization_params.tf32)
-            suffix.append("_TF32");
-        _optimization_params.fp16 ? suffix.append("_FP16")
-                                  : suffix.append("_FP32");
+        hash = fnv1a(chunk.data(), static_cast<size_t>(onnx_file.gcount()),
+                     hash);
     }
 
-    // Engine path = parent_dir/model_name_hostname_TRT_version_CUDA_version_batch_size_int8_fp16_fp32.engine
-    engine_path.append("_" + suffix + ".engine");
-    return engine_path;
+    // Input dimensions and builder flags
+    hash = fnv1a(_optimization_params.input_layer_name.data(),
+                 _optimization_params.input_layer_name.size(), hash);
+    hash = fnv1a_value(_optimization_params.input_dims.nbDims, hash);
+    for (int32_t i = 0; i < _optimization_params.input_dims.nbDims; ++i)
+        hash = fnv1a_value(_optimization_params.input_dims.d[i], hash);
+    hash = fnv1a_value(_optimization_params.batch_size, hash);
+    hash = fnv1a_value(_optimization_params.fp16, hash);
+    hash = fnv1a_value(_optimization_params.tf32, hash);
+    hash = fnv1a_value(_optimization_params.int8, hash);
+
+    // TensorRT and CUDA versions, an engine is only valid for the versions that built it
+    hash = fnv1a_value(static_cast<int64_t>(NV_TENSORRT_VERSION), hash);
+    hash = fnv1a_value(static_cast<int64_t>(CUDART_VERSION), hash);
+    return hash;
 }
 
 
@@ -145,12 +389,28 @@ size_t inference_backend::TensorRTInferenceEngine::get_size_by_dims(
 }
 
 
-void inference_backend::TensorRTInferenceEngine::_allocate_buffers()
+void inference_backend::TensorRTInferenceEngine::_free_buffers()
 {
-    for (void *&buffer: _buffers)
+    for (void *buffer: _buffers)
         cudaFree(buffer);
     _buffers.clear();
 
+    cudaFreeHost(_host_input);
+    _host_input = nullptr;
+    for (float *host_output: _host_outputs)
+        cudaFreeHost(host_output);
+    _host_outputs.clear();
+
+    _input_dims.clear();
+    _output_dims.clear();
+    _output_idx.clear();
+}
+
+
+bool inference_backend::TensorRTInferenceEngine::_allocate_buffers()
+{
+    _free_buffers();
+
 #if NVINFER_MAJOR == 8 && NVINFER_MINOR <= 5
     _buffers = std::vector<void *>(_engine->getNbBindings());
 #else
@@ -177,8 +437,21 @@ void inference_backend::TensorRTInferenceEngine::_allocate_buffers()
         nvinfer1::DataType dtype = _engine->getTensorDataType(name);
 #endif
 
+        // Dynamic batch, allocate for the largest batch of the optimization profile
+        if (dims.d[0] < 0)
+            dims.d[0] = std::max(1, _optimization_params.batch_size);
+
         size_t total_size = get_size_by_dims(dims, sizeof(float));
-        cudaMalloc(&_buffers[i], total_size);
+        if (!_cuda_succeeded(cudaMalloc(&_buffers[i], total_size),
+                             "cudaMalloc"))
+        {
+            _buffers[i] = nullptr;
+            _free_buffers();
+            return false;
+        }
+#if !(NVINFER_MAJOR == 8 && NVINFER_MINOR <= 5)
+        _context->setTensorAddress(name, _buffers[i]);
+#endif
 
 #if NVINFER_MAJOR == 8 && NVINFER_MINOR <= 5
         if (_engine->getBindingName(i) == _optimization_params.input_layer_name)
@@ -188,6 +461,16 @@ void inference_backend::TensorRTInferenceEngine::_allocate_buffers()
         {
             _input_dims.emplace_back(dims);
             _input_idx = i;
+            _max_batch_size = static_cast<int>(dims.d[0]);
+            if (!_cuda_succeeded(
+                        cudaMallocHost(reinterpret_cast<void **>(&_host_input),
+                                       total_size),
+                        "cudaMallocHost"))
+            {
+                _host_input = nullptr;
+                _free_buffers();
+                return false;
+            }
 
 #if NVINFER_MAJOR == 8 && NVINFER_MINOR <= 5
             _logger->log(nvinfer1::ILogger::Severity::kINFO,
@@ -218,6 +501,17 @@ void inference_backend::TensorRTInferenceEngine::_allocate_buffers()
             _output_idx.emplace_back(i);
             ++output_idx;
 
+            float *host_output = nullptr;
+            if (!_cuda_succeeded(
+                        cudaMallocHost(reinterpret_cast<void **>(&host_output),
+                                       total_size),
+                        "cudaMallocHost"))
+            {
+                _free_buffers();
+                return false;
+            }
+            _host_outputs.emplace_back(host_output);
+
 #if NVINFER_MAJOR == 8 && NVINFER_MINOR <= 5
             _logger->log(nvinfer1::ILogger::Severity::kINFO,
                          std::string("Found output layer with name: ")
@@ -236,44 +530,39 @@ void inference_backend::TensorRTInferenceEngine::_allocate_buffers()
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
                      std::string("Input layer not found").c_str());
-        return;
+        _free_buffers();
+        return false;
     }
     if (_output_dims.empty())
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
                      std::string("Output layer not found").c_str());
-        return;
+        _free_buffers();
+        return false;
     }
+    return true;
 }
 
-#include <fstream>
 bool inference_backend::TensorRTInferenceEngine::_deserialize_engine(
         const std::string &engine_path)
 {
     // Reference: https://docs.nvidia.com/deeplearning/tensorrt/developer-guide/index.html#perform_inference_c
-    std::ifstream engine_file(engine_path, std::ios::binary);
-    if (!engine_file)
+    // The plan is deserialized straight from the page cache, without copying the file to the heap
+    MappedFile engine_file(engine_path);
+    if (!engine_file.data())
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
                      std::string("Failed to open engine file").c_str());
         return false;
     }
 
-    // Read engine file
-    std::vector<char> trt_model_stream;
-    size_t size{0};
-    engine_file.seekg(0, std::ios::end);
-    size = engine_file.tellg();
-    engine_file.seekg(0, std::ios::beg);
-    trt_model_stream.resize(size);
-    engine_file.read(trt_model_stream.data(), size);
-    engine_file.close();
-
-    // Deserialize engine
-    std::unique_ptr<nvinfer1::IRuntime> runtime{
-            nvinfer1::createInferRuntime(*_logger)};
-    _engine = makeUnique(runtime->deserializeCudaEngine(
-            trt_model_stream.data(), trt_model_stream.size()));
+    // Deserialize engine, the runtime must outlive the engine
+    _context.reset();
+    _engine.reset();
+    if (!_runtime)
+        _runtime = makeUnique(nvinfer1::createInferRuntime(*_logger));
+    _engine = makeUnique(_runtime->deserializeCudaEngine(engine_file.data(),
+                                                         engine_file.size()));
     if (!_engine)
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
@@ -294,8 +583,8 @@ bool inference_backend::TensorRTInferenceEngine::_deserialize_engine(
 }
 
 
-void inference_backend::TensorRTInferenceEngine::_build_engine(
-        const std::string &onnx_model_path)
+bool inference_backend::TensorRTInferenceEngine::_build_engine(
+        const std::string &onnx_model_path, const std::string &engine_path)
 {
     // Reference: https://docs.nvidia.com/deeplearning/tensorrt/developer-guide/index.html#c_topics
     // Network builder
@@ -315,27 +604,41 @@ void inference_backend::TensorRTInferenceEngine::_build_engine(
 
     // Parse ONNX model
     int verbosity = static_cast<int>(_logSeverity);
-    parser->parseFromFile(onnx_model_path.c_str(), verbosity);
+    bool parsed = parser->parseFromFile(onnx_model_path.c_str(), verbosity);
     for (int32_t i = 0; i < parser->getNbErrors(); ++i)
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
                      parser->getError(i)->desc());
     }
+    if (!parsed)
+        return false;
 
     // Optimization profile
-    // TODO: Check more about optimization profiles
+    // A dynamic batch dimension is optimized for (and limited to) batch_size images, any batch
+    // from 1 to batch_size can then be run with the same engine
     auto config = std::unique_ptr<nvinfer1::IBuilderConfig>(
             builder->createBuilderConfig());
     auto profile = builder->createOptimizationProfile();
+    nvinfer1::Dims min_dims = network->getInput(0)->getDimensions();
+    nvinfer1::Dims max_dims = min_dims;
+    if (min_dims.d[0] < 0)
+    {
+        min_dims.d[0] = 1;
+        max_dims.d[0] = std::max(1, _optimization_params.batch_size);
+    }
+    else if (_optimization_params.batch_size > 1)
+    {
+        _logger->log(nvinfer1::ILogger::Severity::kWARNING,
+                     std::string("The ONNX model has a static batch "
+                                 "dimension, batched inference is disabled")
+                             .c_str());
+    }
     profile->setDimensions(network->getInput(0)->getName(),
-                           nvinfer1::OptProfileSelector::kMIN,
-                           network->getInput(0)->getDimensions());
+                           nvinfer1::OptProfileSelector::kMIN, min_dims);
     profile->setDimensions(network->getInput(0)->getName(),
-                           nvinfer1::OptProfileSelector::kOPT,
-                           network->getInput(0)->getDimensions());
+                           nvinfer1::OptProfileSelector::kOPT, max_dims);
     profile->setDimensions(network->getInput(0)->getName(),
-                           nvinfer1::OptProfileSelector::kMAX,
-                           network->getInput(0)->getDimensions());
+                           nvinfer1::OptProfileSelector::kMAX, max_dims);
     config->addOptimizationProfile(profile);
 
     if (_optimization_params.int8)
@@ -362,94 +665,141 @@ void inference_backend::TensorRTInferenceEngine::_build_engine(
 
     std::unique_ptr<nvinfer1::IHostMemory> engine_plan{
             builder->buildSerializedNetwork(*network, *config)};
-    std::unique_ptr<nvinfer1::IRuntime> runtime{
-            nvinfer1::createInferRuntime(*_logger)};
-    std::shared_ptr<nvinfer1::ICudaEngine> engine =
-            std::shared_ptr<nvinfer1::ICudaEngine>(
-                    runtime->deserializeCudaEngine(engine_plan->data(),
-                                                   engine_plan->size()),
-                    TRTDeleter());
-    if (!engine)
+    if (!engine_plan)
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
                      std::string("Failed to build engine").c_str());
-        return;
+        return false;
     }
 
-    // Serialize engine
+    // Save the serialized plan, the file only appears once it is complete
     _logger->log(nvinfer1::ILogger::Severity::kINFO,
-                 std::string("Serializing engine").c_str());
-    std::string engine_path = get_engine_path(onnx_model_path);
-    std::ofstream engine_file(engine_path, std::ios::binary);
-    if (!engine_file)
-    {
-        _logger->log(nvinfer1::ILogger::Severity::kERROR,
-                     std::string("Failed to open engine file").c_str());
-        return;
-    }
-
-    std::unique_ptr<nvinfer1::IHostMemory> serialized_engine{
-            engine->serialize()};
-    if (!serialized_engine)
-    {
-        _logger->log(nvinfer1::ILogger::Severity::kERROR,
-                     std::string("Failed to serialize engine").c_str());
-        return;
-    }
-
-    engine_file.write(reinterpret_cast<const char *>(serialized_engine->data()),
-                      serialized_engine->size());
-    if (engine_file.fail())
+                 std::string("Serializing engine to path: ")
+                         .append(engine_path)
+                         .c_str());
+    if (!write_file_atomic(engine_path, engine_plan->data(),
+                           engine_plan->size()))
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
                      std::string("Failed to write engine file").c_str());
-        return;
+        return false;
     }
 
     _logger->log(nvinfer1::ILogger::Severity::kINFO,
                  std::string("Engine serialized successfully").c_str());
-    engine_file.close();
+    return true;
 }
 
 
 inference_backend::ModelPredictions
 inference_backend::TensorRTInferenceEngine::forward(const cv::Mat &input_image)
+{
+    // Create a blob from the image
+    cv::Mat image_blob;
+    cv::dnn::blobFromImage(input_image, image_blob, 1.0,
+                           cv::Size(_input_dims[0].d[3], _input_dims[0].d[2]),
+                           cv::Scalar(), false, false, CV_32F);
+
+    return forward_batch(image_blob);
+}
+
+
+inference_backend::ModelPredictions
+inference_backend::TensorRTInferenceEngine::forward_batch(
+        const cv::Mat &input_blob)
 {
     // Reference: https://docs.nvidia.com/deeplearning/tensorrt/developer-guide/index.html#perform-inference
 
-    if (!_buffers.size())
+    if (!_buffers.size() || !_host_input)
     {
         _logger->log(nvinfer1::ILogger::Severity::kERROR,
                      std::string("Buffers not allocated").c_str());
         return ModelPredictions();
     }
 
-    // Create a blob from the image
-    cv::Mat image_blob;
-    cv::dnn::blobFromImage(input_image, image_blob, 1.0,
-                           cv::Size(_input_dims[0].d[3], _input_dims[0].d[2]),
-                           cv::Scalar(), false, false, CV_32F);
+    const int batch_size = input_blob.size[0];
+    if (batch_size < 1 || batch_size > _max_batch_size)
+    {
+        _logger->log(nvinfer1::ILogger::Severity::kERROR,
+                     std::string("Invalid batch size: ")
+                             .append(std::to_string(batch_size))
+                             .c_str());
+        return ModelPredictions();
+    }
+
+    // Set the input shape for this batch
+    nvinfer1::Dims input_dims = _input_dims[0];
+    input_dims.d[0] = batch_size;
+    assert(input_blob.total() == get_size_by_dims(input_dims));
 
-    // Ensure image blob size matches input layer size
-    assert(image_blob.total() == get_size_by_dims(_input_dims[0]));
+#if NVINFER_MAJOR == 8 && NVINFER_MINOR <= 5
+    _context->setBindingDimensions(_input_idx, input_dims);
+#else
+    _context->setInputShape(_optimization_params.input_layer_name.c_str(),
+                            input_dims);
+#endif
 
-    // Copy image blob to CUDA input buffer
-    cudaMemcpyAsync(_buffers[_input_idx], image_blob.data,
-                    get_size_by_dims(_input_dims[0], sizeof(float)),
-                    cudaMemcpyHostToDevice);
+    // Stage the image blob in pinned memory, the copy to the CUDA input buffer is then a true asynchronous transfer
+    const size_t input_size = get_size_by_dims(input_dims, sizeof(float));
+    std::memcpy(_host_input, input_blob.data, input_size);
+    if (!_cuda_succeeded(cudaMemcpyAsync(_buffers[_input_idx], _host_input,
+                                         input_size, cudaMemcpyHostToDevice,
+                                         _cuda_stream),
+                         "cudaMemcpyAsync (input)"))
+    {
+        cudaStreamSynchronize(_cuda_stream);
+        return ModelPredictions();
+    }
 
     // Run inference
-    _context->executeV2(_buffers.data());
+#if NVINFER_MAJOR == 8 && NVINFER_MINOR <= 5
+    const bool enqueued =
+            _context->enqueueV2(_buffers.data(), _cuda_stream, nullptr);
+#else
+    const bool enqueued = _context->enqueueV3(_cuda_stream);
+#endif
+    if (!enqueued)
+    {
+        _logger->log(nvinfer1::ILogger::Severity::kERROR,
+                     std::string("Failed to enqueue inference").c_str());
+        cudaStreamSynchronize(_cuda_stream);
+        return ModelPredictions();
+    }
 
-    // Copy CUDA output buffer to host
-    ModelPredictions predictions;
+    // Copy CUDA output buffers to the pinned host buffers, only the rows of this batch
+    std::vector<size_t> output_sizes(_output_idx.size());
     for (size_t i = 0; i < _output_idx.size(); ++i)
     {
-        std::vector<float> output(get_size_by_dims(_output_dims[i]));
-        cudaMemcpyAsync(output.data(), _buffers[_output_idx[i]],
-                        output.size() * sizeof(float), cudaMemcpyDeviceToHost);
-        predictions.emplace_back(output);
+        const size_t sample_size = get_size_by_dims(_output_dims[i]) /
+                                   std::max<int64_t>(1, _output_dims[i].d[0]);
+        output_sizes[i] = sample_size * batch_size;
+        if (!_cuda_succeeded(cudaMemcpyAsync(_host_outputs[i],
+                                             _buffers[_output_idx[i]],
+                                             output_sizes[i] * sizeof(float),
+                                             cudaMemcpyDeviceToHost,
+                                             _cuda_stream),
+                             "cudaMemcpyAsync (output)"))
+        {
+            // The pinned buffers would hold the outputs of a previous batch
+            cudaStreamSynchronize(_cuda_stream);
+            return ModelPredictions();
+        }
     }
 
+    // Wait for the copies only, other work on the device is not waited for
+    if (!_cuda_succeeded(cudaEventRecord(_inference_done, _cuda_stream),
+                         "cudaEventRecord"))
+    {
+        cudaStreamSynchronize(_cuda_stream);
+        return ModelPredictions();
+    }
+    if (!_cuda_succeeded(cudaEventSynchronize(_inference_done),
+                         "Inference (cudaEventSynchronize)"))
+        return ModelPredictions();
+
+    ModelPredictions predictions;
+    predictions.reserve(_output_idx.size());
+    for (size_t i = 0; i < _output_idx.size(); ++i)
+        predictions.emplace_back(_host_outputs[i], output_sizes[i]);
     return predictions;
-}
\ No newline at end of file
+}
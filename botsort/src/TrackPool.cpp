@@ -0,0 +1,79 @@
+#include "TrackPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+TrackPool::TrackPool(int feat_history_size, FeatureFormat feat_history_format,
+                     FeatureFormat appearance_format)
+    : _feat_history_size(feat_history_size),
+      _feat_history_format(feat_history_format),
+      _appearance_format(appearance_format)
+{
+}
+
+
+void TrackPool::recycle()
+{
+    size_t num_live = 0;
+    for (const std::shared_ptr<Track> &track: _tracks)
+        num_live += track.use_count() > 1;
+    const size_t max_free =
+            std::max(MIN_FREE_TRACKS, FREE_TRACKS_PER_LIVE * num_live);
+
+    // Compact the pool, dropping the free tracks beyond max_free
+    _free.clear();
+    size_t size = 0;
+    for (size_t i = 0; i < _tracks.size(); ++i)
+    {
+        if (_tracks[i].use_count() == 1)
+        {
+            if (_free.size() == max_free)
+                continue;
+            _free.push_back(size);
+        }
+        if (size != i)
+            _tracks[size] = std::move(_tracks[i]);
+        ++size;
+    }
+    _tracks.resize(size);
+}
+
+
+std::shared_ptr<Track> TrackPool::acquire(const Detection &detection)
+{
+    if (_free.empty())
+    {
+        std::vector<float> tlwh = {
+                detection.bbox_tlwh.x, detection.bbox_tlwh.y,
+                detection.bbox_tlwh.width, detection.bbox_tlwh.height};
+        _tracks.push_back(std::make_shared<Track>(
+                std::move(tlwh), detection.confidence, detection.class_id,
+                std::nullopt, _feat_history_size, _feat_history_format,
+                _appearance_format));
+        return _tracks.back();
+    }
+
+    const std::shared_ptr<Track> &track = _tracks[_free.back()];
+    _free.pop_back();
+
+    // A free track is referenced by the pool only, nobody sees it being reinitialized
+    assert(track.use_count() == 1);
+    track->reset(detection.bbox_tlwh, detection.confidence,
+                 static_cast<uint8_t>(detection.class_id));
+    return track;
+}
+
+
+size_t TrackPool::memory_footprint() const
+{
+    size_t footprint = sizeof(TrackPool) +
+                       _tracks.capacity() * sizeof(std::shared_ptr<Track>) +
+                       _free.capacity() * sizeof(size_t);
+    for (const std::shared_ptr<Track> &track: _tracks)
+    {
+        if (track.use_count() == 1)
+            footprint += track->memory_footprint();
+    }
+    return footprint;
+}
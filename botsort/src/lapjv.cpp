@@ -10,10 +10,9 @@
 /** Column-reduction and reduction transfer for a dense cost matrix.
  */
 int_t _ccrrt_dense(const uint_t n, cost_t *cost[], int_t *free_rows, int_t *x,
-                   int_t *y, cost_t *v)
+                   int_t *y, cost_t *v, boolean *unique)
 {
     int_t n_free_rows;
-    boolean *unique;
 
     for (uint_t i = 0; i < n; i++)
     {
@@ -37,7 +36,6 @@ int_t _ccrrt_dense(const uint_t n, cost_t *cost[], int_t *free_rows, int_t *x,
     }
     PRINT_COST_ARRAY(v, n);
     PRINT_INDEX_ARRAY(y, n);
-    NEW(unique, boolean, n);
     memset(unique, TRUE, n);
     {
         int_t j = n;
@@ -70,7 +68,6 @@ int_t _ccrrt_dense(const uint_t n, cost_t *cost[], int_t *free_rows, int_t *x,
             v[j] -= min;
         }
     }
-    FREE(unique);
     return n_free_rows;
 }
 
@@ -224,16 +221,11 @@ int_t _scan_dense(const uint_t n, cost_t *cost[], uint_t *plo, uint_t *phi,
  * \return The closest free column index.
  */
 int_t find_path_dense(const uint_t n, cost_t *cost[], const int_t start_i,
-                      int_t *y, cost_t *v, int_t *pred)
+                      int_t *y, cost_t *v, int_t *pred, int_t *cols, cost_t *d)
 {
     uint_t lo = 0, hi = 0;
     int_t final_j = -1;
     uint_t n_ready = 0;
-    int_t *cols;
-    cost_t *d;
-
-    NEW(cols, int_t, n);
-    NEW(d, cost_t, n);
 
     for (uint_t i = 0; i < n; i++)
     {
@@ -279,9 +271,6 @@ int_t find_path_dense(const uint_t n, cost_t *cost[], const int_t start_i,
         }
     }
 
-    FREE(cols);
-    FREE(d);
-
     return final_j;
 }
 
@@ -289,12 +278,9 @@ int_t find_path_dense(const uint_t n, cost_t *cost[], const int_t start_i,
 /** Augment for a dense cost matrix.
  */
 int_t _ca_dense(const uint_t n, cost_t *cost[], const uint_t n_free_rows,
-                int_t *free_rows, int_t *x, int_t *y, cost_t *v)
+                int_t *free_rows, int_t *x, int_t *y, cost_t *v, int_t *pred,
+                int_t *cols, cost_t *d)
 {
-    int_t *pred;
-
-    NEW(pred, int_t, n);
-
     for (int_t *pfree_i = free_rows; pfree_i < free_rows + n_free_rows;
          pfree_i++)
     {
@@ -302,7 +288,7 @@ int_t _ca_dense(const uint_t n, cost_t *cost[], const uint_t n_free_rows,
         uint_t k = 0;
 
         PRINTF("looking at free_i=%d\n", *pfree_i);
-        j = find_path_dense(n, cost, *pfree_i, y, v, pred);
+        j = find_path_dense(n, cost, *pfree_i, y, v, pred, cols, d);
         ASSERT(j >= 0);
         ASSERT(j < n);
         while (i != *pfree_i)
@@ -318,30 +304,58 @@ int_t _ca_dense(const uint_t n, cost_t *cost[], const uint_t n_free_rows,
             if (k >= n) { ASSERT(FALSE); }
         }
     }
-    FREE(pred);
     return 0;
 }
 
 
-/** Solve dense sparse LAP.
+/** Solve dense sparse LAP on preallocated scratch arrays.
  */
-int lapjv_internal(const uint_t n, cost_t *cost[], int_t *x, int_t *y)
+int lapjv_internal_workspace(const uint_t n, cost_t *cost[], int_t *x,
+                             int_t *y, lapjv_workspace *workspace)
 {
     int ret;
-    int_t *free_rows;
-    cost_t *v;
+    int_t *free_rows = workspace->free_rows;
+    cost_t *v = workspace->v;
 
-    NEW(free_rows, int_t, n);
-    NEW(v, cost_t, n);
-    ret = _ccrrt_dense(n, cost, free_rows, x, y, v);
+    ret = _ccrrt_dense(n, cost, free_rows, x, y, v, workspace->unique);
     int i = 0;
     while (ret > 0 && i < 2)
     {
         ret = _carr_dense(n, cost, ret, free_rows, x, y, v);
         i++;
     }
-    if (ret > 0) { ret = _ca_dense(n, cost, ret, free_rows, x, y, v); }
-    FREE(v);
-    FREE(free_rows);
+    if (ret > 0)
+    {
+        ret = _ca_dense(n, cost, ret, free_rows, x, y, v, workspace->pred,
+                        workspace->cols, workspace->d);
+    }
+    return ret;
+}
+
+
+/** Solve dense sparse LAP.
+ */
+int lapjv_internal(const uint_t n, cost_t *cost[], int_t *x, int_t *y)
+{
+    int ret = -1;
+    lapjv_workspace workspace;
+
+    workspace.free_rows = (int_t *) malloc(sizeof(int_t) * n);
+    workspace.pred = (int_t *) malloc(sizeof(int_t) * n);
+    workspace.cols = (int_t *) malloc(sizeof(int_t) * n);
+    workspace.v = (cost_t *) malloc(sizeof(cost_t) * n);
+    workspace.d = (cost_t *) malloc(sizeof(cost_t) * n);
+    workspace.unique = (boolean *) malloc(sizeof(boolean) * n);
+    if (workspace.free_rows && workspace.pred && workspace.cols &&
+        workspace.v && workspace.d && workspace.unique)
+    {
+        ret = lapjv_internal_workspace(n, cost, x, y, &workspace);
+    }
+    FREE(workspace.unique);
+    FREE(workspace.d);
+    FREE(workspace.v);
+    FREE(workspace.cols);
+    FREE(workspace.pred);
+    FREE(workspace.free_rows);
     return ret;
-}
\ No newline at end of file
+}
@@ -1,72 +1,115 @@
 #include "matching.h"
 
+#include <cmath>
+
 #include "DataType.h"
+#include "FeatureQuantization.h"
 #include "utils.h"
 
 std::tuple<CostMatrix, CostMatrix>
 iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
              const std::vector<std::shared_ptr<Track>> &detections,
              float max_iou_distance)
+{
+    CostMatrix cost_matrix(static_cast<Eigen::Index>(tracks.size()),
+                           static_cast<Eigen::Index>(detections.size()));
+    CostMatrix iou_dists_mask(cost_matrix.rows(), cost_matrix.cols());
+    iou_distance(tracks, detections, max_iou_distance, cost_matrix,
+                 iou_dists_mask);
+    return {cost_matrix, iou_dists_mask};
+}
+
+void iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
+                  const std::vector<std::shared_ptr<Track>> &detections,
+                  float max_iou_distance, Eigen::Ref<CostMatrix> cost_matrix,
+                  Eigen::Ref<CostMatrix> iou_dists_mask)
 {
     size_t num_tracks = tracks.size();
     size_t num_detections = detections.size();
 
-    CostMatrix cost_matrix =
-            Eigen::MatrixXf::Zero(static_cast<Eigen::Index>(num_tracks),
-                                  static_cast<Eigen::Index>(num_detections));
-    CostMatrix iou_dists_mask =
-            Eigen::MatrixXf::Zero(static_cast<Eigen::Index>(num_tracks),
-                                  static_cast<Eigen::Index>(num_detections));
-
-    if (num_tracks > 0 && num_detections > 0)
+    for (int i = 0; i < num_tracks; i++)
     {
-        for (int i = 0; i < num_tracks; i++)
+        const std::vector<float> &track_tlwh = tracks[i]->get_tlwh();
+        for (int j = 0; j < num_detections; j++)
         {
-            for (int j = 0; j < num_detections; j++)
-            {
-                cost_matrix(i, j) = 1.0F - iou(tracks[i]->get_tlwh(),
-                                               detections[j]->get_tlwh());
-
-                if (cost_matrix(i, j) > max_iou_distance)
-                {
-                    iou_dists_mask(i, j) = 1.0F;
-                }
-            }
+            cost_matrix(i, j) =
+                    1.0F - iou(track_tlwh, detections[j]->get_tlwh());
+            iou_dists_mask(i, j) =
+                    cost_matrix(i, j) > max_iou_distance ? 1.0F : 0.0F;
         }
     }
-
-    return {cost_matrix, iou_dists_mask};
 }
 
 CostMatrix iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
                         const std::vector<std::shared_ptr<Track>> &detections)
+{
+    CostMatrix cost_matrix(static_cast<Eigen::Index>(tracks.size()),
+                           static_cast<Eigen::Index>(detections.size()));
+    iou_distance(tracks, detections, cost_matrix);
+    return cost_matrix;
+}
+
+void iou_distance(const std::vector<std::shared_ptr<Track>> &tracks,
+                  const std::vector<std::shared_ptr<Track>> &detections,
+                  Eigen::Ref<CostMatrix> cost_matrix)
 {
     size_t num_tracks = tracks.size();
     size_t num_detections = detections.size();
 
-    CostMatrix cost_matrix =
-            Eigen::MatrixXf::Zero(static_cast<Eigen::Index>(num_tracks),
-                                  static_cast<Eigen::Index>(num_detections));
-    if (num_tracks > 0 && num_detections > 0)
+    for (int i = 0; i < num_tracks; i++)
     {
-        for (int i = 0; i < num_tracks; i++)
+        const std::vector<float> &track_tlwh = tracks[i]->get_tlwh();
+        for (int j = 0; j < num_detections; j++)
         {
-            for (int j = 0; j < num_detections; j++)
-            {
-                cost_matrix(i, j) = 1.0F - iou(tracks[i]->get_tlwh(),
-                                               detections[j]->get_tlwh());
-            }
+            cost_matrix(i, j) =
+                    1.0F - iou(track_tlwh, detections[j]->get_tlwh());
         }
     }
+}
 
-    return cost_matrix;
+namespace
+{
+/**
+ * @brief Feature of a track in the given quantized format: the copy kept by the track if it is in
+ *  this format, otherwise encoded into buffer (track created with another appearance format)
+ */
+EncodedFeature encoded_feature(const Track &track, bool smooth,
+                               FeatureFormat format, uint8_t *buffer)
+{
+    if (track.get_appearance_format() == format)
+        return smooth ? track.get_encoded_smooth_feat()
+                      : track.get_encoded_curr_feat();
+
+    encode_feature(smooth ? track.get_smooth_feat() : track.get_curr_feat(),
+                   format, buffer);
+    return {buffer, encoded_dot(buffer, buffer, format)};
 }
+}// namespace
+
 
 std::tuple<CostMatrix, CostMatrix>
 embedding_distance(const std::vector<std::shared_ptr<Track>> &tracks,
                    const std::vector<std::shared_ptr<Track>> &detections,
                    float max_embedding_distance,
-                   const std::string &distance_metric)
+                   const std::string &distance_metric,
+                   FeatureFormat feature_format)
+{
+    CostMatrix cost_matrix(static_cast<Eigen::Index>(tracks.size()),
+                           static_cast<Eigen::Index>(detections.size()));
+    CostMatrix embedding_dists_mask(cost_matrix.rows(), cost_matrix.cols());
+    embedding_distance(tracks, detections, max_embedding_distance,
+                       distance_metric, feature_format, cost_matrix,
+                       embedding_dists_mask);
+    return {cost_matrix, embedding_dists_mask};
+}
+
+void embedding_distance(const std::vector<std::shared_ptr<Track>> &tracks,
+                        const std::vector<std::shared_ptr<Track>> &detections,
+                        float max_embedding_distance,
+                        const std::string &distance_metric,
+                        FeatureFormat feature_format,
+                        Eigen::Ref<CostMatrix> cost_matrix,
+                        Eigen::Ref<CostMatrix> embedding_dists_mask)
 {
     if (!(distance_metric == "euclidean" || distance_metric == "cosine"))
     {
@@ -80,40 +123,70 @@ embedding_distance(const std::vector<std::shared_ptr<Track>> &tracks,
     size_t num_tracks = tracks.size();
     size_t num_detections = detections.size();
 
-    CostMatrix cost_matrix =
-            Eigen::MatrixXf::Zero(static_cast<Eigen::Index>(num_tracks),
-                                  static_cast<Eigen::Index>(num_detections));
-    CostMatrix embedding_dists_mask =
-            Eigen::MatrixXf::Zero(static_cast<Eigen::Index>(num_tracks),
-                                  static_cast<Eigen::Index>(num_detections));
+    const bool euclidean = distance_metric == "euclidean";
+    const bool quantized = feature_format != FeatureFormat::Float32;
 
-    if (num_tracks > 0 && num_detections > 0)
+    // Fallback buffers of encoded_feature(), the tracker's tracks keep their encoded features
+    uint8_t track_buffer[FEATURE_DIM * sizeof(float)];
+    uint8_t det_buffer[FEATURE_DIM * sizeof(float)];
+
+    for (int i = 0; i < num_tracks; i++)
     {
-        for (int i = 0; i < num_tracks; i++)
+        EncodedFeature track_encoded{};
+        if (quantized && tracks[i]->has_features())
+            track_encoded = encoded_feature(*tracks[i], true, feature_format,
+                                            track_buffer);
+
+        for (int j = 0; j < num_detections; j++)
         {
-            for (int j = 0; j < num_detections; j++)
+            embedding_dists_mask(i, j) = 0.0F;
+
+            // Features are optional with selective re-ID, mask off the pair
+            if (!tracks[i]->has_features() || !detections[j]->has_features())
+            {
+                cost_matrix(i, j) = 1.0F;
+                embedding_dists_mask(i, j) = 1.0F;
+                continue;
+            }
+
+            if (quantized)
             {
-                if (distance_metric == "euclidean")
+                const EncodedFeature det_encoded = encoded_feature(
+                        *detections[j], false, feature_format, det_buffer);
+                const float dot = encoded_dot(
+                        track_encoded.data, det_encoded.data, feature_format);
+                const float sq_norm_a = track_encoded.sq_norm;
+                const float sq_norm_b = det_encoded.sq_norm;
+                if (euclidean)
+                    cost_matrix(i, j) = std::sqrt(
+                            std::max(0.0f, sq_norm_a + sq_norm_b - 2.0f * dot));
+                else
                     cost_matrix(i, j) = std::max(
-                            0.0f, euclidean_distance(tracks[i]->smooth_feat,
-                                                     detections[j]->curr_feat));
+                            0.0f,
+                            1.0f - dot / (std::sqrt(sq_norm_a * sq_norm_b) +
+                                          1e-5f));
+            }
+            else
+            {
+                const FeatureVector &track_feat = tracks[i]->get_smooth_feat();
+                const FeatureVector &det_feat = detections[j]->get_curr_feat();
+                if (euclidean)
+                    cost_matrix(i, j) = std::max(
+                            0.0f, euclidean_distance(track_feat, det_feat));
                 else
                     cost_matrix(i, j) = std::max(
-                            0.0f, cosine_distance(tracks[i]->smooth_feat,
-                                                  detections[j]->curr_feat));
+                            0.0f, cosine_distance(track_feat, det_feat));
+            }
 
-                if (cost_matrix(i, j) > max_embedding_distance)
-                {
-                    embedding_dists_mask(i, j) = 1.0F;
-                }
+            if (cost_matrix(i, j) > max_embedding_distance)
+            {
+                embedding_dists_mask(i, j) = 1.0F;
             }
         }
     }
-
-    return {cost_matrix, embedding_dists_mask};
 }
 
-void fuse_score(CostMatrix &cost_matrix,
+void fuse_score(Eigen::Ref<CostMatrix> cost_matrix,
                 const std::vector<std::shared_ptr<Track>> &detections)
 {
     if (cost_matrix.rows() == 0 || cost_matrix.cols() == 0)
@@ -131,10 +204,21 @@ void fuse_score(CostMatrix &cost_matrix,
     }
 }
 
-void fuse_motion(const KalmanFilter &KF, CostMatrix &cost_matrix,
+void fuse_motion(const KalmanFilter &KF, Eigen::Ref<CostMatrix> cost_matrix,
                  const std::vector<std::shared_ptr<Track>> &tracks,
                  const std::vector<std::shared_ptr<Track>> &detections,
                  float lambda, bool only_position)
+{
+    FrameArena arena(FrameArena::array_bytes<DetVec>(detections.size()) +
+                     FrameArena::array_bytes<float>(detections.size()));
+    fuse_motion(KF, cost_matrix, tracks, detections, arena, lambda,
+                only_position);
+}
+
+void fuse_motion(const KalmanFilter &KF, Eigen::Ref<CostMatrix> cost_matrix,
+                 const std::vector<std::shared_ptr<Track>> &tracks,
+                 const std::vector<std::shared_ptr<Track>> &detections,
+                 FrameArena &arena, float lambda, bool only_position)
 {
     if (cost_matrix.rows() == 0 || cost_matrix.cols() == 0)
     {
@@ -144,24 +228,24 @@ void fuse_motion(const KalmanFilter &KF, CostMatrix &cost_matrix,
     uint8_t gating_dim = only_position ? 2 : 4;
     const double gating_threshold = KalmanFilter::chi2inv95[gating_dim];
 
-    std::vector<DetVec> measurements;
-    std::vector<float> det_xywh;
-    for (const std::shared_ptr<Track> &detection: detections)
+    const size_t num_detections = detections.size();
+    DetVec *measurements = arena.allocate_array<DetVec>(num_detections);
+    for (size_t j = 0; j < num_detections; j++)
     {
-        DetVec det;
-
-        det_xywh = detection->get_tlwh();
-        det << det_xywh[0], det_xywh[1], det_xywh[2], det_xywh[3];
-        measurements.emplace_back(det);
+        const std::vector<float> &det_xywh = detections[j]->get_tlwh();
+        measurements[j] << det_xywh[0], det_xywh[1], det_xywh[2], det_xywh[3];
     }
+    Eigen::Map<Eigen::Matrix<float, 1, Eigen::Dynamic>> gating_distance(
+            arena.allocate_array<float>(num_detections),
+            static_cast<Eigen::Index>(num_detections));
 
     for (Eigen::Index i = 0; i < tracks.size(); i++)
     {
-        Eigen::Matrix<float, 1, Eigen::Dynamic> gating_distance =
-                KF.gating_distance(tracks[i]->mean, tracks[i]->covariance,
-                                   measurements, only_position);
+        KF.gating_distance(tracks[i]->mean, tracks[i]->covariance,
+                           measurements, num_detections, gating_distance,
+                           only_position);
 
-        for (Eigen::Index j = 0; j < gating_distance.size(); j++)
+        for (Eigen::Index j = 0; j < cost_matrix.cols(); j++)
         {
             if (gating_distance(0, j) > gating_threshold)
             {
@@ -178,6 +262,17 @@ CostMatrix fuse_iou_with_emb(CostMatrix &iou_dist, CostMatrix &emb_dist,
                              const CostMatrix &iou_dists_mask,
                              const CostMatrix &emb_dists_mask)
 {
+    CostMatrix cost_matrix = iou_dist;
+    fuse_iou_with_emb_inplace(cost_matrix, emb_dist, iou_dists_mask,
+                              emb_dists_mask);
+    return cost_matrix;
+}
+
+void fuse_iou_with_emb_inplace(
+        Eigen::Ref<CostMatrix> iou_dist, Eigen::Ref<CostMatrix> emb_dist,
+        const Eigen::Ref<const CostMatrix> &iou_dists_mask,
+        const Eigen::Ref<const CostMatrix> &emb_dists_mask)
+{
 
     if (emb_dist.rows() == 0 || emb_dist.cols() == 0)
     {
@@ -192,7 +287,7 @@ CostMatrix fuse_iou_with_emb(CostMatrix &iou_dist, CostMatrix &emb_dist,
                 }
             }
         }
-        return iou_dist;
+        return;
     }
 
     // If IoU distance is larger than threshold, don't use embedding at all
@@ -220,24 +315,40 @@ CostMatrix fuse_iou_with_emb(CostMatrix &iou_dist, CostMatrix &emb_dist,
     }
 
     // Fuse iou and emb distance by taking the element-wise minimum
-    CostMatrix cost_matrix =
-            Eigen::MatrixXf::Zero(iou_dist.rows(), iou_dist.cols());
     for (Eigen::Index i = 0; i < iou_dist.rows(); i++)
     {
         for (Eigen::Index j = 0; j < iou_dist.cols(); j++)
         {
-            cost_matrix(i, j) = std::min(iou_dist(i, j), emb_dist(i, j));
+            iou_dist(i, j) = std::min(iou_dist(i, j), emb_dist(i, j));
         }
     }
-
-    return cost_matrix;
 }
 
 AssociationData linear_assignment(CostMatrix &cost_matrix, float thresh)
 {
-    // If cost matrix is empty, all the tracks and detections are unmatched
     AssociationData associations;
 
+    // Arena sized for this problem, an empty cost matrix is not solved
+    size_t arena_bytes = 0;
+    if (cost_matrix.size() > 0)
+        arena_bytes = FrameArena::array_bytes<int>(cost_matrix.rows()) +
+                      FrameArena::array_bytes<int>(cost_matrix.cols()) +
+                      lapjv_arena_bytes(cost_matrix.rows(), cost_matrix.cols(),
+                                        true, thresh);
+    FrameArena arena(arena_bytes);
+    linear_assignment(cost_matrix, thresh, arena, associations);
+    return associations;
+}
+
+void linear_assignment(const Eigen::Ref<const CostMatrix> &cost_matrix,
+                       float thresh, FrameArena &arena,
+                       AssociationData &associations)
+{
+    associations.matches.clear();
+    associations.unmatched_track_indices.clear();
+    associations.unmatched_det_indices.clear();
+
+    // If cost matrix is empty, all the tracks and detections are unmatched
     if (cost_matrix.size() == 0)
     {
         for (int i = 0; i < cost_matrix.rows(); i++)
@@ -250,13 +361,16 @@ AssociationData linear_assignment(CostMatrix &cost_matrix, float thresh)
             associations.unmatched_det_indices.emplace_back(i);
         }
 
-        return associations;
+        return;
     }
 
-    std::vector<int> rowsol, colsol;
-    double total_cost = lapjv(cost_matrix, rowsol, colsol, true, thresh);
+    const int num_rows = static_cast<int>(cost_matrix.rows());
+    const int num_cols = static_cast<int>(cost_matrix.cols());
+    int *rowsol = arena.allocate_array<int>(num_rows);
+    int *colsol = arena.allocate_array<int>(num_cols);
+    lapjv(cost_matrix, rowsol, colsol, arena, true, thresh);
 
-    for (int i = 0; i < rowsol.size(); i++)
+    for (int i = 0; i < num_rows; i++)
     {
         if (rowsol[i] >= 0)
         {
@@ -268,13 +382,11 @@ AssociationData linear_assignment(CostMatrix &cost_matrix, float thresh)
         }
     }
 
-    for (int i = 0; i < colsol.size(); i++)
+    for (int i = 0; i < num_cols; i++)
     {
         if (colsol[i] < 0)
         {
             associations.unmatched_det_indices.emplace_back(i);
         }
     }
-
-    return associations;
-}
\ No newline at end of file
+}
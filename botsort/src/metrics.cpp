@@ -0,0 +1,416 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+constexpr int POLL_INTERVAL_MS = 100;
+constexpr size_t MAX_REQUEST_SIZE = 8192;
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+const socket_t INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+
+void close_socket(socket_t socket)
+{
+    closesocket(socket);
+}
+
+int poll_socket(socket_t socket, int timeout_ms)
+{
+    WSAPOLLFD poll_fd{socket, POLLRDNORM, 0};
+    return WSAPoll(&poll_fd, 1, timeout_ms);
+}
+
+/**
+ * @brief Initialize Winsock once per process
+ */
+bool init_sockets()
+{
+    struct WinsockSession
+    {
+        WinsockSession()
+        {
+            WSADATA wsa_data;
+            initialized = WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0;
+        }
+
+        ~WinsockSession()
+        {
+            if (initialized)
+                WSACleanup();
+        }
+
+        bool initialized = false;
+    };
+
+    static WinsockSession session;
+    return session.initialized;
+}
+#else
+using socket_t = int;
+constexpr socket_t INVALID_SOCKET_HANDLE = -1;
+
+void close_socket(socket_t socket)
+{
+    close(socket);
+}
+
+int poll_socket(socket_t socket, int timeout_ms)
+{
+    pollfd poll_fd{socket, POLLIN, 0};
+    return poll(&poll_fd, 1, timeout_ms);
+}
+
+bool init_sockets()
+{
+    return true;
+}
+#endif
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+
+class FamilyRegistry
+{
+public:
+    static FamilyRegistry &instance()
+    {
+        static FamilyRegistry registry;
+        return registry;
+    }
+
+    void add(const bot_metrics::Family *family)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _families.push_back(family);
+    }
+
+    void remove(const bot_metrics::Family *family)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _families.erase(
+                std::remove(_families.begin(), _families.end(), family),
+                _families.end());
+    }
+
+    void write(std::ostream &os)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const bot_metrics::Family *family: _families)
+            family->write(os);
+    }
+
+
+private:
+    std::mutex _mutex;
+    std::vector<const bot_metrics::Family *> _families;
+};
+
+
+/**
+ * @brief Stage latencies of the profiler as a Prometheus summary
+ */
+void write_stage_latencies(std::ostream &os)
+{
+    const bot_profiler::Snapshot snapshot = bot_profiler::snapshot();
+    if (snapshot.scopes.empty())
+        return;
+
+    const char *name = "botsort_stage_latency_seconds";
+    os << "# HELP " << name
+       << " Latency of the tracker stages since the last profiler reset\n"
+       << "# TYPE " << name << " summary\n";
+    for (const bot_profiler::ScopeStats &scope_stats: snapshot.scopes)
+    {
+        std::ostringstream labels;
+        labels << "stream=\"" << scope_stats.stream_id << "\",stage=\""
+               << scope_stats.name << "\"";
+
+        const std::pair<const char *, double> quantiles[] = {
+                {"0.5", scope_stats.p50_ms},
+                {"0.9", scope_stats.p90_ms},
+                {"0.99", scope_stats.p99_ms},
+                {"0.999", scope_stats.p999_ms},
+        };
+        for (const auto &[quantile, value_ms]: quantiles)
+            os << name << "{" << labels.str() << ",quantile=\"" << quantile
+               << "\"} " << value_ms * 1e-3 << "\n";
+        os << name << "_sum{" << labels.str() << "} "
+           << scope_stats.total_ms * 1e-3 << "\n";
+        os << name << "_count{" << labels.str() << "} " << scope_stats.count
+           << "\n";
+    }
+}
+
+
+bool send_all(socket_t socket, const std::string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        const int result =
+                send(socket, data.data() + sent,
+                     static_cast<int>(data.size() - sent), SEND_FLAGS);
+        if (result <= 0)
+            return false;
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+
+/**
+ * @brief Read the request line and headers, answer and close the connection
+ */
+void handle_request(socket_t client)
+{
+#ifdef _WIN32
+    DWORD timeout_ms = 1000;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO,
+               reinterpret_cast<const char *>(&timeout_ms), sizeof(timeout_ms));
+#else
+    timeval timeout{1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.size() < MAX_REQUEST_SIZE)
+    {
+        const int received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+            break;
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    std::istringstream request_line(request.substr(0, request.find("\r\n")));
+    std::string method, target;
+    request_line >> method >> target;
+    target = target.substr(0, target.find('?'));
+
+    std::string status, content_type = "text/plain; charset=utf-8", body;
+    if (method != "GET" && method != "HEAD")
+    {
+        status = "405 Method Not Allowed";
+        body = "Method not allowed\n";
+    }
+    else if (target == "/metrics")
+    {
+        status = "200 OK";
+        content_type = "text/plain; version=0.0.4; charset=utf-8";
+        body = bot_metrics::expose();
+    }
+    else
+    {
+        status = "404 Not Found";
+        body = "Metrics are served at /metrics\n";
+    }
+
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << "\r\nContent-Type: " << content_type
+             << "\r\nContent-Length: " << body.size()
+             << "\r\nConnection: close\r\n\r\n";
+    if (method != "HEAD")
+        response << body;
+    send_all(client, response.str());
+}
+}// namespace
+
+
+bot_metrics::Family::Family(const char *name, const char *help,
+                            const char *type, const char *label_name,
+                            std::vector<const char *> label_values)
+    : _num_labels(std::max<size_t>(1, label_values.size())), _name(name),
+      _help(help), _type(type), _label_name(label_name),
+      _label_values(std::move(label_values)),
+      _updated(new std::atomic<bool>[MAX_STREAMS * _num_labels])
+{
+    for (size_t i = 0; i < MAX_STREAMS * _num_labels; ++i)
+        _updated[i].store(false, std::memory_order_relaxed);
+    FamilyRegistry::instance().add(this);
+}
+
+
+bot_metrics::Family::~Family()
+{
+    FamilyRegistry::instance().remove(this);
+}
+
+
+void bot_metrics::Family::write(std::ostream &os) const
+{
+    bool header_written = false;
+    for (size_t stream = 0; stream < MAX_STREAMS; ++stream)
+    {
+        for (size_t label = 0; label < _num_labels; ++label)
+        {
+            const size_t index = stream * _num_labels + label;
+            if (!_updated[index].load(std::memory_order_relaxed))
+                continue;
+
+            if (!header_written)
+            {
+                os << "# HELP " << _name << " " << _help << "\n# TYPE "
+                   << _name << " " << _type << "\n";
+                header_written = true;
+            }
+            os << _name << "{stream=\"" << stream << "\"";
+            if (_label_name && label < _label_values.size())
+                os << "," << _label_name << "=\"" << _label_values[label]
+                   << "\"";
+            os << "} ";
+            _write_value(os, index);
+            os << "\n";
+        }
+    }
+}
+
+
+bot_metrics::Counter::Counter(const char *name, const char *help,
+                              const char *label_name,
+                              std::vector<const char *> label_values)
+    : Family(name, help, "counter", label_name, std::move(label_values)),
+      _values(new std::atomic<uint64_t>[MAX_STREAMS * _num_labels])
+{
+    for (size_t i = 0; i < MAX_STREAMS * _num_labels; ++i)
+        _values[i].store(0, std::memory_order_relaxed);
+}
+
+
+void bot_metrics::Counter::_write_value(std::ostream &os, size_t index) const
+{
+    os << _values[index].load(std::memory_order_relaxed);
+}
+
+
+bot_metrics::Gauge::Gauge(const char *name, const char *help,
+                          const char *label_name,
+                          std::vector<const char *> label_values)
+    : Family(name, help, "gauge", label_name, std::move(label_values)),
+      _values(new std::atomic<double>[MAX_STREAMS * _num_labels])
+{
+    for (size_t i = 0; i < MAX_STREAMS * _num_labels; ++i)
+        _values[i].store(0.0, std::memory_order_relaxed);
+}
+
+
+void bot_metrics::Gauge::_write_value(std::ostream &os, size_t index) const
+{
+    os << _values[index].load(std::memory_order_relaxed);
+}
+
+
+std::string bot_metrics::expose()
+{
+    std::ostringstream os;
+    FamilyRegistry::instance().write(os);
+    if (bot_profiler::is_enabled())
+        write_stage_latencies(os);
+    return os.str();
+}
+
+
+bot_metrics::MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+
+bool bot_metrics::MetricsServer::start(uint16_t port,
+                                       const std::string &address)
+{
+    stop();
+    if (!init_sockets())
+        return false;
+
+    sockaddr_in socket_address{};
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1)
+    {
+        std::cout << "Invalid metrics server address " << address
+                  << std::endl;
+        return false;
+    }
+
+    socket_t server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server == INVALID_SOCKET_HANDLE)
+        return false;
+
+    int reuse_address = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR,
+               reinterpret_cast<const char *>(&reuse_address),
+               sizeof(reuse_address));
+    socklen_t address_size = sizeof(socket_address);
+    if (bind(server, reinterpret_cast<sockaddr *>(&socket_address),
+             address_size) != 0 ||
+        listen(server, 8) != 0 ||
+        getsockname(server, reinterpret_cast<sockaddr *>(&socket_address),
+                    &address_size) != 0)
+    {
+        std::cout << "Can't listen on " << address << ":" << port
+                  << std::endl;
+        close_socket(server);
+        return false;
+    }
+
+    _socket = static_cast<intptr_t>(server);
+    _port = ntohs(socket_address.sin_port);
+    _stop = false;
+    _thread = std::thread(&MetricsServer::_serve, this);
+    return true;
+}
+
+
+void bot_metrics::MetricsServer::stop()
+{
+    if (!_thread.joinable())
+        return;
+
+    _stop = true;
+    _thread.join();
+    close_socket(static_cast<socket_t>(_socket));
+    _socket = -1;
+    _port = 0;
+}
+
+
+void bot_metrics::MetricsServer::_serve()
+{
+    const socket_t server = static_cast<socket_t>(_socket);
+    while (!_stop)
+    {
+        // Wake up periodically to check for stop()
+        if (poll_socket(server, POLL_INTERVAL_MS) <= 0)
+            continue;
+
+        const socket_t client = accept(server, nullptr, nullptr);
+        if (client == INVALID_SOCKET_HANDLE)
+            continue;
+        handle_request(client);
+        close_socket(client);
+    }
+}
@@ -0,0 +1,644 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+
+namespace
+{
+constexpr auto COLLECT_INTERVAL = std::chrono::milliseconds(10);
+
+
+struct Event
+{
+    uint64_t start, end;
+    bot_profiler::ScopeId scope_id;
+    bot_profiler::StreamId stream_id;
+    uint32_t frame_id;
+    uint32_t count;
+    uint32_t allocations;
+};
+
+
+/**
+ * @brief Ring buffer of the events of one thread
+ *  Single producer (the owner thread) and single consumer (the collector): the owner only writes head,
+ *  the collector only writes tail, so neither of them ever waits for the other.
+ */
+struct ThreadBuffer
+{
+    static constexpr uint64_t CAPACITY = 1 << 13;
+
+    std::array<Event, CAPACITY> events;
+    std::atomic<uint64_t> head{0};///< Next event written by the owner thread
+    std::atomic<uint64_t> tail{0};///< Next event read by the collector
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};///< The owner thread exited
+    uint32_t thread_index = 0;       ///< Trace thread ID, in creation order
+
+    /**
+     * @brief The owner thread exited and all its events were collected
+     */
+    bool released() const
+    {
+        return retired.load(std::memory_order_acquire) &&
+               tail.load(std::memory_order_relaxed) ==
+                       head.load(std::memory_order_acquire);
+    }
+};
+
+
+/**
+ * @brief Writer of the events to a Chrome trace-event JSON file (JSON array format)
+ */
+class TraceWriter
+{
+public:
+    bool open(const std::string &filepath)
+    {
+        _file.open(filepath, std::ios::out | std::ios::trunc);
+        if (!_file.is_open())
+            return false;
+
+        _file << std::fixed << std::setprecision(3) << "[";
+        _first_event = true;
+        _named_streams.clear();
+        _named_threads.clear();
+        return true;
+    }
+
+    bool is_open() const
+    {
+        return _file.is_open();
+    }
+
+    /**
+     * @brief Write a complete event, timestamps in microseconds since the start of the tracing
+     */
+    void write(const char *name, const Event &event, uint32_t thread_index,
+               double start_us, double duration_us)
+    {
+        if (_named_streams.insert(event.stream_id).second)
+        {
+            _begin_event();
+            _file << R"({"name":"process_name","ph":"M","pid":)"
+                  << event.stream_id << R"(,"args":{"name":"stream )"
+                  << event.stream_id << R"("}})";
+        }
+        if (_named_threads.insert({event.stream_id, thread_index}).second)
+        {
+            _begin_event();
+            _file << R"({"name":"thread_name","ph":"M","pid":)"
+                  << event.stream_id << R"(,"tid":)" << thread_index
+                  << R"(,"args":{"name":"thread )" << thread_index
+                  << R"("}})";
+        }
+
+        _begin_event();
+        _file << R"({"name":")";
+        _write_escaped(name);
+        _file << R"(","cat":"botsort","ph":"X","ts":)" << start_us
+              << R"(,"dur":)" << duration_us << R"(,"pid":)"
+              << event.stream_id << R"(,"tid":)" << thread_index
+              << R"(,"args":{"frame":)" << event.frame_id
+              << R"(,"objects":)" << event.count;
+        if (bot_profiler::is_counting_allocations())
+            _file << R"(,"allocations":)" << event.allocations;
+        _file << "}}";
+    }
+
+    void flush()
+    {
+        _file.flush();
+    }
+
+    void close()
+    {
+        if (!_file.is_open())
+            return;
+        _file << "\n]\n";
+        _file.close();
+    }
+
+
+private:
+    void _begin_event()
+    {
+        _file << (_first_event ? "\n" : ",\n");
+        _first_event = false;
+    }
+
+    void _write_escaped(const char *text)
+    {
+        for (; *text; ++text)
+        {
+            if (*text == '"' || *text == '\\')
+                _file << '\\';
+            _file << *text;
+        }
+    }
+
+
+private:
+    std::ofstream _file;
+    bool _first_event = true;
+    std::set<bot_profiler::StreamId> _named_streams;
+    std::set<std::pair<bot_profiler::StreamId, uint32_t>> _named_threads;
+};
+
+
+class Registry
+{
+public:
+    static Registry &instance()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    ~Registry()
+    {
+        _stop_collector();
+        stop_trace();
+    }
+
+    bot_profiler::ScopeId register_scope(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(_scopes_mutex);
+        for (size_t i = 0; i < _num_scopes; ++i)
+        {
+            if (std::strcmp(_scope_names[i].load(std::memory_order_relaxed),
+                            name) == 0)
+                return static_cast<bot_profiler::ScopeId>(i);
+        }
+
+        // The last ID has its own slot, it collects the scopes registered past the limit
+        constexpr size_t other_scopes = bot_profiler::MAX_SCOPES - 1;
+        if (_num_scopes > other_scopes)
+            return static_cast<bot_profiler::ScopeId>(other_scopes);
+        if (_num_scopes == other_scopes)
+            name = "(other scopes)";
+
+        _scope_names[_num_scopes].store(name, std::memory_order_release);
+        return static_cast<bot_profiler::ScopeId>(_num_scopes++);
+    }
+
+    const char *scope_name(bot_profiler::ScopeId scope_id) const
+    {
+        const char *name =
+                _scope_names[scope_id].load(std::memory_order_acquire);
+        return name ? name : "";
+    }
+
+    void set_enabled(bool enabled)
+    {
+        bot_profiler::detail::enabled.store(enabled,
+                                            std::memory_order_relaxed);
+        if (enabled)
+            _start_collector();
+        else
+            _stop_collector();
+    }
+
+    ThreadBuffer *add_thread_buffer()
+    {
+        std::lock_guard<std::mutex> lock(_buffers_mutex);
+        _buffers.emplace_back(std::make_unique<ThreadBuffer>());
+        _buffers.back()->thread_index = _num_threads++;
+        return _buffers.back().get();
+    }
+
+    void collect()
+    {
+        std::lock_guard<std::mutex> lock(_collect_mutex);
+        _update_calibration();
+
+        std::vector<ThreadBuffer *> buffers;
+        {
+            std::lock_guard<std::mutex> buffers_lock(_buffers_mutex);
+            for (const std::unique_ptr<ThreadBuffer> &buffer: _buffers)
+                buffers.push_back(buffer.get());
+        }
+
+        for (ThreadBuffer *buffer: buffers)
+        {
+            const uint64_t head = buffer->head.load(std::memory_order_acquire);
+            for (uint64_t i = buffer->tail.load(std::memory_order_relaxed);
+                 i < head; ++i)
+            {
+                const Event &event =
+                        buffer->events[i & (ThreadBuffer::CAPACITY - 1)];
+                const uint64_t duration =
+                        event.end > event.start ? event.end - event.start : 0;
+                _histograms[{event.stream_id, event.scope_id}].record(
+                        duration);
+                if (event.allocations)
+                    _allocations[{event.stream_id, event.scope_id}] +=
+                            event.allocations;
+
+                if (_trace.is_open())
+                {
+                    const uint64_t start = event.start > _tsc_origin
+                                                   ? event.start - _tsc_origin
+                                                   : 0;
+                    _trace.write(scope_name(event.scope_id), event,
+                                 buffer->thread_index,
+                                 ticks_to_ns(start) * 1e-3,
+                                 ticks_to_ns(duration) * 1e-3);
+                }
+            }
+            buffer->tail.store(head, std::memory_order_release);
+            _dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+        }
+
+        if (_trace.is_open())
+            _trace.flush();
+
+        // Free the buffers of the threads that exited once they are drained
+        std::lock_guard<std::mutex> buffers_lock(_buffers_mutex);
+        _buffers.erase(std::remove_if(_buffers.begin(), _buffers.end(),
+                                      [](const auto &buffer) {
+                                          return buffer->released();
+                                      }),
+                       _buffers.end());
+    }
+
+    bot_profiler::Snapshot snapshot(bool reset_after)
+    {
+        collect();
+
+        std::lock_guard<std::mutex> lock(_collect_mutex);
+        bot_profiler::Snapshot snapshot;
+        for (const auto &[key, histogram]: _histograms)
+        {
+            if (histogram.count() == 0)
+                continue;
+
+            auto to_ms = [this](uint64_t ticks) {
+                return ticks_to_ns(ticks) * 1e-6;
+            };
+            bot_profiler::ScopeStats scope_stats;
+            scope_stats.stream_id = key.first;
+            scope_stats.scope_id = key.second;
+            scope_stats.name = scope_name(key.second);
+            scope_stats.count = histogram.count();
+            scope_stats.total_ms = to_ms(histogram.total());
+            scope_stats.min_ms = to_ms(histogram.min());
+            scope_stats.max_ms = to_ms(histogram.max());
+            scope_stats.p50_ms = to_ms(histogram.value_at_percentile(50.0));
+            scope_stats.p90_ms = to_ms(histogram.value_at_percentile(90.0));
+            scope_stats.p99_ms = to_ms(histogram.value_at_percentile(99.0));
+            scope_stats.p999_ms = to_ms(histogram.value_at_percentile(99.9));
+            auto allocations = _allocations.find(key);
+            if (allocations != _allocations.end())
+                scope_stats.allocations = allocations->second;
+            snapshot.scopes.push_back(scope_stats);
+        }
+        snapshot.dropped_events = _dropped;
+        snapshot.interval_s = std::chrono::duration<double>(
+                                      std::chrono::steady_clock::now() -
+                                      _interval_start)
+                                      .count();
+
+        if (reset_after)
+            _reset();
+        return snapshot;
+    }
+
+    uint64_t dropped_events()
+    {
+        std::lock_guard<std::mutex> lock(_collect_mutex);
+        return _dropped;
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(_collect_mutex);
+        _reset();
+    }
+
+    bool start_trace(const std::string &filepath)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_collect_mutex);
+            _trace.close();
+            if (!_trace.open(filepath))
+                return false;
+        }
+        set_enabled(true);
+        return true;
+    }
+
+    void stop_trace()
+    {
+        collect();
+        std::lock_guard<std::mutex> lock(_collect_mutex);
+        _trace.close();
+    }
+
+    double ticks_to_ns(uint64_t ticks) const
+    {
+        return static_cast<double>(ticks) *
+               _ns_per_tick.load(std::memory_order_relaxed);
+    }
+
+
+private:
+    Registry()
+        : _tsc_origin(bot_profiler::now()),
+          _clock_origin(std::chrono::steady_clock::now()),
+          _interval_start(_clock_origin)
+    {
+        const char *profile_env = std::getenv("BOTSORT_PROFILE");
+        if (profile_env && std::strcmp(profile_env, "1") == 0)
+            set_enabled(true);
+    }
+
+    void _reset()
+    {
+        for (auto &[key, histogram]: _histograms)
+            histogram.clear();
+        _allocations.clear();
+        _dropped = 0;
+        _interval_start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Measure the TSC frequency against steady_clock since the registry was created
+     */
+    void _update_calibration()
+    {
+#ifdef BOT_PROFILER_USE_TSC
+        const uint64_t ticks = bot_profiler::now() - _tsc_origin;
+        const double ns = std::chrono::duration<double, std::nano>(
+                                  std::chrono::steady_clock::now() -
+                                  _clock_origin)
+                                  .count();
+        if (ticks > 0 && ns > 1e6)
+            _ns_per_tick.store(ns / static_cast<double>(ticks),
+                               std::memory_order_relaxed);
+#endif
+    }
+
+    void _start_collector()
+    {
+        std::lock_guard<std::mutex> lock(_collector_mutex);
+        if (_collector.joinable())
+            return;
+
+        _stop = false;
+        _collector = std::thread([this]() {
+            std::unique_lock<std::mutex> collector_lock(_collector_mutex);
+            while (!_collector_cv.wait_for(collector_lock, COLLECT_INTERVAL,
+                                           [this]() { return _stop; }))
+            {
+                collector_lock.unlock();
+                collect();
+                collector_lock.lock();
+            }
+        });
+    }
+
+    void _stop_collector()
+    {
+        std::thread collector;
+        {
+            std::lock_guard<std::mutex> lock(_collector_mutex);
+            _stop = true;
+            collector = std::move(_collector);
+        }
+        _collector_cv.notify_all();
+        if (collector.joinable())
+        {
+            collector.join();
+            collect();
+        }
+    }
+
+
+private:
+    std::mutex _scopes_mutex;
+    std::array<std::atomic<const char *>, bot_profiler::MAX_SCOPES>
+            _scope_names{};
+    size_t _num_scopes = 0;
+
+    std::mutex _buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+    uint32_t _num_threads = 0;
+
+    // Durations (ticks) per stream and scope
+    std::mutex _collect_mutex;
+    std::map<std::pair<bot_profiler::StreamId, bot_profiler::ScopeId>,
+             bot_profiler::LatencyHistogram>
+            _histograms;
+    std::map<std::pair<bot_profiler::StreamId, bot_profiler::ScopeId>,
+             uint64_t>
+            _allocations;
+    uint64_t _dropped = 0;
+    TraceWriter _trace;
+
+    const uint64_t _tsc_origin;
+    const std::chrono::steady_clock::time_point _clock_origin;
+    std::chrono::steady_clock::time_point _interval_start;
+    std::atomic<double> _ns_per_tick{1.0};
+
+    std::mutex _collector_mutex;
+    std::condition_variable _collector_cv;
+    std::thread _collector;
+    bool _stop = false;
+};
+
+
+/**
+ * @brief Buffer of the calling thread, created on its first event and retired when the thread exits
+ */
+struct ThreadBufferHandle
+{
+    ThreadBuffer *buffer = nullptr;
+
+    ~ThreadBufferHandle()
+    {
+        if (buffer)
+            buffer->retired.store(true, std::memory_order_release);
+    }
+};
+
+thread_local ThreadBufferHandle thread_buffer_handle;
+thread_local bot_profiler::StreamId thread_stream_id = 0;
+thread_local uint32_t thread_frame_id = 0;
+thread_local uint64_t thread_allocation_count = 0;
+}// namespace
+
+
+std::atomic<bool> bot_profiler::detail::enabled{false};
+std::atomic<bool> bot_profiler::detail::allocation_counting{false};
+
+
+bot_profiler::ScopeId bot_profiler::register_scope(const char *name)
+{
+    return Registry::instance().register_scope(name);
+}
+
+
+const char *bot_profiler::scope_name(ScopeId scope_id)
+{
+    return Registry::instance().scope_name(scope_id);
+}
+
+
+void bot_profiler::set_enabled(bool enabled)
+{
+    Registry::instance().set_enabled(enabled);
+}
+
+
+void bot_profiler::set_allocation_counting(bool enabled)
+{
+    detail::allocation_counting.store(enabled, std::memory_order_relaxed);
+}
+
+
+uint64_t &bot_profiler::thread_allocations()
+{
+    return thread_allocation_count;
+}
+
+
+void bot_profiler::set_stream_id(StreamId stream_id)
+{
+    thread_stream_id = stream_id;
+}
+
+
+bot_profiler::StreamId bot_profiler::get_stream_id()
+{
+    return thread_stream_id;
+}
+
+
+void bot_profiler::set_frame_id(uint32_t frame_id)
+{
+    thread_frame_id = frame_id;
+}
+
+
+uint32_t bot_profiler::get_frame_id()
+{
+    return thread_frame_id;
+}
+
+
+void bot_profiler::record(ScopeId scope_id, uint64_t start, uint64_t end,
+                          uint32_t count, uint32_t allocations)
+{
+    if (!thread_buffer_handle.buffer)
+        thread_buffer_handle.buffer = Registry::instance().add_thread_buffer();
+    ThreadBuffer &buffer = *thread_buffer_handle.buffer;
+
+    const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) >=
+        ThreadBuffer::CAPACITY)
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer.events[head & (ThreadBuffer::CAPACITY - 1)] = {
+            start, end, scope_id, thread_stream_id, thread_frame_id, count,
+            allocations};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+
+double bot_profiler::ticks_to_ns(uint64_t ticks)
+{
+    return Registry::instance().ticks_to_ns(ticks);
+}
+
+
+void bot_profiler::collect()
+{
+    Registry::instance().collect();
+}
+
+
+bot_profiler::Snapshot bot_profiler::snapshot(bool reset_after)
+{
+    return Registry::instance().snapshot(reset_after);
+}
+
+
+uint64_t bot_profiler::dropped_events()
+{
+    return Registry::instance().dropped_events();
+}
+
+
+void bot_profiler::reset()
+{
+    Registry::instance().reset();
+}
+
+
+void bot_profiler::print_report(std::ostream &os)
+{
+    const Snapshot stats = snapshot();
+    const bool allocations = is_counting_allocations();
+
+    size_t name_width = 5;
+    for (const ScopeStats &scope_stats: stats.scopes)
+        name_width = std::max(name_width, scope_stats.name.size());
+
+    const std::ios_base::fmtflags flags = os.flags();
+    os << std::left << std::setw(static_cast<int>(name_width)) << "scope"
+       << std::right << std::setw(8) << "stream" << std::setw(10) << "calls"
+       << std::setw(10) << "mean ms" << std::setw(10) << "p50 ms"
+       << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms"
+       << std::setw(10) << "p99.9 ms" << std::setw(10) << "max ms";
+    if (allocations)
+        os << std::setw(12) << "allocs/call";
+    os << std::endl;
+    for (const ScopeStats &scope_stats: stats.scopes)
+    {
+        os << std::left << std::setw(static_cast<int>(name_width))
+           << scope_stats.name << std::right << std::setw(8)
+           << scope_stats.stream_id << std::setw(10) << scope_stats.count
+           << std::fixed << std::setprecision(3) << std::setw(10)
+           << scope_stats.mean_ms() << std::setw(10) << scope_stats.p50_ms
+           << std::setw(10) << scope_stats.p90_ms << std::setw(10)
+           << scope_stats.p99_ms << std::setw(10) << scope_stats.p999_ms
+           << std::setw(10) << scope_stats.max_ms;
+        if (allocations)
+            os << std::setprecision(1) << std::setw(12)
+               << scope_stats.allocations_per_call();
+        os << std::endl;
+    }
+
+    if (stats.dropped_events)
+        os << stats.dropped_events << " events dropped (full thread buffers)"
+           << std::endl;
+    os.flags(flags);
+}
+
+
+bool bot_profiler::start_trace(const std::string &filepath)
+{
+    return Registry::instance().start_trace(filepath);
+}
+
+
+void bot_profiler::stop_trace()
+{
+    Registry::instance().stop_trace();
+}
@@ -0,0 +1,274 @@
+#include "replay.h"
+
+#include <cstring>
+#include <iostream>
+
+
+namespace
+{
+constexpr char MAGIC[8] = {'B', 'O', 'T', 'R', 'E', 'P', 'L', 'Y'};
+constexpr uint32_t VERSION = 1;
+
+// Guards against reading a corrupted count as a huge allocation
+constexpr uint32_t MAX_COUNT = 1u << 24;
+
+
+template<typename T>
+void write_value(std::ostream &os, const T &value)
+{
+    os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void write_floats(std::ostream &os, const float *values, size_t count)
+{
+    os.write(reinterpret_cast<const char *>(values),
+             static_cast<std::streamsize>(count * sizeof(float)));
+}
+
+template<typename T>
+bool read_value(std::istream &is, T &value)
+{
+    return static_cast<bool>(
+            is.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+bool read_floats(std::istream &is, float *values, size_t count)
+{
+    return static_cast<bool>(
+            is.read(reinterpret_cast<char *>(values),
+                    static_cast<std::streamsize>(count * sizeof(float))));
+}
+
+bool read_count(std::istream &is, uint32_t &count)
+{
+    return read_value(is, count) && count <= MAX_COUNT;
+}
+
+bool read_features(std::istream &is, FeatureMatrix &features, uint32_t count)
+{
+    features.resize(count, FEATURE_DIM);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        FeatureVector feature;
+        if (!read_floats(is, feature.data(), FEATURE_DIM))
+            return false;
+        features.row(i) = feature;
+    }
+    return true;
+}
+
+void write_features(std::ostream &os, const FeatureMatrix &features)
+{
+    for (Eigen::Index i = 0; i < features.rows(); ++i)
+    {
+        const FeatureVector feature = features.row(i);
+        write_floats(os, feature.data(), FEATURE_DIM);
+    }
+}
+
+
+bool read_frame(std::istream &is, bot_replay::FrameRecord &frame)
+{
+    uint32_t count = 0;
+    if (!read_value(is, frame.frame_id) ||
+        !read_value(is, frame.frame_size.width) ||
+        !read_value(is, frame.frame_size.height) || !read_count(is, count))
+        return false;
+
+    frame.detections.resize(count);
+    for (Detection &detection: frame.detections)
+    {
+        int32_t class_id = 0;
+        if (!read_value(is, detection.bbox_tlwh.x) ||
+            !read_value(is, detection.bbox_tlwh.y) ||
+            !read_value(is, detection.bbox_tlwh.width) ||
+            !read_value(is, detection.bbox_tlwh.height) ||
+            !read_value(is, class_id) ||
+            !read_value(is, detection.confidence))
+            return false;
+        detection.class_id = class_id;
+    }
+
+    uint8_t has_homography = 0;
+    if (!read_value(is, has_homography))
+        return false;
+    frame.homography.reset();
+    if (has_homography)
+    {
+        Eigen::Matrix<float, 3, 3, Eigen::RowMajor> homography;
+        if (!read_floats(is, homography.data(), homography.size()))
+            return false;
+        frame.homography = homography;
+    }
+
+    if (!read_count(is, count))
+        return false;
+    frame.feature_indices.resize(count);
+    for (uint32_t &index: frame.feature_indices)
+        if (!read_value(is, index) || index >= frame.detections.size())
+            return false;
+    if (!read_features(is, frame.features, count))
+        return false;
+
+    if (!read_count(is, count))
+        return false;
+    frame.late_indices.resize(count);
+    for (uint32_t &index: frame.late_indices)
+        if (!read_value(is, index) || index >= frame.detections.size())
+            return false;
+    if (!read_count(is, count) ||
+        !read_features(is, frame.late_features, count))
+        return false;
+
+    if (!read_count(is, count))
+        return false;
+    frame.tracks.resize(count);
+    for (bot_replay::TrackRecord &track: frame.tracks)
+    {
+        int32_t track_id = 0;
+        if (!read_value(is, track_id) || !read_value(is, track.tlwh.x) ||
+            !read_value(is, track.tlwh.y) ||
+            !read_value(is, track.tlwh.width) ||
+            !read_value(is, track.tlwh.height))
+            return false;
+        track.track_id = track_id;
+    }
+    return true;
+}
+}// namespace
+
+
+bool bot_replay::ReplayWriter::open(const std::string &filepath,
+                                    const SessionInfo &session)
+{
+    close();
+    _file.open(filepath, std::ios::binary | std::ios::trunc);
+    if (!_file.is_open())
+    {
+        std::cout << "Can't create the replay file " << filepath << std::endl;
+        return false;
+    }
+
+    _file.write(MAGIC, sizeof(MAGIC));
+    write_value(_file, VERSION);
+    write_value(_file, FEATURE_DIM);
+    write_value(_file, static_cast<uint32_t>(session.distance_metric.size()));
+    _file.write(session.distance_metric.data(),
+                static_cast<std::streamsize>(session.distance_metric.size()));
+    write_value(_file, static_cast<uint8_t>(session.late_features));
+    _file.flush();
+    return true;
+}
+
+
+void bot_replay::ReplayWriter::write(const FrameRecord &frame)
+{
+    if (!_file.is_open())
+        return;
+
+    write_value(_file, frame.frame_id);
+    write_value(_file, static_cast<int32_t>(frame.frame_size.width));
+    write_value(_file, static_cast<int32_t>(frame.frame_size.height));
+
+    write_value(_file, static_cast<uint32_t>(frame.detections.size()));
+    for (const Detection &detection: frame.detections)
+    {
+        write_value(_file, detection.bbox_tlwh.x);
+        write_value(_file, detection.bbox_tlwh.y);
+        write_value(_file, detection.bbox_tlwh.width);
+        write_value(_file, detection.bbox_tlwh.height);
+        write_value(_file, static_cast<int32_t>(detection.class_id));
+        write_value(_file, detection.confidence);
+    }
+
+    write_value(_file, static_cast<uint8_t>(frame.homography.has_value()));
+    if (frame.homography)
+    {
+        const Eigen::Matrix<float, 3, 3, Eigen::RowMajor> homography =
+                *frame.homography;
+        write_floats(_file, homography.data(), homography.size());
+    }
+
+    write_value(_file, static_cast<uint32_t>(frame.feature_indices.size()));
+    for (uint32_t index: frame.feature_indices)
+        write_value(_file, index);
+    write_features(_file, frame.features);
+
+    write_value(_file, static_cast<uint32_t>(frame.late_indices.size()));
+    for (uint32_t index: frame.late_indices)
+        write_value(_file, index);
+    write_value(_file, static_cast<uint32_t>(frame.late_features.rows()));
+    write_features(_file, frame.late_features);
+
+    write_value(_file, static_cast<uint32_t>(frame.tracks.size()));
+    for (const TrackRecord &track: frame.tracks)
+    {
+        write_value(_file, static_cast<int32_t>(track.track_id));
+        write_value(_file, track.tlwh.x);
+        write_value(_file, track.tlwh.y);
+        write_value(_file, track.tlwh.width);
+        write_value(_file, track.tlwh.height);
+    }
+    _file.flush();
+}
+
+
+void bot_replay::ReplayWriter::close()
+{
+    if (_file.is_open())
+        _file.close();
+}
+
+
+bool bot_replay::ReplayReader::open(const std::string &filepath)
+{
+    _file.close();
+    _file.clear();
+    _file.open(filepath, std::ios::binary);
+    if (!_file.is_open())
+    {
+        std::cout << "Can't open the replay file " << filepath << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(MAGIC)] = {};
+    uint32_t version = 0, feature_dim = 0, metric_length = 0;
+    if (!_file.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !read_value(_file, version) || !read_value(_file, feature_dim) ||
+        !read_count(_file, metric_length))
+    {
+        std::cout << filepath << " is not a replay file" << std::endl;
+        return false;
+    }
+    if (version != VERSION || feature_dim != FEATURE_DIM)
+    {
+        std::cout << "Unsupported replay file " << filepath << " (version "
+                  << version << ", feature dimension " << feature_dim << ")"
+                  << std::endl;
+        return false;
+    }
+
+    _session.distance_metric.resize(metric_length);
+    uint8_t late_features = 0;
+    if (!_file.read(_session.distance_metric.data(), metric_length) ||
+        !read_value(_file, late_features))
+        return false;
+    _session.late_features = late_features != 0;
+    return true;
+}
+
+
+bool bot_replay::ReplayReader::read(FrameRecord &frame)
+{
+    if (!_file.is_open() || _file.peek() == std::ifstream::traits_type::eof())
+        return false;
+
+    if (!read_frame(_file, frame))
+    {
+        std::cout << "Truncated or corrupted replay frame, stopping"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -1,31 +1,56 @@
 #include "track.h"
 
+#include <algorithm>
+#include <cmath>
 #include <utility>
 
 #include "profiler.h"
 
 Track::Track(std::vector<float> tlwh, float score, uint8_t class_id,
-             std::optional<FeatureVector> feat, int feat_history_size)
+             std::optional<FeatureVector> feat, int feat_history_size,
+             FeatureFormat feat_history_format,
+             FeatureFormat appearance_format)
     : det_tlwh(std::move(tlwh)), _score(score), _class_id(class_id),
-      tracklet_len(0), is_activated(false), state(TrackState::New)
+      tracklet_len(0), is_activated(false), track_id(0),
+      state(TrackState::New), frame_id(0), start_frame(0), feat_frame_id(0),
+      mean(KFStateSpaceVec::Zero()), covariance(KFStateSpaceMatrix::Zero()),
+      _appearance_format(appearance_format), _has_feat(false),
+      _feat_history(static_cast<size_t>(std::max(0, feat_history_size)),
+                    feat_history_format)
 {
 
     if (feat)
     {
-        _feat_history_size = feat_history_size;
-        _update_features(std::make_shared<FeatureVector>(feat.value()));
-    }
-    else
-    {
-        curr_feat = nullptr;
-        smooth_feat = nullptr;
-        _feat_history_size = 0;
+        _update_features(feat.value());
     }
 
     _update_class_id(class_id, score);
     _update_tracklet_tlwh_inplace();
 }
 
+void Track::reset(const cv::Rect_<float> &tlwh, float score,
+                  uint8_t class_id)
+{
+    det_tlwh.assign({tlwh.x, tlwh.y, tlwh.width, tlwh.height});
+    _score = score;
+    _class_id = class_id;
+    tracklet_len = 0;
+    is_activated = false;
+    track_id = 0;
+    state = TrackState::New;
+    frame_id = 0;
+    start_frame = 0;
+    feat_frame_id = 0;
+    mean.setZero();
+    covariance.setZero();
+    _has_feat = false;
+    _feat_history.clear();
+    _class_hist.clear();
+
+    _update_class_id(class_id, score);
+    _update_tracklet_tlwh_inplace();
+}
+
 void Track::activate(KalmanFilter &kalman_filter, uint32_t frame_id)
 {
     track_id = next_id();
@@ -45,6 +70,10 @@ void Track::activate(KalmanFilter &kalman_filter, uint32_t frame_id)
     }
     this->frame_id = frame_id;
     start_frame = frame_id;
+    if (_has_feat)
+    {
+        feat_frame_id = frame_id;
+    }
     state = TrackState::Tracked;
     tracklet_len = 1;
     _update_tracklet_tlwh_inplace();
@@ -61,9 +90,10 @@ void Track::re_activate(KalmanFilter &kalman_filter, Track &new_track,
     mean = state_space.first;
     covariance = state_space.second;
 
-    if (new_track.curr_feat)
+    if (new_track._has_feat)
     {
-        _update_features(new_track.curr_feat);
+        _update_features(new_track._feat->curr);
+        feat_frame_id = frame_id;
     }
 
     if (new_id)
@@ -102,8 +132,8 @@ void Track::multi_predict(std::vector<std::shared_ptr<Track>> &tracks,
 
 void Track::apply_camera_motion(const HomographyMatrix &H)
 {
-    Eigen::MatrixXf R = H.block(0, 0, 2, 2);
-    Eigen::VectorXf t = H.block(0, 2, 2, 1);
+    Eigen::Matrix2f R = H.block<2, 2>(0, 0);
+    Eigen::Vector2f t = H.block<2, 1>(0, 2);
 
     Eigen::Matrix<float, 8, 8> R8x8 = Eigen::Matrix<float, 8, 8>::Identity();
     R8x8.block(0, 0, 2, 2) = R;
@@ -132,9 +162,10 @@ void Track::update(KalmanFilter &kalman_filter, Track &new_track,
     KFDataStateSpace state_space =
             kalman_filter.update(mean, covariance, new_track_bbox);
 
-    if (new_track.curr_feat)
+    if (new_track._has_feat)
     {
-        _update_features(new_track.curr_feat);
+        _update_features(new_track._feat->curr);
+        feat_frame_id = frame_id;
     }
 
     mean = state_space.first;
@@ -149,26 +180,56 @@ void Track::update(KalmanFilter &kalman_filter, Track &new_track,
     _update_tracklet_tlwh_inplace();
 }
 
-void Track::_update_features(const std::shared_ptr<FeatureVector> &feat)
+bool Track::set_features(const FeatureVector &feat)
+{
+    return _update_features(feat);
+}
+
+bool Track::_update_features(const FeatureVector &feat)
 {
-    *feat /= feat->norm();
+    const float norm = feat.norm();
+    if (!std::isfinite(norm) || norm <= 0.0F)
+        return false;
 
-    if (_feat_history.empty())
+    // The storage is kept when a pooled track is reset, see TrackPool
+    if (!_feat)
+        _feat = std::make_unique<Features>();
+    _feat->curr = feat / norm;
+
+    if (!_has_feat)
     {
-        curr_feat = feat;
-        smooth_feat = std::make_unique<FeatureVector>(*curr_feat);
+        _feat->smooth = _feat->curr;
+        _has_feat = true;
     }
     else
     {
-        *smooth_feat = _alpha * (*smooth_feat) + (1 - _alpha) * (*feat);
+        _feat->smooth = _alpha * _feat->smooth + (1 - _alpha) * _feat->curr;
     }
 
-    if (_feat_history.size() == _feat_history_size)
+    _feat_history.push(_feat->curr);
+    _feat->smooth /= _feat->smooth.norm();
+
+    if (_appearance_format != FeatureFormat::Float32)
     {
-        _feat_history.pop_front();
+        const size_t feature_bytes = feature_storage_bytes(_appearance_format);
+        _feat->encoded.resize(2 * feature_bytes);
+        uint8_t *curr = _feat->encoded.data();
+        uint8_t *smooth = curr + feature_bytes;
+        encode_feature(_feat->curr, _appearance_format, curr);
+        encode_feature(_feat->smooth, _appearance_format, smooth);
+        _feat->curr_sq_norm = encoded_dot(curr, curr, _appearance_format);
+        _feat->smooth_sq_norm = encoded_dot(smooth, smooth, _appearance_format);
     }
-    _feat_history.push_back(curr_feat);
-    *smooth_feat /= smooth_feat->norm();
+    return true;
+}
+
+size_t Track::memory_footprint() const
+{
+    return sizeof(Track) +
+           (_feat ? sizeof(Features) + _feat->encoded.capacity() : 0) +
+           _feat_history.memory_footprint() +
+           (det_tlwh.capacity() + _tlwh.capacity()) * sizeof(float) +
+           _class_hist.capacity() * sizeof(std::pair<uint8_t, float>);
 }
 
 int Track::next_id()
@@ -218,7 +279,7 @@ void Track::_update_tracklet_tlwh_inplace()
     _tlwh = {mean(0) - mean(2) / 2, mean(1) - mean(3) / 2, mean(2), mean(3)};
 }
 
-std::vector<float> Track::get_tlwh() const
+const std::vector<float> &Track::get_tlwh() const
 {
     return _tlwh;
 }
@@ -8,24 +8,36 @@ double lapjv(CostMatrix &cost, std::vector<int> &rowsol,
              std::vector<int> &colsol, bool extend_cost, float cost_limit,
              bool return_cost)
 {
-    std::vector<std::vector<float>> cost_c;
+    FrameArena arena(lapjv_arena_bytes(cost.rows(), cost.cols(), extend_cost,
+                                       cost_limit));
+    rowsol.resize(cost.rows());
+    colsol.resize(cost.cols());
+    return lapjv(cost, rowsol.data(), colsol.data(), arena, extend_cost,
+                 cost_limit, return_cost);
+}
 
-    for (Eigen::Index i = 0; i < cost.rows(); i++)
-    {
-        std::vector<float> row;
-        for (Eigen::Index j = 0; j < cost.cols(); j++)
-        {
-            row.push_back(cost(i, j));
-        }
-        cost_c.push_back(row);
-    }
 
-    std::vector<std::vector<float>> cost_c_extended;
+size_t lapjv_arena_bytes(Eigen::Index rows, Eigen::Index cols,
+                         bool extend_cost, float cost_limit)
+{
+    // Same allocations as lapjv()
+    const bool extend = extend_cost || cost_limit < LONG_MAX;
+    const size_t n = static_cast<size_t>(extend ? rows + cols : rows);
+    return FrameArena::array_bytes<double>(n * n) +
+           FrameArena::array_bytes<double *>(n) +
+           2 * FrameArena::array_bytes<int>(n) +
+           3 * FrameArena::array_bytes<int_t>(n) +
+           2 * FrameArena::array_bytes<cost_t>(n) +
+           FrameArena::array_bytes<boolean>(n);
+}
+
 
+double lapjv(const Eigen::Ref<const CostMatrix> &cost, int *rowsol,
+             int *colsol, FrameArena &arena, bool extend_cost,
+             float cost_limit, bool return_cost)
+{
     int n_rows = static_cast<int>(cost.rows());
     int n_cols = static_cast<int>(cost.cols());
-    rowsol.resize(n_rows);
-    colsol.resize(n_cols);
 
     int n = 0;
     if (n_rows == n_cols) { n = n_rows; }
@@ -38,82 +50,68 @@ double lapjv(CostMatrix &cost, std::vector<int> &rowsol,
         }
     }
 
-    if (extend_cost || cost_limit < LONG_MAX)
-    {
-        n = n_rows + n_cols;
-        cost_c_extended.resize(n);
-        for (int i = 0; i < cost_c_extended.size(); i++)
-            cost_c_extended[i].resize(n);
+    // Square cost matrix of the solver, in one contiguous block
+    const bool extend = extend_cost || cost_limit < LONG_MAX;
+    if (extend) n = n_rows + n_cols;
+    double *cost_data =
+            arena.allocate_array<double>(static_cast<size_t>(n) * n);
+    double **cost_ptr = arena.allocate_array<double *>(n);
+    for (int i = 0; i < n; i++)
+        cost_ptr[i] = cost_data + static_cast<size_t>(i) * n;
 
-        if (cost_limit < LONG_MAX)
-        {
-            for (int i = 0; i < cost_c_extended.size(); i++)
-            {
-                for (int j = 0; j < cost_c_extended[i].size(); j++)
-                {
-                    cost_c_extended[i][j] = cost_limit / 2.0;
-                }
-            }
-        }
+    if (extend)
+    {
+        // Cost of leaving a row or a column unmatched, and 0 between the dummy rows and columns
+        float cost_pad;
+        if (cost_limit < LONG_MAX) { cost_pad = cost_limit / 2.0; }
         else
         {
             float cost_max = -1;
-            for (int i = 0; i < cost_c.size(); i++)
+            for (Eigen::Index i = 0; i < cost.rows(); i++)
             {
-                for (int j = 0; j < cost_c[i].size(); j++)
+                for (Eigen::Index j = 0; j < cost.cols(); j++)
                 {
-                    if (cost_c[i][j] > cost_max) cost_max = cost_c[i][j];
-                }
-            }
-            for (int i = 0; i < cost_c_extended.size(); i++)
-            {
-                for (int j = 0; j < cost_c_extended[i].size(); j++)
-                {
-                    cost_c_extended[i][j] = cost_max + 1;
+                    if (cost(i, j) > cost_max) cost_max = cost(i, j);
                 }
             }
+            cost_pad = cost_max + 1;
         }
 
-        for (int i = n_rows; i < cost_c_extended.size(); i++)
-        {
-            for (int j = n_cols; j < cost_c_extended[i].size(); j++)
-            {
-                cost_c_extended[i][j] = 0;
-            }
-        }
-        for (int i = 0; i < n_rows; i++)
+        for (int i = 0; i < n; i++)
         {
-            for (int j = 0; j < n_cols; j++)
+            for (int j = 0; j < n; j++)
             {
-                cost_c_extended[i][j] = cost_c[i][j];
+                if (i < n_rows && j < n_cols) cost_ptr[i][j] = cost(i, j);
+                else if (i >= n_rows && j >= n_cols) cost_ptr[i][j] = 0;
+                else cost_ptr[i][j] = cost_pad;
             }
         }
-
-        cost_c.clear();
-        cost_c.assign(cost_c_extended.begin(), cost_c_extended.end());
     }
-
-    double **cost_ptr;
-    cost_ptr = new double *[n];
-    for (int i = 0; i < n; i++) cost_ptr[i] = new double[n];
-
-    for (int i = 0; i < n; i++)
+    else
     {
-        for (int j = 0; j < n; j++) { cost_ptr[i][j] = cost_c[i][j]; }
+        for (int i = 0; i < n; i++)
+        {
+            for (int j = 0; j < n; j++) { cost_ptr[i][j] = cost(i, j); }
+        }
     }
 
-    int *x_c = new int[n];
-    int *y_c = new int[n];
-
-    int ret = lapjv_internal(n, cost_ptr, x_c, y_c);
+    int *x_c = arena.allocate_array<int>(n);
+    int *y_c = arena.allocate_array<int>(n);
+    lapjv_workspace workspace;
+    workspace.free_rows = arena.allocate_array<int_t>(n);
+    workspace.pred = arena.allocate_array<int_t>(n);
+    workspace.cols = arena.allocate_array<int_t>(n);
+    workspace.v = arena.allocate_array<cost_t>(n);
+    workspace.d = arena.allocate_array<cost_t>(n);
+    workspace.unique = arena.allocate_array<boolean>(n);
+
+    int ret = lapjv_internal_workspace(n, cost_ptr, x_c, y_c, &workspace);
     if (ret != 0)
     {
         std::cout << "Calculate Wrong!" << std::endl;
         exit(0);
     }
 
-    double opt = 0.0;
-
     if (n != n_rows)
     {
         for (int i = 0; i < n; i++)
@@ -121,29 +119,18 @@ double lapjv(CostMatrix &cost, std::vector<int> &rowsol,
             if (x_c[i] >= n_cols) x_c[i] = -1;
             if (y_c[i] >= n_rows) y_c[i] = -1;
         }
-        for (int i = 0; i < n_rows; i++) { rowsol[i] = x_c[i]; }
-        for (int i = 0; i < n_cols; i++) { colsol[i] = y_c[i]; }
-
-        if (return_cost)
-        {
-            for (int i = 0; i < rowsol.size(); i++)
-            {
-                if (rowsol[i] != -1) { opt += cost_ptr[i][rowsol[i]]; }
-            }
-        }
     }
-    else if (return_cost)
+    for (int i = 0; i < n_rows; i++) { rowsol[i] = x_c[i]; }
+    for (int i = 0; i < n_cols; i++) { colsol[i] = y_c[i]; }
+
+    double opt = 0.0;
+    if (return_cost)
     {
-        for (int i = 0; i < rowsol.size(); i++)
+        for (int i = 0; i < n_rows; i++)
         {
-            opt += cost_ptr[i][rowsol[i]];
+            if (rowsol[i] != -1) { opt += cost_ptr[i][rowsol[i]]; }
         }
     }
 
-    for (int i = 0; i < n; i++) { delete[] cost_ptr[i]; }
-    delete[] cost_ptr;
-    delete[] x_c;
-    delete[] y_c;
-
     return opt;
 }
@@ -7,6 +7,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <opencv2/core/types.hpp>
 #include <opencv2/highgui.hpp>
@@ -16,6 +17,8 @@
 #include "BoTSORT.h"
 #include "DataType.h"
 #include "GlobalMotionCompensation.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "track.h"
 
 
@@ -196,20 +199,42 @@ bool check_source(const std::string &source)
 
 int main(int argc, char **argv)
 {
+    // Optional timeline of the tracker stages: --trace <trace.json>
+    // Optional live metrics at http://localhost:<port>/metrics: --metrics-port <port>
+    // Optional session recording for botsort_replay: --record <session.botreplay>
+    std::string trace_filepath, record_filepath;
+    int metrics_port = -1;
+    std::vector<char *> args;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--trace" && i + 1 < argc)
+            trace_filepath = argv[++i];
+        else if (std::string(argv[i]) == "--metrics-port" && i + 1 < argc)
+            metrics_port = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--record" && i + 1 < argc)
+            record_filepath = argv[++i];
+        else
+            args.push_back(argv[i]);
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
 
     // Command line arguments check
     if (argc < 4)
     {
         std::cout << "Usage eg. 1: ./botsort_tracking_example <source> "
                      "<dir_containing_per_frame_detections> "
-                     "<dir_to_save_mot_format_output>"
+                     "<dir_to_save_mot_format_output> [--trace <trace.json>] "
+                     "[--metrics-port <port>] [--record <session.botreplay>]"
                   << std::endl;
         std::cout << "Usage eg. 2: ./botsort_tracking_example "
                      "<tracker_config_path> "
                      "<gmc_config_path> <reid_config_path> "
                      "<reid_onnx_model_path> "
                      "<source> <dir_containing_per_frame_detections> "
-                     "<dir_to_save_mot_format_output> <gt_file>"
+                     "<dir_to_save_mot_format_output> <gt_file> "
+                     "[--trace <trace.json>] [--metrics-port <port>] "
+                     "[--record <session.botreplay>]"
                   << std::endl;
         return -1;
     }
@@ -217,14 +242,17 @@ int main(int argc, char **argv)
     {
         std::cout << "Usage eg. 1: ./botsort_tracking_example <source> "
                      "<dir_containing_per_frame_detections> "
-                     "<dir_to_save_mot_format_output>"
+                     "<dir_to_save_mot_format_output> [--trace <trace.json>] "
+                     "[--metrics-port <port>] [--record <session.botreplay>]"
                   << std::endl;
         std::cout << "Usage eg. 2: ./botsort_tracking_example "
                      "<tracker_config_path> "
                      "<gmc_config_path> <reid_config_path> "
                      "<reid_onnx_model_path> "
                      "<source> <dir_containing_per_frame_detections> "
-                     "<dir_to_save_mot_format_output> <gt_file>"
+                     "<dir_to_save_mot_format_output> <gt_file> "
+                     "[--trace <trace.json>] [--metrics-port <port>] "
+                     "[--record <session.botreplay>]"
                   << std::endl;
         return -1;
     }
@@ -316,6 +344,24 @@ int main(int argc, char **argv)
                                             reid_onnx_model_path);
     }
 
+    if (!trace_filepath.empty() && !bot_profiler::start_trace(trace_filepath))
+    {
+        std::cout << "Can't open " << trace_filepath << std::endl;
+        return -1;
+    }
+
+    if (!record_filepath.empty() && !tracker->start_recording(record_filepath))
+        return -1;
+
+    bot_metrics::MetricsServer metrics_server;
+    if (metrics_port >= 0)
+    {
+        if (!metrics_server.start(static_cast<uint16_t>(metrics_port)))
+            return -1;
+        std::cout << "Serving metrics at http://localhost:"
+                  << metrics_server.port() << "/metrics" << std::endl;
+    }
+
     if (is_video)
     {
         cap = cv::VideoCapture(source);
@@ -437,6 +483,20 @@ int main(int argc, char **argv)
               << std::endl;
     std::cout << "Average processing time per frame (ms): "
               << (tracker_time_total / frame_counter) * 1000 << std::endl;
+
+    // Per-stage timings, with BOTSORT_PROFILE=1 in the environment or --trace
+    if (bot_profiler::is_enabled())
+        bot_profiler::print_report(std::cout);
+    if (!trace_filepath.empty())
+    {
+        bot_profiler::stop_trace();
+        std::cout << "Trace written to " << trace_filepath << std::endl;
+    }
+    if (!record_filepath.empty())
+    {
+        tracker->stop_recording();
+        std::cout << "Session recorded to " << record_filepath << std::endl;
+    }
     cap.release();
 
     return 0;
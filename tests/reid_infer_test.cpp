@@ -0,0 +1,236 @@
+/**
+ * @brief Checks of ReIDModel::infer() on a fake inference engine, without a backend or a model
+ *  The fake engine returns for each patch a feature filled with the first value of the patch, so that
+ *  the rows of the output can be matched with the patches of the blob. Checks the batching of the
+ *  patches (33 patches in batches of 32), a failed batch (its rows are flagged invalid) and an engine
+ *  output shorter than the batch (rejected, its rows are flagged invalid).
+ *
+ * Usage: botsort_reid_infer_test
+ */
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ReID.h"
+
+
+namespace
+{
+const std::string REID_CONFIG = BOTSORT_CONFIG_DIR "/reid.ini";
+
+
+/**
+ * @brief Inference engine returning, for each patch of the batch, a feature filled with the first
+ *  value of the patch. One call (or none) can be made to fail.
+ */
+class FakeInferenceEngine : public inference_backend::InferenceEngine
+{
+public:
+    enum class Failure
+    {
+        None,
+        EmptyOutput,///< No prediction, as returned by a failed backend
+        ShortOutput ///< One feature less than the batch size
+    };
+
+    FakeInferenceEngine(int max_batch_size, Failure failure = Failure::None,
+                        int failing_call = 0)
+        : _max_batch_size(max_batch_size), _failure(failure),
+          _failing_call(failing_call)
+    {
+    }
+
+    bool load_model(const std::string &) override
+    {
+        return true;
+    }
+
+    inference_backend::ModelPredictions
+    forward_batch(const cv::Mat &input_blob) override
+    {
+        const int batch_size = input_blob.size[0];
+        const size_t patch_size = input_blob.total() / batch_size;
+        batch_sizes.push_back(batch_size);
+
+        size_t num_features = static_cast<size_t>(batch_size);
+        if (static_cast<int>(batch_sizes.size()) - 1 == _failing_call)
+        {
+            if (_failure == Failure::EmptyOutput)
+                return {};
+            if (_failure == Failure::ShortOutput)
+                --num_features;
+        }
+
+        _output.resize(num_features * FEATURE_DIM);
+        const float *blob = input_blob.ptr<float>();
+        for (size_t i = 0; i < num_features; ++i)
+            std::fill_n(_output.begin() + i * FEATURE_DIM, FEATURE_DIM,
+                        blob[i * patch_size]);
+        return {inference_backend::TensorView(_output.data(), _output.size())};
+    }
+
+    int max_batch_size() const override
+    {
+        return _max_batch_size;
+    }
+
+    std::vector<int> batch_sizes;///< Batch size of each forward_batch() call
+
+
+private:
+    int _max_batch_size;
+    Failure _failure;
+    int _failing_call;
+    std::vector<float> _output;
+};
+
+
+struct InferResult
+{
+    ReIDFeatures features;
+    std::vector<int> batch_sizes;///< Batch size of each forward_batch() call
+};
+
+
+/**
+ * @brief Runs infer() on num_patches patches (patch i filled with i + 1) with the ReID config of the
+ *  repository (batch_size = 32) on a fake engine
+ */
+InferResult run_infer(size_t num_patches, int max_batch_size,
+                      FakeInferenceEngine::Failure failure =
+                              FakeInferenceEngine::Failure::None,
+                      int failing_call = 0)
+{
+    auto fake_engine = std::make_unique<FakeInferenceEngine>(
+            max_batch_size, failure, failing_call);
+    const FakeInferenceEngine &engine = *fake_engine;
+    ReIDModel model(REID_CONFIG, "", std::move(fake_engine));
+    const size_t patch_size = model.patch_size();
+
+    std::vector<float> blob(num_patches * patch_size);
+    for (size_t i = 0; i < num_patches; ++i)
+        std::fill_n(blob.begin() + i * patch_size, patch_size,
+                    static_cast<float>(i + 1));
+    ReIDFeatures features = model.infer(blob.data(), num_patches);
+    return {std::move(features), engine.batch_sizes};
+}
+
+
+/**
+ * @brief Whether row i of the features is filled with i + 1, or flagged invalid in [invalid_begin, invalid_end)
+ */
+bool check_rows(const ReIDFeatures &features, size_t num_patches,
+                size_t invalid_begin = 0, size_t invalid_end = 0)
+{
+    if (static_cast<size_t>(features.features.rows()) != num_patches ||
+        features.valid.size() != num_patches)
+    {
+        std::cout << "  " << features.features.rows() << " rows and "
+                  << features.valid.size() << " flags, expected "
+                  << num_patches << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < num_patches; ++i)
+    {
+        const bool expected_valid = i < invalid_begin || i >= invalid_end;
+        if (features.valid[i] != expected_valid)
+        {
+            std::cout << "  row " << i << " is "
+                      << (features.valid[i] ? "valid" : "invalid")
+                      << std::endl;
+            return false;
+        }
+
+        const float expected = static_cast<float>(i + 1);
+        if (expected_valid &&
+            (features.features.row(static_cast<Eigen::Index>(i)).array() !=
+             expected)
+                    .any())
+        {
+            std::cout << "  row " << i << " is not filled with " << expected
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool check_batch_sizes(const InferResult &result,
+                       const std::vector<int> &expected)
+{
+    if (result.batch_sizes == expected)
+        return true;
+    std::cout << "  " << result.batch_sizes.size()
+              << " forward_batch() calls, expected " << expected.size()
+              << std::endl;
+    return false;
+}
+
+
+bool test_batching()
+{
+    const InferResult result = run_infer(33, 32);
+    return check_batch_sizes(result, {32, 1}) &&
+           check_rows(result.features, 33);
+}
+
+
+bool test_engine_batch_limit()
+{
+    // The engine's max batch size wins over the batch_size of the config
+    const InferResult result = run_infer(10, 4);
+    return check_batch_sizes(result, {4, 4, 2}) &&
+           check_rows(result.features, 10);
+}
+
+
+bool test_failed_batch()
+{
+    // The second batch fails, its rows are flagged invalid and the following batches are still run
+    const InferResult result =
+            run_infer(10, 4, FakeInferenceEngine::Failure::EmptyOutput, 1);
+    return check_batch_sizes(result, {4, 4, 2}) &&
+           check_rows(result.features, 10, 4, 8);
+}
+
+
+bool test_short_output()
+{
+    // The first batch returns 31 features for 32 patches, none of its rows is trusted
+    const InferResult result =
+            run_infer(33, 32, FakeInferenceEngine::Failure::ShortOutput, 0);
+    return check_batch_sizes(result, {32, 1}) &&
+           check_rows(result.features, 33, 0, 32);
+}
+
+
+bool test_no_patch()
+{
+    const InferResult result = run_infer(0, 32);
+    return check_batch_sizes(result, {}) && check_rows(result.features, 0);
+}
+}// namespace
+
+
+int main()
+{
+    const std::vector<std::pair<std::string, bool (*)()>> tests = {
+            {"batching", test_batching},
+            {"engine_batch_limit", test_engine_batch_limit},
+            {"failed_batch", test_failed_batch},
+            {"short_output", test_short_output},
+            {"no_patch", test_no_patch},
+    };
+
+    int failed = 0;
+    for (const auto &[name, test]: tests)
+    {
+        const bool passed = test();
+        std::cout << (passed ? "[ OK ] " : "[FAIL] ") << name << std::endl;
+        failed += !passed;
+    }
+    return failed > 0 ? 1 : 0;
+}
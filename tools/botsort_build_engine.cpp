@@ -0,0 +1,72 @@
+/**
+ * @brief Build and cache the TensorRT engine of a Re-ID model offline
+ *  The engine is built with the parameters of the ReID config (batch size, FP16/TF32, input dimensions)
+ *  and saved next to the ONNX model, where BoTSORT finds it at start-up: production start-up then only
+ *  deserializes the engine. Run it on the target device (e.g. the Jetson), the engine is device specific.
+ *  The start-up time is reported before (cold, engine built if not cached) and after caching (warm).
+ *
+ * Usage: botsort_build_engine <reid_config> <onnx_model>
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "ReID.h"
+
+#include "INIReader.h"
+
+
+namespace
+{
+/**
+ * @brief Time the creation of the Re-ID model, i.e. loading (and building if needed) its engine
+ */
+double load_model_seconds(const std::string &reid_config_path,
+                          const std::string &onnx_model_path)
+{
+    auto start = std::chrono::steady_clock::now();
+    ReIDModel reid_model(reid_config_path, onnx_model_path);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+            .count();
+}
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " <reid_config> <onnx_model>"
+                  << std::endl;
+        return 1;
+    }
+
+    const std::string reid_config_path = argv[1];
+    const std::string onnx_model_path = argv[2];
+
+    INIReader reid_config(reid_config_path);
+    if (reid_config.ParseError() < 0)
+    {
+        std::cout << "Can't load " << reid_config_path << std::endl;
+        return 1;
+    }
+    if (reid_config.Get("ReID", "inference_backend", "tensorrt") != "tensorrt")
+    {
+        std::cout << "The ReID config doesn't use the tensorrt inference "
+                     "backend, there is no engine to build"
+                  << std::endl;
+        return 1;
+    }
+
+    // The Re-ID model exits if the engine can't be built or loaded
+    const double cold_seconds =
+            load_model_seconds(reid_config_path, onnx_model_path);
+    const double warm_seconds =
+            load_model_seconds(reid_config_path, onnx_model_path);
+
+    std::cout << "Engine cached for " << onnx_model_path << std::endl;
+    std::cout << "Start-up time: " << cold_seconds << " s (cold), "
+              << warm_seconds << " s (warm, cached engine)" << std::endl;
+    return 0;
+}
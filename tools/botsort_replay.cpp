@@ -0,0 +1,223 @@
+/**
+ * @brief Replay a recorded tracking session (see replay.h) through BoTSORT without video or inference
+ *  The session is recorded with BoTSORT::start_recording() (--record of the tracking example): the
+ *  detections, frame sizes, GMC homographies and ReID features of each frame. The replay runs only
+ *  the association and the Kalman filter, on the exact recorded data, and reports the latency of
+ *  BoTSORT::replay() per frame (per stage with BOTSORT_PROFILE=1 or --trace).
+ *  --verify checks that the replayed tracks are bit-exact with the recorded ones (the IDs may be
+ *  offset, each recorded ID must map to a single replayed ID); use the tracker config of the recording.
+ *
+ * Usage: botsort_replay <tracker_config> <session.botreplay> [--repeat <n>] [--verify]
+ *                       [--mot-output <tracks.txt>] [--trace <trace.json>]
+ */
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BoTSORT.h"
+#include "profiler.h"
+#include "replay.h"
+
+
+namespace
+{
+/**
+ * @brief Compares the replayed tracks with the recorded ones
+ */
+class SessionVerifier
+{
+public:
+    void check(const bot_replay::FrameRecord &frame,
+               const std::vector<std::shared_ptr<Track>> &tracks)
+    {
+        bool frame_matches = tracks.size() == frame.tracks.size();
+        for (size_t i = 0; frame_matches && i < tracks.size(); ++i)
+        {
+            const bot_replay::TrackRecord &recorded = frame.tracks[i];
+            const std::vector<float> tlwh = tracks[i]->get_tlwh();
+            frame_matches = tlwh[0] == recorded.tlwh.x &&
+                            tlwh[1] == recorded.tlwh.y &&
+                            tlwh[2] == recorded.tlwh.width &&
+                            tlwh[3] == recorded.tlwh.height &&
+                            _map_id(recorded.track_id, tracks[i]->track_id);
+        }
+
+        if (!frame_matches)
+        {
+            if (_mismatched_frames == 0)
+                std::cout << "First mismatch at frame " << frame.frame_id
+                          << ": " << tracks.size() << " tracks replayed, "
+                          << frame.tracks.size() << " recorded" << std::endl;
+            ++_mismatched_frames;
+        }
+    }
+
+    size_t mismatched_frames() const
+    {
+        return _mismatched_frames;
+    }
+
+
+private:
+    bool _map_id(int recorded_id, int replayed_id)
+    {
+        auto [mapping, inserted] = _ids.emplace(recorded_id, replayed_id);
+        return inserted ? _replayed_ids.emplace(replayed_id, recorded_id)
+                                  .second
+                        : mapping->second == replayed_id;
+    }
+
+
+private:
+    std::unordered_map<int, int> _ids, _replayed_ids;
+    size_t _mismatched_frames = 0;
+};
+}// namespace
+
+
+int main(int argc, char **argv)
+{
+    std::string trace_filepath, mot_output_filepath;
+    int repeat = 1;
+    bool verify = false;
+    std::vector<char *> args;
+    for (int i = 0; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--verify")
+            verify = true;
+        else if (arg == "--mot-output" && i + 1 < argc)
+            mot_output_filepath = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            trace_filepath = argv[++i];
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() < 3)
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " <tracker_config> <session.botreplay> [--repeat <n>] "
+                     "[--verify] [--mot-output <tracks.txt>] "
+                     "[--trace <trace.json>]"
+                  << std::endl;
+        return 1;
+    }
+    const std::string tracker_config_path = args[1];
+
+    // The whole session is loaded first, so that the replay does no I/O
+    bot_replay::ReplayReader reader;
+    if (!reader.open(args[2]))
+        return 1;
+    std::vector<bot_replay::FrameRecord> frames;
+    bot_replay::FrameRecord frame;
+    size_t num_detections = 0, num_features = 0, num_homographies = 0;
+    while (reader.read(frame))
+    {
+        num_detections += frame.detections.size();
+        num_features += frame.feature_indices.size() +
+                        static_cast<size_t>(frame.late_features.rows());
+        num_homographies += frame.homography.has_value();
+        frames.push_back(frame);
+    }
+    if (frames.empty())
+    {
+        std::cout << "No frame in " << args[2] << std::endl;
+        return 1;
+    }
+    std::cout << "Session: " << frames.size() << " frames, "
+              << num_detections << " detections, " << num_features
+              << " ReID features (distance: "
+              << (reader.session().distance_metric.empty()
+                          ? "none"
+                          : reader.session().distance_metric)
+              << (reader.session().late_features ? ", applied one frame late"
+                                                 : "")
+              << "), " << num_homographies << " homographies" << std::endl;
+
+    if (!trace_filepath.empty() && !bot_profiler::start_trace(trace_filepath))
+    {
+        std::cout << "Can't open " << trace_filepath << std::endl;
+        return 1;
+    }
+
+    std::vector<double> latencies_ms;
+    latencies_ms.reserve(frames.size() * repeat);
+    SessionVerifier verifier;
+    std::ofstream mot_output;
+    if (!mot_output_filepath.empty())
+        mot_output.open(mot_output_filepath);
+
+    for (int pass = 0; pass < repeat; ++pass)
+    {
+        BoTSORT tracker(tracker_config_path);
+        for (const bot_replay::FrameRecord &recorded: frames)
+        {
+            auto start = std::chrono::steady_clock::now();
+            const std::vector<std::shared_ptr<Track>> tracks =
+                    tracker.replay(recorded, reader.session());
+            auto end = std::chrono::steady_clock::now();
+            latencies_ms.push_back(
+                    std::chrono::duration<double, std::milli>(end - start)
+                            .count());
+
+            if (pass > 0)
+                continue;
+            if (verify)
+                verifier.check(recorded, tracks);
+            if (mot_output.is_open())
+                for (const std::shared_ptr<Track> &track: tracks)
+                {
+                    const std::vector<float> tlwh = track->get_tlwh();
+                    mot_output << recorded.frame_id << "," << track->track_id
+                               << "," << tlwh[0] << "," << tlwh[1] << ","
+                               << tlwh[2] << "," << tlwh[3] << ",-1,-1,-1,0"
+                               << "\n";
+                }
+        }
+    }
+
+    const double total_ms =
+            std::accumulate(latencies_ms.begin(), latencies_ms.end(), 0.0);
+    std::sort(latencies_ms.begin(), latencies_ms.end());
+    auto percentile = [&latencies_ms](double p) {
+        return latencies_ms[static_cast<size_t>(
+                p * static_cast<double>(latencies_ms.size() - 1))];
+    };
+    std::cout << std::fixed << std::setprecision(3)
+              << "Replay latency per frame (ms): mean "
+              << total_ms / static_cast<double>(latencies_ms.size())
+              << ", p50 " << percentile(0.5) << ", p95 " << percentile(0.95)
+              << ", max " << latencies_ms.back() << " (" << std::setprecision(1)
+              << 1e3 * static_cast<double>(latencies_ms.size()) / total_ms
+              << " fps, " << repeat << " pass(es))" << std::endl;
+
+    if (bot_profiler::is_enabled())
+        bot_profiler::print_report(std::cout);
+    if (!trace_filepath.empty())
+    {
+        bot_profiler::stop_trace();
+        std::cout << "Trace written to " << trace_filepath << std::endl;
+    }
+
+    if (verify)
+    {
+        if (verifier.mismatched_frames() > 0)
+        {
+            std::cout << "Replay differs from the recording in "
+                      << verifier.mismatched_frames() << " of "
+                      << frames.size() << " frames" << std::endl;
+            return 2;
+        }
+        std::cout << "Replay matches the recording bit-exactly" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+"""
+Make the batch dimension of a ReID ONNX model dynamic, so that the inference engines can run
+all the detections of a frame in a single forward pass.
+
+The bundled assets/osnet_x0_25_market1501.onnx was exported with a static batch of 1 and flattens
+the pooled features with a Reshape to the constant shape [1, -1], which is rewritten to [0, -1]
+(0 copies the batch dimension of the Reshape input). The result is shipped as
+assets/osnet_x0_25_market1501_dynamic_batch.onnx.
+
+Usage: python3 tools/onnx_dynamic_batch.py <input.onnx> [output.onnx]
+       (default output: <input>_dynamic_batch.onnx)
+"""
+import os
+import sys
+
+import onnx
+from onnx import numpy_helper
+
+
+def _constant_values(graph, name):
+    for node in graph.node:
+        if node.op_type == "Constant" and node.output[0] == name:
+            return node, numpy_helper.to_array(node.attribute[0].t)
+    for init in graph.initializer:
+        if init.name == name:
+            return init, numpy_helper.to_array(init)
+    return None, None
+
+
+def make_batch_dynamic(model, batch_dim_name="batch"):
+    graph = model.graph
+    for value in list(graph.input) + list(graph.output):
+        dim = value.type.tensor_type.shape.dim[0]
+        dim.ClearField("dim_value")
+        dim.dim_param = batch_dim_name
+
+    # Drop the stale intermediate shapes, the runtimes infer them again
+    del graph.value_info[:]
+
+    for node in graph.node:
+        if node.op_type != "Reshape":
+            continue
+        holder, shape = _constant_values(graph, node.input[1])
+        if shape is None or shape.ndim != 1 or shape[0] != 1:
+            continue
+
+        new_shape = shape.copy()
+        new_shape[0] = 0
+        if isinstance(holder, onnx.TensorProto):
+            holder.CopyFrom(numpy_helper.from_array(new_shape, holder.name))
+        else:
+            holder.attribute[0].t.CopyFrom(numpy_helper.from_array(new_shape))
+        print(f"Reshape {node.name}: {shape.tolist()} -> {new_shape.tolist()}")
+
+    onnx.checker.check_model(model)
+    return model
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+
+    input_path = sys.argv[1]
+    output_path = sys.argv[2] if len(sys.argv) > 2 else \
+        os.path.splitext(input_path)[0] + "_dynamic_batch.onnx"
+    onnx.save(make_batch_dynamic(onnx.load(input_path)), output_path)
+    print(f"Saved {output_path}")